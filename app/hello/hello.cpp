@@ -20,15 +20,13 @@ bool app_init(Scene *app) {
   if (!ok) {
     return false;
   }
-  glActiveTexture(GL_TEXTURE1);
-  glBindTexture(GL_TEXTURE_2D, app->texWall);
+  glstate_bind_texture(1, GL_TEXTURE_2D, app->texWall);
 
   ok = tex_load(&app->texAwesome, "assets/awesomeface.png");
   if (!ok) {
     return false;
   }
-  glActiveTexture(GL_TEXTURE2);
-  glBindTexture(GL_TEXTURE_2D, app->texAwesome);
+  glstate_bind_texture(2, GL_TEXTURE_2D, app->texAwesome);
 
   return ok;
 }
@@ -5,6 +5,7 @@
 
 #include "example/cube_mesh.h"
 #include "flycamera.h"
+#include "glstate.h"
 #include "mesh.cpp"
 #include "shader.h"
 #include "texture.h"
@@ -14,7 +14,7 @@ internal void app_input(app_s* app, SDL_Event e) {
     if (e.window.event == SDL_WINDOWEVENT_RESIZED) {
       int g_screenWidth = e.window.data1;
       int g_screenHeight = e.window.data2;
-      glViewport(0, 0, g_screenWidth, g_screenHeight);
+      glstate_viewport(0, 0, g_screenWidth, g_screenHeight);
       // is it good to do this here?
       app->camera.aspect = (float)g_screenWidth / (float)g_screenHeight;
     }
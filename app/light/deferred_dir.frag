@@ -0,0 +1,35 @@
+// full screen pass of the deferred path: the directional light, and the
+// G-buffer depth goes to the window for the volumes and forward drawing
+
+out vec4 FragColor;
+
+// gAlbedoSpec, gNormal, gDepth, Surface and FetchSurface come from
+// deferred_surface.frag, compiled ahead of this
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+uniform DirLight dirLight;
+
+void main() {
+    Surface s = FetchSurface(gl_FragCoord.xy);
+    if (s.depth == 1.0) {
+        discard;
+    }
+    gl_FragDepth = s.depth;
+
+    vec3 viewDir = normalize(-s.position);
+    vec3 lightDir = normalize(-dirLight.direction);
+    float diff = max(dot(s.normal, lightDir), 0.0);
+    vec3 reflectDir = reflect(-lightDir, s.normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), s.shininess);
+
+    vec3 diffuse = dirLight.diffuse * diff * s.albedo;
+    vec3 specular = dirLight.specular * spec * s.specular;
+    FragColor = vec4(diffuse + specular, 1.0);
+}
@@ -0,0 +1,47 @@
+// one point light of the deferred path, drawn with its volume where the
+// stencil says the G-buffer is inside it, added to the window
+
+out vec4 FragColor;
+
+// gAlbedoSpec, gNormal, gDepth, Surface and FetchSurface come from
+// deferred_surface.frag, compiled ahead of this
+
+struct PointLight {
+    vec3 position;
+    float range;
+
+    vec3 diffuse;
+    vec3 specular;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+uniform PointLight light;
+
+void main() {
+    Surface s = FetchSurface(gl_FragCoord.xy);
+
+    float distance = length(light.position - s.position);
+    if (distance > light.range) {
+        discard;
+    }
+
+    vec3 viewDir = normalize(-s.position);
+    vec3 lightDir = normalize(light.position - s.position);
+    float diff = max(dot(s.normal, lightDir), 0.0);
+    vec3 reflectDir = reflect(-lightDir, s.normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), s.shininess);
+
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // fades to zero at the range, same as light_tex.frag
+    float window = clamp(1.0 - pow(distance / light.range, 4.0), 0.0, 1.0);
+    attenuation *= window * window;
+
+    // no ambient term: CalcPointLight of light_tex.frag works it out but
+    // leaves it out of what it returns, both paths shade the same
+    vec3 diffuse = light.diffuse * diff * s.albedo;
+    vec3 specular = light.specular * spec * s.specular;
+    FragColor = vec4((diffuse + specular) * attenuation, 1.0);
+}
@@ -0,0 +1,40 @@
+// the spotlight of the deferred path, held at the eye, drawn with its cone
+// where the stencil says the G-buffer is inside it, added to the window
+
+out vec4 FragColor;
+
+// gAlbedoSpec, gNormal, gDepth, Surface and FetchSurface come from
+// deferred_surface.frag, compiled ahead of this
+
+struct SpotLight {
+    vec3 position;
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+
+    float cutOff;
+    float outerCutOff;
+};
+
+uniform SpotLight spotLight;
+
+void main() {
+    Surface s = FetchSurface(gl_FragCoord.xy);
+
+    // same as CalcSpotLight of light_tex.frag
+    vec3 viewDir = normalize(-s.position);
+    vec3 lightDir = viewDir;
+    float diff = max(dot(s.normal, lightDir), 0.0);
+    vec3 reflectDir = reflect(-lightDir, s.normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), s.shininess);
+
+    float theta = dot(lightDir, normalize(-spotLight.direction));
+    float epsilon = spotLight.cutOff - spotLight.outerCutOff;
+    float intensity = clamp((theta - spotLight.outerCutOff) / epsilon, 0.0, 1.0);
+
+    vec3 diffuse = spotLight.diffuse * diff * s.albedo;
+    vec3 specular = spotLight.specular * spec * s.specular;
+    FragColor = vec4((diffuse + specular) * intensity, 1.0);
+}
@@ -0,0 +1,49 @@
+#version 330 core
+
+// G-buffer reads shared by the light passes of the deferred path, compiled
+// ahead of deferred_dir.frag, deferred_point.frag and deferred_spot.frag
+
+// G-buffer of the geometry pass, see gbuffer.frag
+uniform sampler2D gAlbedoSpec;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+uniform mat4 invProjection;
+// pixels of the viewport it was drawn in, the G-buffer may be larger
+uniform vec2 screenSize;
+
+struct Surface {
+    float depth;
+    vec3 position;
+    vec3 normal;
+    vec3 albedo;
+    float specular;
+    float shininess;
+};
+
+vec3 DecodeNormal(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+// FetchSurface reads the G-buffer under the fragment, the position comes back
+// from depth
+Surface FetchSurface(vec2 fragCoord) {
+    ivec2 pixel = ivec2(fragCoord);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    vec4 albedoSpec = texelFetch(gAlbedoSpec, pixel, 0);
+    vec4 normal = texelFetch(gNormal, pixel, 0);
+    vec2 uv = fragCoord / screenSize;
+    vec4 p = invProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+
+    Surface s;
+    s.depth = depth;
+    s.position = p.xyz / p.w;
+    s.normal = DecodeNormal(normal.xy);
+    s.albedo = albedoSpec.rgb;
+    s.specular = albedoSpec.a;
+    s.shininess = normal.z;
+    return s;
+}
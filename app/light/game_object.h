@@ -5,7 +5,15 @@
 
 #include "light_shader.h"
 #include "mesh.h"
-#include "shader.h"
+#include "renderer.h"
+
+// what changed in a GameObject since the retained draw list was built
+enum game_object_dirty_e {
+  GO_DIRTY_TRANSFORM = 1 << 0,
+  GO_DIRTY_MATERIAL = 1 << 1,
+  GO_DIRTY_MESH = 1 << 2,
+  GO_DIRTY_ALL = GO_DIRTY_TRANSFORM | GO_DIRTY_MATERIAL | GO_DIRTY_MESH,
+};
 
 struct GameObject {
 
@@ -17,14 +25,49 @@ struct GameObject {
   // Mesh contains GameObject render mesh if it has one.
   mesh_s *mesh;
 
-  // Shader tells how GameObject should be displayed.
-  shader_s *shader;
+  // Pipeline tells how GameObject should be displayed.
+  gpu_pipeline_s *pipeline;
 
   // Light tells that GameObject emits light.
   light_s *light;
 
   // MaterialColor stores parameters for color shader rendering.
   mat_color_s *mat_color;
+
+  // Occluder tells that the mesh fills its bounds box, the box hides what is
+  // behind it in software occlusion culling.
+  bool occluder;
+
+  // Cell is the maze cell the object stands in, -1 for objects out of the
+  // maze. Objects in cells hidden from the camera's cell are not drawn.
+  int cell;
+
+  // Moves tells the transform changes every frame, such objects go through
+  // the render queue every frame instead of the retained draw list.
+  bool moves;
+
+  // Chunk is the static batch object drawing this one, -1 for none. Objects
+  // in a chunk are copied into it once, they must not change afterwards.
+  int chunk;
+
+  // Dirty tells what changed since the retained draw list was built, see
+  // game_object_dirty_e. Set by the game_object_set_* calls.
+  uint8_t dirty;
 };
 
+void game_object_set_transform(GameObject *obj, const mat4 &transform) {
+  obj->transform = transform;
+  obj->dirty |= GO_DIRTY_TRANSFORM;
+}
+
+void game_object_set_material(GameObject *obj, mat_color_s *mat_color) {
+  obj->mat_color = mat_color;
+  obj->dirty |= GO_DIRTY_MATERIAL;
+}
+
+void game_object_set_mesh(GameObject *obj, mesh_s *mesh) {
+  obj->mesh = mesh;
+  obj->dirty |= GO_DIRTY_MESH;
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,38 @@
+#version 330 core
+
+// geometry pass of the deferred path, the material of light_tex.frag packed
+// for the lighting passes:
+// gAlbedoSpec - diffuse color, specular intensity
+// gNormal - view space normal (octahedral), shininess
+struct Material {
+    sampler2D diffuse1;
+    sampler2D specular1;
+    vec3 emission_color;
+    sampler2D emission1;
+    float shininess;
+};
+
+uniform Material material;
+
+in vec2 TexCoords;
+in vec3 Normal;
+
+layout (location = 0) out vec4 gAlbedoSpec;
+layout (location = 1) out vec4 gNormal;
+
+vec2 OctWrap(vec2 v) {
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0,
+                                    v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 EncodeNormal(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    return n.z >= 0.0 ? n.xy : OctWrap(n.xy);
+}
+
+void main() {
+    vec3 specular = vec3(texture(material.specular1, TexCoords));
+    gAlbedoSpec = vec4(vec3(texture(material.diffuse1, TexCoords)),
+                       (specular.r + specular.g + specular.b) / 3.0);
+    gNormal = vec4(EncodeNormal(normalize(Normal)), material.shininess, 0.0);
+}
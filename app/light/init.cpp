@@ -6,34 +6,150 @@ int gScreenHeight = 1000;
 bool app_init(Scene *app) {
   bool ok = false;
   flycamera_init(&app->camera, false, 60.0f, gScreenWidth / gScreenHeight);
-  ok = shader_init(&app->lighting_shader, "./app/light/light.vert",
-                   "./app/light/light_tex.frag");
+  app->screen_width = gScreenWidth;
+  app->screen_height = gScreenHeight;
+  ok = shader_init_layout<vertex_s>(&app->lighting_shader,
+                                    "./app/light/light.vert",
+                                    "./app/light/light_tex.frag");
   if (!ok) {
     printf("lighting shader new failed");
     return ok;
   }
 
-  ok = shader_init(&app->lamp_shader, "./app/light/light.vert",
-                   "./app/light/light_src.frag");
+  ok = shader_init_layout<vertex_s, instance_s>(&app->lighting_inst_shader,
+                                                "./app/light/light_inst.vert",
+                                                "./app/light/light_tex.frag");
+  if (!ok) {
+    printf("instanced lighting shader new failed");
+    return ok;
+  }
+
+  ok = shader_init_layout<vertex_s, instance_s>(&app->lamp_shader,
+                                                "./app/light/light_inst.vert",
+                                                "./app/light/light_src.frag");
   if (!ok) {
     printf("lamp shader new failed");
     return ok;
   }
 
-  // TODO: need memory allocation
-  static shader_s colorShader;
-  ok = shader_init(&colorShader, "./app/light/light.vert",
-                   "./app/light/light_color.frag");
+  ok = shader_init_layout<vertex_s, instance_s>(&app->color_shader,
+                                                "./app/light/light_inst.vert",
+                                                "./app/light/light_color.frag");
   if (!ok) {
     printf("colorShader initialization failed");
     return ok;
   }
 
+  ok = shader_init_layout<vertex_s>(&app->bounds_shader,
+                                    "./engine/shaders/bounds.vert",
+                                    "./engine/shaders/depth.frag");
+  if (!ok) {
+    printf("bounds shader new failed");
+    return ok;
+  }
+
+  ok = shader_init_layout<vertex_pos_s, instance_s>(
+      &app->depth_shader, "./engine/shaders/depth_inst.vert",
+      "./engine/shaders/depth.frag");
+  if (!ok) {
+    printf("depth shader new failed");
+    return ok;
+  }
+
+  ok = shader_init_layout<vertex_s, instance_s>(&app->gbuffer_shader,
+                                                "./app/light/light_inst.vert",
+                                                "./app/light/gbuffer.frag");
+  if (!ok) {
+    printf("gbuffer shader new failed");
+    return ok;
+  }
+
+  ok = shader_init_prefixed(&app->deferred_dir_shader,
+                            "./engine/shaders/fullscreen.vert",
+                            "./app/light/deferred_surface.frag",
+                            "./app/light/deferred_dir.frag");
+  if (!ok) {
+    printf("deferred dir shader new failed");
+    return ok;
+  }
+
+  ok = shader_init_layout<vertex_s>(&app->deferred_point_shader,
+                                    "./engine/shaders/bounds.vert",
+                                    "./app/light/deferred_point.frag",
+                                    "./app/light/deferred_surface.frag");
+  if (!ok) {
+    printf("deferred point shader new failed");
+    return ok;
+  }
+
+  ok = shader_init_layout<vertex_s>(&app->deferred_spot_shader,
+                                    "./engine/shaders/bounds.vert",
+                                    "./app/light/deferred_spot.frag",
+                                    "./app/light/deferred_surface.frag");
+  if (!ok) {
+    printf("deferred spot shader new failed");
+    return ok;
+  }
+
+  ok = shader_init(&app->upscale_shader, "./engine/shaders/fullscreen.vert",
+                   "./engine/shaders/upscale.frag");
+  if (!ok) {
+    printf("upscale shader new failed");
+    return ok;
+  }
+
+  app->lighting_pipeline = gpu_pipeline_opaque(&app->lighting_shader);
+  app->lamp_pipeline = gpu_pipeline_opaque(&app->lamp_shader);
+  app->color_pipeline = gpu_pipeline_opaque(&app->color_shader);
+  app->lighting_inst_pipeline =
+      gpu_pipeline_opaque(&app->lighting_inst_shader);
+  // boxes are only tested, they are slightly larger than what they bound
+  app->bounds_pipeline = gpu_pipeline_opaque(&app->bounds_shader);
+  app->bounds_pipeline.depth_write = false;
+  app->bounds_pipeline.depth_compare = GPU_COMPARE_LEQUAL;
+  app->bounds_pipeline.color_write = false;
+  app->depth_pipeline = gpu_pipeline_opaque(&app->depth_shader);
+  app->depth_pipeline.color_write = false;
+
+  app->gbuffer_pipeline = gpu_pipeline_opaque(&app->gbuffer_shader);
+  // covers the window, depth of the G-buffer goes with the color
+  app->deferred_dir_pipeline = gpu_pipeline_opaque(&app->deferred_dir_shader);
+  app->deferred_dir_pipeline.depth_compare = GPU_COMPARE_ALWAYS;
+  app->deferred_dir_pipeline.cull = GPU_CULL_NONE;
+  // both faces count in the stencil, none are clipped at near or far
+  app->volume_mark_pipeline = gpu_pipeline_opaque(&app->bounds_shader);
+  app->volume_mark_pipeline.depth_write = false;
+  app->volume_mark_pipeline.color_write = false;
+  app->volume_mark_pipeline.depth_clamp = true;
+  app->volume_mark_pipeline.cull = GPU_CULL_NONE;
+  app->volume_mark_pipeline.stencil = GPU_STENCIL_VOLUME_MARK;
+  // back faces cover every pixel of the volume once, eye inside or not
+  app->deferred_point_pipeline =
+      gpu_pipeline_opaque(&app->deferred_point_shader);
+  app->deferred_point_pipeline.depth_test = false;
+  app->deferred_point_pipeline.depth_write = false;
+  app->deferred_point_pipeline.depth_clamp = true;
+  app->deferred_point_pipeline.cull = GPU_CULL_FRONT;
+  app->deferred_point_pipeline.blend = GPU_BLEND_ADD;
+  app->deferred_point_pipeline.stencil = GPU_STENCIL_VOLUME_TEST;
+  // the cone starts at the eye, every surface behind its back faces is
+  // inside it and the stencil has nothing to take away
+  app->deferred_spot_pipeline = app->deferred_point_pipeline;
+  app->deferred_spot_pipeline.program = app->deferred_spot_shader.program;
+  app->deferred_spot_pipeline.layout = &app->deferred_spot_shader;
+  app->deferred_spot_pipeline.stencil = GPU_STENCIL_NONE;
+  // covers the window, nothing is behind it
+  app->upscale_pipeline = gpu_pipeline_opaque(&app->upscale_shader);
+  app->upscale_pipeline.depth_test = false;
+  app->upscale_pipeline.depth_write = false;
+  app->upscale_pipeline.cull = GPU_CULL_NONE;
+
   // TODO: need memory allocation
   static mesh_s cubeMesh = {};
   MeshZero(&cubeMesh);
   MeshSetCube(&cubeMesh);
   MeshInitialize(&cubeMesh);
+  app->box_mesh = &cubeMesh;
 
   // MeshZero(&app->cube_mesh);
   // mesh_read_obj(&app->cube_mesh, "assets/icosphere.obj");
@@ -54,6 +170,16 @@ bool app_init(Scene *app) {
   mesh_read_obj(&app->debug_sphere, "assets/sphere.obj");
   MeshInitialize(&app->debug_sphere);
 
+  MeshZero(&app->sphere_volume);
+  MeshSetSphere(&app->sphere_volume, 8, 12);
+  MeshInitialize(&app->sphere_volume);
+  MeshZero(&app->cone_volume);
+  MeshSetCone(&app->cone_volume, 12);
+  MeshInitialize(&app->cone_volume);
+  // the full screen triangle has no vertices to read
+  app->fullscreen_input = gpu_input_create();
+  geometry_arena_report(&g_mesh_geometry);
+
   // g_cube.shader = &app->lighting_shader;
   // g_cube.vao = app->vao;
   // g_cube.vbo = app->vbo;
@@ -65,9 +191,9 @@ bool app_init(Scene *app) {
   // g_ramp.num_triangles = 24;
 
   app->mat_tex = {
-      .tex_diffuse = 0,
-      .tex_specular = 0,
-      .tex_emission = 0,
+      .tex_diffuse = {},
+      .tex_specular = {},
+      .tex_emission = {},
       .tex_diffuse_unit = GL_TEXTURE1,
       .tex_specular_unit = GL_TEXTURE2,
       .tex_emission_unit = GL_TEXTURE3,
@@ -82,8 +208,7 @@ bool app_init(Scene *app) {
     return ok;
   }
 
-  glActiveTexture(app->mat_tex.tex_diffuse_unit);
-  glBindTexture(GL_TEXTURE_2D, app->mat_tex.tex_diffuse);
+  gpu_texture_bind(app->mat_tex.tex_diffuse, app->mat_tex.tex_diffuse_unit_idx);
 
   ok = tex_load(&app->mat_tex.tex_specular, "assets/container2_specular2.png");
   if (!ok) {
@@ -95,12 +220,12 @@ bool app_init(Scene *app) {
     return ok;
   }
 
-  glActiveTexture(app->mat_tex.tex_specular_unit);
-  glBindTexture(GL_TEXTURE_2D, app->mat_tex.tex_specular);
+  gpu_texture_bind(app->mat_tex.tex_specular,
+                   app->mat_tex.tex_specular_unit_idx);
 
   printf("mat tex: %f %d %d %d %d", app->mat_tex.shininess,
-         app->mat_tex.tex_diffuse, app->mat_tex.tex_diffuse_unit,
-         app->mat_tex.tex_specular, app->mat_tex.tex_specular_unit);
+         app->mat_tex.tex_diffuse.id, app->mat_tex.tex_diffuse_unit,
+         app->mat_tex.tex_specular.id, app->mat_tex.tex_specular_unit);
 
   // dirlight
   app->dir_light.ambient = glm::vec3(0.1f);
@@ -139,7 +264,9 @@ bool app_init(Scene *app) {
   app->sp_light.cutOff = glm::cos(glm::radians(12.5f));
   app->sp_light.outerCutOff = glm::cos(glm::radians(15.5f));
 
-  ok = text_init(&app->text_renderer);
+  // text and the instances of a frame, see sceneUploadFrame
+  stream_init(&app->stream, 256 * 1024 + GOSize * sizeof(instance_s));
+  ok = text_init(&app->text_renderer, &app->stream);
   if (!ok) {
     printf("light: failed to init text renderer\n");
     return ok;
@@ -152,9 +279,14 @@ bool app_init(Scene *app) {
     obj->instance = LampInstance;
     obj->transform = mat4(1.0f);
     obj->mesh = &cubeMesh;
-    obj->shader = &app->lamp_shader;
+    obj->pipeline = &app->lamp_pipeline;
     obj->light = &app->p_light[light_i];
     obj->mat_color = NULL;
+    obj->occluder = false;
+    obj->cell = -1;
+    obj->chunk = -1;
+    obj->moves = true;
+    obj->dirty = GO_DIRTY_ALL;
     light_i++;
   }
 
@@ -163,22 +295,100 @@ bool app_init(Scene *app) {
     obj->instance = BoxInstance;
     obj->transform = glm::mat4(1.0f);
     obj->mesh = &app->texture_cube_mesh;
-    obj->shader = &colorShader;
+    obj->pipeline = &app->color_pipeline;
     // TODO: make dynamic light detection
     obj->light = &app->p_light[0];
     obj->mat_color = &g_mat_sh_0;
+    obj->occluder = false;
+    obj->cell = -1;
+    obj->chunk = -1;
+    obj->moves = false;
+    obj->dirty = GO_DIRTY_ALL;
   }
 
   {
-    idx += sceneMazeStart(&app->go[idx], &cubeMesh, &app->lighting_shader,
-                          &app->p_light[0]);
+    idx += sceneMazeStart(&app->go[idx], &cubeMesh,
+                          &app->lighting_inst_pipeline, &app->p_light[0],
+                          &app->pvs);
+    sceneLightFieldStart(app->field_lights, LightFieldSize, &app->pvs);
   }
 
+  app->go_size = idx;
+  if (!sceneStaticStart(app)) {
+    return false;
+  }
+  for (int i = 0; i < RENDER_THREAD_FRAMES; i++) {
+    instance_buffer_init(&app->frames[i].instances, GOSize);
+    indirect_buffer_init(&app->frames[i].commands, GOSize);
+  }
+  instance_buffer_init(&app->retained_instances, GOSize);
+  render_queue_init(&app->queue, GOSize);
+
+  app->material_buf = gpu_buffer_create(RENDER_IDS_MAX * 3 * sizeof(vec4),
+                                        NULL, GPU_BUFFER_DYNAMIC);
+  app->material_table = gpu_texture_buffer_create(app->material_buf);
+
+  // without it everything is drawn, culling is optional
+  app->cull_available = cull_gpu_init(&app->cull, GOSize, GOSize);
+
+  if (!jobs_init(&app->jobs, 0)) {
+    return false;
+  }
+  // the render thread's own, the update's workers are busy with the next
+  // frame while it records
+  if (!jobs_init(&app->record_jobs, 0)) {
+    return false;
+  }
+  for (int i = 0; i < SceneSlices; i++) {
+    cmd_list_init(&app->slices[i].gbuffer, 4096);
+    cmd_list_init(&app->slices[i].opaque, 4096);
+  }
+  cmd_list_init(&app->immediate, 1024);
+  occlusion_init(&app->occlusion, GOSize);
+
+  frame_graph_init(&app->graph);
+  // 120Hz
+  resolution_init(&app->resolution, 8.3f);
+  query_pool_init(&app->queries, 128);
+  for (int i = 0; i < COUNT_OF(app->draw_timers); i++) {
+    app->draw_timers[i] = gpu_query_create();
+    app->draw_timer_pending[i] = false;
+  }
+  for (int i = 0; i < GOSize; i++) {
+    query_slot_init(&app->query_slots[i]);
+  }
+
+  // lamps and the field, four texels per light
+  int max_lights = 4 + LightFieldSize;
+  clusters_init(&app->clusters, max_lights);
+  app->light_buf = gpu_buffer_create(max_lights * 4 * sizeof(vec4), NULL,
+                                     GPU_BUFFER_DYNAMIC);
+  app->cluster_grid_buf = gpu_buffer_create(
+      CLUSTER_COUNT * 2 * sizeof(uint32_t), NULL, GPU_BUFFER_DYNAMIC);
+  app->cluster_index_buf = gpu_buffer_create(
+      CLUSTER_COUNT * CLUSTER_MAX_LIGHTS * sizeof(uint16_t), NULL,
+      GPU_BUFFER_DYNAMIC);
+  app->light_data = gpu_texture_buffer_create(app->light_buf);
+  app->cluster_grid =
+      gpu_texture_buffer_create(app->cluster_grid_buf, GPU_TEXEL_RG32UI);
+  app->cluster_lights =
+      gpu_texture_buffer_create(app->cluster_index_buf, GPU_TEXEL_R16UI);
+
+  Uint64 pvs_start = SDL_GetPerformanceCounter();
+  pvs_build(&app->pvs, &app->jobs);
+  printf("pvs: %d cells in %d bytes, %.1fms\n", app->pvs.cells,
+         app->pvs.data_size,
+         (SDL_GetPerformanceCounter() - pvs_start) * 1000.0f /
+             SDL_GetPerformanceFrequency());
+
   return ok;
 }
 
+// sceneMazeStart fills objectArena with the maze blocks and returns how many
+// there are. Cells of the grid and boxes of the blocks go to pvs, to be built.
 internal int sceneMazeStart(GameObject *objectArena, mesh_s *mesh,
-                            shader_s *lightingShader, light_s *lightSource) {
+                            gpu_pipeline_s *lightingPipeline,
+                            light_s *lightSource, pvs_s *pvs) {
   const int blockMaskX = 10;
   const int blockMaskZ = 10;
   const int blockMaskY = 3;
@@ -202,6 +412,12 @@ internal int sceneMazeStart(GameObject *objectArena, mesh_s *mesh,
   const float cell_depth = 2.3f;
 
   const float cell_fluctuation = 0.5f;
+
+  // blocks are cubes centered in their cells, before the fluctuation
+  vec3 cell = vec3(cell_width, cell_height, cell_depth);
+  vec3 origin = vec3(2.0f - blockMaskX / 2.0f, -2.0f, 2.0f - blockMaskZ / 2.0f);
+  pvs_init(pvs, blockMaskX, blockMaskY, blockMaskZ, origin - cell * 0.5f,
+           cell);
   static int save_rnd = rnd;
   rnd = save_rnd;
 
@@ -240,9 +456,16 @@ internal int sceneMazeStart(GameObject *objectArena, mesh_s *mesh,
           obj->instance = MazeInstance;
           obj->transform = transform;
           obj->mesh = mesh;
-          obj->shader = lightingShader;
+          obj->pipeline = lightingPipeline;
           obj->light = lightSource;
           obj->mat_color = &g_mat_sh_0;
+          obj->occluder = true;
+          obj->cell = pvs_cell_index(pvs, i, l, j);
+          obj->chunk = -1;
+          obj->moves = false;
+          obj->dirty = GO_DIRTY_ALL;
+          bounds_s box = bounds_transform(&mesh->bounds, transform);
+          pvs_set_box(pvs, obj->cell, box.min, box.max);
 
           objectIdx++;
         }
@@ -253,4 +476,131 @@ internal int sceneMazeStart(GameObject *objectArena, mesh_s *mesh,
   return objectIdx;
 }
 
-void AppClean(Scene *scn) {}
\ No newline at end of file
+// sceneLightFieldStart scatters small point lights of random colors over the
+// cells of the maze.
+internal void sceneLightFieldStart(light_s *lights, int count,
+                                   const pvs_s *pvs) {
+  vec3 size = vec3(pvs->size_x, pvs->size_y, pvs->size_z) * pvs->cell;
+  uint32_t seed = 20240611u;
+  auto next = [&seed]() {
+    seed = seed * 1664525u + 1013904223u;
+    return (seed >> 8) / 16777216.0f;
+  };
+
+  for (int i = 0; i < count; i++) {
+    light_s *l = &lights[i];
+    l->position = pvs->origin + vec3(next(), next(), next()) * size;
+    vec3 color = vec3(next(), next(), next());
+    color = color / glm::compMax(color);
+    l->specular = color * 0.6f;
+    l->diffuse = color * 0.3f;
+    l->ambient = vec3(0.0f);
+    l->constant = 1.0f;
+    l->linear = 0.7f;
+    l->quadratic = 1.8f;
+  }
+}
+
+// sceneStaticStart merges the maze objects that don't move into chunk
+// objects, one per StaticChunkCells square of a level and per pipeline,
+// light and material, appended after the others. Objects with textures or
+// out of the maze are left alone. Needs the pvs grid.
+internal bool sceneStaticStart(Scene *scn) {
+  static_batch_stats_s *st = &scn->static_stats;
+  pvs_s *pvs = &scn->pvs;
+  *st = {};
+  scn->static_first = scn->go_size;
+
+  // square of the level each chunk stands for
+  int regions[SceneStaticChunks];
+  for (int i = 0; i < scn->static_first; i++) {
+    GameObject *obj = &scn->go[i];
+    if (obj->moves || obj->cell < 0 || obj->mesh->textures_size > 0) {
+      continue;
+    }
+    int x, y, z;
+    pvs_cell_coords(pvs, obj->cell, &x, &y, &z);
+    int chunks_x = (pvs->size_x + StaticChunkCells - 1) / StaticChunkCells;
+    int chunks_z = (pvs->size_z + StaticChunkCells - 1) / StaticChunkCells;
+    int region = (y * chunks_x + x / StaticChunkCells) * chunks_z +
+                 z / StaticChunkCells;
+
+    int c = 0;
+    for (; c < st->chunks; c++) {
+      GameObject *chunk = &scn->go[scn->static_first + c];
+      if (regions[c] == region && chunk->pipeline == obj->pipeline &&
+          chunk->light == obj->light && chunk->mat_color == obj->mat_color) {
+        break;
+      }
+    }
+    if (c == st->chunks) {
+      // the rest is drawn object by object
+      if (st->chunks == SceneStaticChunks) {
+        continue;
+      }
+      regions[c] = region;
+      mesh_s *mesh = &scn->static_meshes[c];
+      MeshZero(mesh);
+      GameObject *chunk = &scn->go[scn->static_first + c];
+      *chunk = {};
+      chunk->instance = StaticInstance;
+      chunk->transform = mat4(1.0f);
+      chunk->mesh = mesh;
+      chunk->pipeline = obj->pipeline;
+      chunk->light = obj->light;
+      chunk->mat_color = obj->mat_color;
+      // the merged meshes don't fill their boxes
+      chunk->occluder = false;
+      chunk->cell = -1;
+      chunk->chunk = -1;
+      chunk->moves = false;
+      chunk->dirty = GO_DIRTY_ALL;
+      st->chunks++;
+    }
+
+    static_batch_append(&scn->static_meshes[c], obj->mesh, obj->transform);
+    obj->chunk = scn->static_first + c;
+    st->objects++;
+  }
+
+  for (int c = 0; c < st->chunks; c++) {
+    if (!MeshInitialize(&scn->static_meshes[c])) {
+      printf("static: no room for chunk %d\n", c);
+      return false;
+    }
+    st->bytes += static_batch_bytes(&scn->static_meshes[c]);
+  }
+  scn->go_size += st->chunks;
+
+  printf("static: %d objects in %d chunks, %zu KB more geometry for %d "
+         "instances less\n",
+         st->objects, st->chunks, st->bytes / 1024, st->objects - st->chunks);
+  return true;
+}
+
+void AppClean(Scene *scn) {
+  jobs_clean(&scn->jobs);
+  jobs_clean(&scn->record_jobs);
+  for (int i = 0; i < SceneSlices; i++) {
+    cmd_list_clean(&scn->slices[i].gbuffer);
+    cmd_list_clean(&scn->slices[i].opaque);
+  }
+  cmd_list_clean(&scn->immediate);
+  for (int i = 0; i < scn->static_stats.chunks; i++) {
+    MeshClean(&scn->static_meshes[i]);
+  }
+  clusters_clean(&scn->clusters);
+  occlusion_clean(&scn->occlusion);
+  pvs_clean(&scn->pvs);
+  query_pool_clean(&scn->queries);
+  frame_graph_clean(&scn->graph);
+  stream_clean(&scn->stream);
+  for (int i = 0; i < RENDER_THREAD_FRAMES; i++) {
+    instance_buffer_clean(&scn->frames[i].instances);
+    indirect_buffer_clean(&scn->frames[i].commands);
+  }
+  instance_buffer_clean(&scn->retained_instances);
+  for (int i = 0; i < COUNT_OF(scn->draw_timers); i++) {
+    gpu_query_destroy(&scn->draw_timers[i]);
+  }
+}
\ No newline at end of file
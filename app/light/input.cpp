@@ -11,7 +11,8 @@ internal void app_input(Scene *app, SDL_Event e) {
     if (e.window.event == SDL_WINDOWEVENT_RESIZED) {
       int g_screenWidth = e.window.data1;
       int g_screenHeight = e.window.data2;
-      glViewport(0, 0, g_screenWidth, g_screenHeight);
+      app->screen_width = g_screenWidth;
+      app->screen_height = g_screenHeight;
       // is it good to do this here?
       app->camera.aspect = (float)g_screenWidth / (float)g_screenHeight;
     }
@@ -62,6 +63,94 @@ internal void app_input(Scene *app, SDL_Event e) {
       }
       break;
     }
+    case SDLK_m: {
+      if (!pressed) {
+        app->multi_draw = !app->multi_draw;
+      }
+      break;
+    }
+    case SDLK_c: {
+      if (!pressed) {
+        app->cull_enabled = !app->cull_enabled;
+      }
+      break;
+    }
+    case SDLK_o: {
+      if (!pressed) {
+        app->occlusion_enabled = !app->occlusion_enabled;
+      }
+      break;
+    }
+    case SDLK_p: {
+      if (!pressed) {
+        app->pvs_enabled = !app->pvs_enabled;
+      }
+      break;
+    }
+    case SDLK_h: {
+      if (!pressed) {
+        app->query_enabled = !app->query_enabled;
+      }
+      break;
+    }
+    case SDLK_z: {
+      if (!pressed) {
+        app->depth_prepass = !app->depth_prepass;
+      }
+      break;
+    }
+    case SDLK_l: {
+      if (!pressed) {
+        // none, then doubling from 64 up to all of them
+        int size = app->light_field_size;
+        size = size == 0 ? 64 : (size >= LightFieldSize ? 0 : size * 2);
+        app->light_field_size = size < LightFieldSize ? size : LightFieldSize;
+      }
+      break;
+    }
+    case SDLK_g: {
+      if (!pressed) {
+        app->deferred = !app->deferred;
+      }
+      break;
+    }
+    case SDLK_r: {
+      if (!pressed) {
+        app->dynamic_resolution = !app->dynamic_resolution;
+      }
+      break;
+    }
+    case SDLK_k: {
+      if (!pressed) {
+        app->retain_enabled = !app->retain_enabled;
+      }
+      break;
+    }
+    case SDLK_b: {
+      if (!pressed) {
+        app->static_enabled = !app->static_enabled;
+      }
+      break;
+    }
+    case SDLK_j: {
+      if (!pressed) {
+        app->record_parallel = !app->record_parallel;
+      }
+      break;
+    }
+    case SDLK_t: {
+      if (!pressed) {
+        app->threaded = !app->threaded;
+      }
+      break;
+    }
+    case SDLK_f: {
+      if (!pressed) {
+        // 1, 2, 3 frames in flight, the render thread sets them
+        app->max_frames = app->max_frames % FRAME_PACER_MAX + 1;
+      }
+      break;
+    }
     case SDLK_LSHIFT: {
       app->camera.speed = pressed ? 10.0f : 5.0f;
       break;
@@ -3,30 +3,203 @@
 
 #include "unity.h"
 
+#include "cluster.h"
+#include "cull_gpu.h"
 #include "debug.h"
+#include "jobs.h"
+#include "occlusion.h"
+#include "pvs.h"
+#include "query.h"
+#include "resolution.h"
 #include "flycamera.h"
+#include "frame_pacer.h"
+#include "frame_graph.cpp"
 #include "mat_color.cpp"
 #include "mat_tex.cpp"
 // #include "mesh_renderer.h"
 #include "game_object.h"
+#include "instance.h"
+#include "cmd_list.cpp"
 #include "mesh.cpp"
 #include "mesh.h"
+#include "stream.cpp"
 #include "raycast.h"
+#include "render_queue.h"
+#include "render_thread.h"
+#include "renderer.h"
+#include "renderer_gl.cpp"
 #include "shader.h"
+#include "static_batch.h"
 #include "text.h"
 #include "texture.h"
+#include "transform.h"
 
 #include "example/cube_mesh.h"
 #include "example/cube_tex_mesh.h"
 #include "example/ramp_mesh.h"
+#include "example/volume_mesh.h"
 #include "light_shader.h"
 
 const int g_maze_size = 10;
 const int g_maze_objects = g_maze_size * g_maze_size * 3;
-const int GOSize = 4 + 1 + g_maze_objects;
+// objects that don't move are merged into chunks of StaticChunkCells by
+// StaticChunkCells cells of a maze level, see sceneStaticStart
+const int StaticChunkCells = 4;
+const int SceneStaticChunks = 64;
+const int GOSize = 4 + 1 + g_maze_objects + SceneStaticChunks;
 const int LampInstance = 12;
 const int BoxInstance = 13;
 const int MazeInstance = 14;
+const int StaticInstance = 15;
+
+// texture unit of the material table
+const int MaterialTableSlot = 8;
+// texture units of the clustered lights, see light_tex.frag
+const int ClusterGridSlot = 9;
+const int ClusterLightsSlot = 10;
+const int LightDataSlot = 11;
+// texture units of the G-buffer, see gbuffer.frag
+const int GAlbedoSpecSlot = 12;
+const int GNormalSlot = 13;
+const int GDepthSlot = 14;
+// texture unit of the scaled scene, see upscale.frag
+const int SceneColorSlot = 15;
+// point lights scattered over the maze, on top of the four lamps
+const int LightFieldSize = 256;
+
+// scene_batch_s is a run of GameObjects drawn with one instanced draw.
+struct scene_batch_s {
+  // first object of the batch, the others share its mesh, pipeline,
+  // material and light
+  GameObject *obj;
+  uint64_t key;
+
+  // instances come from the retained buffer of the Scene, first is an index
+  // into it, otherwise from the frame's
+  int first;
+  int count;
+  bool retained;
+};
+
+// scene_group_s is a run of batches drawn with one multi draw.
+struct scene_group_s {
+  int first;
+  int count;
+};
+
+// scene_slice_s is a run of groups one job worker records, the G-buffer
+// draws of it and the forward ones. Slices are replayed in order.
+const int SceneSlices = JOBS_MAX_WORKERS;
+
+struct scene_slice_s {
+  cmd_list_s gbuffer;
+  cmd_list_s opaque;
+  // CPU time of recording it
+  float ms;
+};
+
+// scene_retained_s is the draw list of the objects that don't move: their
+// packets sorted by state and their instances packed, in that order. It is
+// built again only when one of them is dirty, frames just pick out the
+// visible ones. Keys have no depth, a batch has its instances in object
+// order instead of front to back.
+struct scene_retained_s {
+  render_packet_s packets[GOSize];
+  instance_s instances[GOSize];
+  int size;
+  // an object in it changed, or one changed while retaining was off
+  bool stale;
+  int builds;
+};
+
+// scene_frame_s is what the update of a frame leaves for drawing it. The
+// render thread reads nothing else the update writes, the Scene fields it
+// reads are set once at init or are its own. The update fills one of
+// RENDER_THREAD_FRAMES of them while another is drawn.
+struct scene_frame_s {
+  Camera camera;
+  light_s dir_light;
+  light_s p_light[4];
+  light_s sp_light;
+  int screen_width;
+  int screen_height;
+
+  // switches as they were when the frame was updated
+  bool deferred;
+  bool depth_prepass;
+  bool multi_draw;
+  bool cull_enabled;
+  bool query_enabled;
+  bool pvs_enabled;
+  bool occlusion_enabled;
+  bool dynamic_resolution;
+  bool enable_maze;
+  bool threaded;
+  bool record_parallel;
+  bool retain_enabled;
+  bool static_enabled;
+  int max_frames;
+
+  // lights in view space, texels of light_data, and their clusters
+  vec4 light_data[(4 + LightFieldSize) * 4];
+  vec4 light_spheres[4 + LightFieldSize];
+  int lights_size;
+  float slice_scale;
+  float slice_bias;
+  uint32_t cluster_grid[CLUSTER_COUNT * 2];
+  uint16_t cluster_indices[CLUSTER_COUNT * CLUSTER_MAX_LIGHTS];
+  int cluster_indices_size;
+
+  // runs of the sorted lists become batches. instances holds those of the
+  // queue one after another, the retained ones stay in the Scene's buffer
+  // and a batch of them is a run of it. commands[i] draws batches[i], groups
+  // of batches with the same state and buffer go with one multi draw. Every
+  // frame has its own buffers, the GPU may still read the other frame's.
+  scene_batch_s batches[GOSize];
+  int batches_size;
+  scene_group_s groups[GOSize];
+  int groups_size;
+  instance_buffer_s instances;
+  indirect_buffer_s commands;
+  // copy of the retained instances of build retained_build, made when the
+  // list was built again since the snapshot was last filled. The render
+  // thread uploads them from here, only then.
+  instance_s retained[GOSize];
+  int retained_size;
+  int retained_build;
+  // what culling on the GPU needs per batch and per instance, the retained
+  // instances come first in instance_draw, hidden ones with no batch
+  cull_draw_s cull_draws[GOSize];
+  uint32_t instance_draw[GOSize];
+  // rows of the material table, see light_color.frag
+  vec4 materials[RENDER_IDS_MAX * 3];
+  int materials_size;
+
+  // objects drawn in occlusion queries and their boxes. The render thread
+  // writes back which of them the queries found hidden, the update that
+  // fills the snapshot next leaves them out.
+  uint8_t query_candidate[GOSize];
+  bounds_s query_boxes[GOSize];
+  uint8_t query_occluded[GOSize];
+  // GPU time of the frame graph when the render thread drew the snapshot,
+  // the update reads it from there once it has the snapshot back
+  float draw_ms;
+
+  // counters of the update for the overlay
+  int visible_count;
+  int culled_count;
+  int pvs_hidden_count;
+  int occluded_count;
+  int query_hidden_count;
+  int sort_unsorted;
+  int sort_sorted;
+  int retained_count;
+  int retain_builds;
+  int static_visible;
+  float occlusion_ms;
+  float cluster_ms;
+  float update_ms;
+};
 
 struct Scene {
   // glm::vec3 position;
@@ -55,14 +228,196 @@ struct Scene {
   Camera camera = {};
   shader_s lighting_shader = {};
   shader_s lamp_shader = {};
+  shader_s color_shader = {};
+
+  gpu_pipeline_s lighting_pipeline = {};
+  gpu_pipeline_s lamp_pipeline = {};
+  gpu_pipeline_s color_pipeline = {};
+  shader_s lighting_inst_shader = {};
+  gpu_pipeline_s lighting_inst_pipeline = {};
 
   light_s dir_light = {};
   light_s p_light[4] = {};
   light_s sp_light = {};
 
+  // point lights of the maze, they only exist in the light clusters.
+  // light_field_size of them are lit, l steps through counts to compare the
+  // forward and deferred paths.
+  light_s field_lights[LightFieldSize];
+  int light_field_size = LightFieldSize;
+
+  // point lights are culled into clusters of the view frustum every frame,
+  // shading loops over the lights of its fragment's cluster
+  clusters_s clusters = {};
+  gpu_buffer_s light_buf = {};
+  gpu_buffer_s cluster_grid_buf = {};
+  gpu_buffer_s cluster_index_buf = {};
+  gpu_texture_s light_data = {};
+  gpu_texture_s cluster_grid = {};
+  gpu_texture_s cluster_lights = {};
+  // assignment and upload, averaged over frames
+  float cluster_ms = 0.0f;
+  // size of the window
+  int screen_width = 0;
+  int screen_height = 0;
+
+  // dynamic resolution: the scene is drawn to the render size part of a
+  // window size target and upscaled into the window, the overlay is drawn
+  // at the window size on top. Tiles of the clusters are fractions of the
+  // render size.
+  resolution_s resolution = {};
+  bool dynamic_resolution = false;
+  int render_width = 0;
+  int render_height = 0;
+  // resource of the frame graph the scene is drawn to, the window itself
+  // without dynamic resolution
+  int scene = -1;
+  shader_s upscale_shader = {};
+  gpu_pipeline_s upscale_pipeline = {};
+
+  // deferred path: groups drawn with lighting_inst_pipeline write their
+  // surfaces to the G-buffer, lights are then added to the window one volume
+  // at a time. Everything else is still drawn forward on top of it.
+  bool deferred = false;
+  // resource of the frame graph
+  int gbuffer = -1;
+  gpu_input_s fullscreen_input = {};
+  mesh_s sphere_volume = {};
+  mesh_s cone_volume = {};
+  shader_s gbuffer_shader = {};
+  shader_s deferred_dir_shader = {};
+  shader_s deferred_point_shader = {};
+  shader_s deferred_spot_shader = {};
+  gpu_pipeline_s gbuffer_pipeline = {};
+  gpu_pipeline_s deferred_dir_pipeline = {};
+  gpu_pipeline_s volume_mark_pipeline = {};
+  gpu_pipeline_s deferred_point_pipeline = {};
+  gpu_pipeline_s deferred_spot_pipeline = {};
+  // point light volumes drawn in the last frame
+  int volume_count = 0;
+
+  // passes of the frame, declared again every frame
+  frame_graph_s graph;
+
+  // GPU time of the frame graph, averaged over frames. Timers are read a few
+  // frames later so the CPU never waits for them.
+  gpu_query_s draw_timers[4];
+  bool draw_timer_pending[4];
+  int draw_timer = 0;
+  float draw_ms = 0.0f;
+
+  // GPU data written every frame and read once
+  stream_buffer_s stream = {};
   text_s text_renderer = {};
 
   GameObject go[GOSize];
+  int go_size = 0;
+
+  // normals[i] is the normal matrix of the go[i] transform, made when the
+  // object moves or is dirty.
+  glm::mat3 normals[GOSize];
+
+  // go[i] is submitted only when visible[i], its world space bounding sphere
+  // is inside the view frustum
+  vec4 spheres[GOSize];
+  uint8_t visible[GOSize];
+  int visible_count = 0;
+  int culled_count = 0;
+
+  // maze cells visible from each other, built at load
+  pvs_s pvs = {};
+  bool pvs_enabled = true;
+  int pvs_hidden_count = 0;
+
+  // opaque batches are drawn depth only from the position stream first, the
+  // lit pass then shades only the fragments that stay visible
+  shader_s depth_shader = {};
+  gpu_pipeline_s depth_pipeline = {};
+  bool depth_prepass = false;
+
+  // boxes of objects that passed the other culling are drawn in occlusion
+  // queries after the opaque pass, objects hidden then are left out in a
+  // later frame
+  query_pool_s queries = {};
+  query_slot_s query_slots[GOSize];
+  shader_s bounds_shader = {};
+  gpu_pipeline_s bounds_pipeline = {};
+  mesh_s *box_mesh = NULL;
+  bool query_enabled = true;
+  int query_hidden_count = 0;
+  int query_issued_count = 0;
+
+  // occluders are rasterized on the job workers while the main thread
+  // builds the draw lists, objects behind them are taken out of visible
+  jobs_s jobs = {};
+  occlusion_s occlusion = {};
+  bool occlusion_enabled = true;
+  int occluded_count = 0;
+  // from the dispatch to the last test, the draw lists are built in between
+  float occlusion_ms = 0.0f;
+  Uint64 occlusion_start = 0;
+
+  // GameObjects go through the render queue every frame, see scene_frame_s
+  // for the batches made of it
+  render_queue_s queue = {};
+  render_ids_s pipeline_ids = {};
+  render_ids_s material_ids = {};
+  render_ids_s mesh_ids = {};
+  bool multi_draw = true;
+  // k draws every object through the queue, as if they all moved
+  scene_retained_s retained = {};
+  bool retain_enabled = true;
+  // the retained instances on the GPU, written by the render thread when a
+  // frame brings a build it hasn't uploaded
+  instance_buffer_s retained_instances = {};
+  int retained_uploaded = 0;
+  // CPU time of replaying the batches, averaged over frames
+  float submit_ms = 0.0f;
+
+  // static batches: objects that never move are merged into chunk objects,
+  // go[static_first] on, drawn in their place. b switches back to drawing
+  // the objects themselves.
+  mesh_s static_meshes[SceneStaticChunks] = {};
+  static_batch_stats_s static_stats = {};
+  int static_first = 0;
+  bool static_enabled = true;
+  // chunks drawn in the last update
+  int static_visible = 0;
+
+  // job workers of the render thread record the groups into slices while
+  // the passes before them run, j records them all on the render thread
+  jobs_s record_jobs = {};
+  scene_slice_s slices[SceneSlices] = {};
+  int slices_size = 0;
+  bool record_parallel = true;
+  // CPU time of recording, summed over the slices and averaged over frames
+  float record_ms = 0.0f;
+  // commands the render thread records and replays right away
+  cmd_list_s immediate = {};
+
+  // rows of the material table are the mat_color ids
+  render_ids_s mat_color_ids = {};
+  gpu_buffer_s material_buf = {};
+  gpu_texture_s material_table = {};
+
+  // culling on the GPU, when the context can do it. Draws and instances are
+  // described to it per batch, visibility never comes back to the CPU.
+  cull_gpu_s cull = {};
+  bool cull_available = false;
+  bool cull_enabled = true;
+
+  // frames are updated on the main thread and drawn on the render thread,
+  // t switches to waiting for each frame to be drawn before the next update
+  // to compare. frame is the snapshot being drawn.
+  scene_frame_s frames[RENDER_THREAD_FRAMES];
+  scene_frame_s *frame = NULL;
+  bool threaded = true;
+  // frames in flight, see frame_pacer_s
+  int max_frames = 2;
+  // CPU time of the update and time between drawn frames, averaged
+  float update_ms = 0.0f;
+  float frame_ms = 0.0f;
+  Uint64 frame_start = 0;
 };
 
 #define internal static
@@ -71,7 +426,8 @@ internal bool app_init(Scene *app);
 internal bool app_init_tex(Scene *app, GLuint *tex_unit, const char *path,
                            GLenum tex_unit_enum);
 
-internal void app_render_mat_color_cube(Scene *app, mesh_s *cube, shader_s *sh,
+internal void app_render_mat_color_cube(Scene *app, mesh_s *cube,
+                                        gpu_pipeline_s *pipeline,
                                         glm::mat4 model, Camera *camera,
                                         light_s *light);
 
@@ -83,12 +439,63 @@ internal void draw_maze(Scene *app, Camera *camera);
 internal void draw_ramp1(Scene *app, Camera *camera);
 internal void draw_ramp2(Scene *app, Camera *camera);
 
-internal void sceneLampDraw(Scene *scene, GameObject *lamp);
+internal void sceneLampUpdate(GameObject *lamp);
+internal light_s *sceneFrameLight(Scene *scn, light_s *light);
 internal void draw_material_preview(Scene *app, Camera *camera);
-internal void sceneRenderMatColor(Scene *scn, GameObject *obj);
+internal void sceneClusterLights(Scene *scn, scene_frame_s *f);
+internal void sceneRecordClusters(Scene *scn, cmd_list_s *cl,
+                                const shader_s *sh);
+internal void sceneBindClusters(Scene *scn, const shader_s *sh);
+internal void sceneRetainUpdate(Scene *scn);
+internal void sceneRetainBuild(Scene *scn);
+internal uint64_t sceneObjectKey(Scene *scn, int i, float depth);
+internal void sceneObjectInstance(Scene *scn, int i, instance_s *inst);
+internal void sceneFrustumCull(Scene *scn);
+internal void sceneStaticHide(Scene *scn);
+internal void sceneStaticResolve(Scene *scn);
+internal void scenePvsCull(Scene *scn);
+internal void sceneOcclusionBegin(Scene *scn);
+internal void sceneOcclusionEnd(Scene *scn);
+internal void sceneQueryCull(Scene *scn, scene_frame_s *f);
+internal void sceneQueryPoll(Scene *scn);
+internal void sceneQueryIssue(Scene *scn);
+internal void sceneQueueObjects(Scene *scn);
+internal void sceneGatherBatches(Scene *scn, scene_frame_s *f);
+internal instance_buffer_s *sceneBatchInstances(Scene *scn,
+                                                scene_batch_s *batch);
+internal void sceneUploadFrame(Scene *scn);
+internal void sceneDepthPrepass(Scene *scn);
+internal bool sceneSameState(scene_batch_s *a, scene_batch_s *b);
+internal float sceneShininess(GameObject *obj);
+internal bool sceneSameGroup(scene_batch_s *a, scene_batch_s *b);
+internal void sceneRecordGroup(Scene *scn, cmd_list_s *cl, int group,
+                               const gpu_pipeline_s *pipeline,
+                               bool bind_state);
+internal void sceneRecordSlice(void *data, int index);
+internal void sceneRecordBegin(Scene *scn);
+internal void sceneRecordWait(Scene *scn);
+internal bool sceneDeferredGroup(Scene *scn, int group);
+internal void sceneDeferredGeometry(Scene *scn, const gpu_target_s *gb);
+internal void sceneDeferredLighting(Scene *scn, const gpu_target_s *gb);
+internal void sceneDeclarePasses(Scene *scn);
+internal void sceneBindScene(frame_graph_s *fg, Scene *scn);
+internal void scenePassClear(frame_graph_s *fg, void *data);
+internal void scenePassCull(frame_graph_s *fg, void *data);
+internal void scenePassGeometry(frame_graph_s *fg, void *data);
+internal void scenePassLighting(frame_graph_s *fg, void *data);
+internal void scenePassPrepass(frame_graph_s *fg, void *data);
+internal void scenePassOpaque(frame_graph_s *fg, void *data);
+internal void scenePassQueries(frame_graph_s *fg, void *data);
+internal void scenePassPyramid(frame_graph_s *fg, void *data);
+internal void scenePassUpscale(frame_graph_s *fg, void *data);
+internal void scenePassOverlay(frame_graph_s *fg, void *data);
 
 internal int sceneMazeStart(GameObject *objectArena, mesh_s *mesh,
-                            shader_s *shader, light_s *lightSource);
+                            gpu_pipeline_s *pipeline, light_s *lightSource,
+                            pvs_s *pvs);
+internal void sceneLightFieldStart(light_s *lights, int count,
+                                   const pvs_s *pvs);
+internal bool sceneStaticStart(Scene *scn);
 
 int rnd = 41241515;
 int rnd_mod = 489414;
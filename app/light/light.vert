@@ -3,18 +3,19 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// computed once per object on the CPU, see xform_batch
+uniform mat4 modelView;
+uniform mat4 mvp;
+uniform mat3 normalMatrix;
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
 
 void main() {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = mvp * vec4(aPos, 1.0);
 
-    FragPos = vec3(view * model * vec4(aPos, 1.0));
-    Normal = vec3(transpose(inverse(view)) * transpose(inverse(model)) * vec4(aNormal, 0.0));
+    FragPos = vec3(modelView * vec4(aPos, 1.0));
+    Normal = normalMatrix * aNormal;
     TexCoords = aTexCoords;
-}
\ No newline at end of file
+}
@@ -15,7 +15,22 @@ struct Light {
     vec3 specular;
 };
 
-uniform Material material;
+// material table, three texels per material:
+// ambient + shininess, diffuse, specular
+uniform samplerBuffer materials;
+flat in uint MaterialIndex;
+
+Material FetchMaterial(uint idx) {
+    int base = int(idx) * 3;
+    vec4 ambient = texelFetch(materials, base);
+    Material m;
+    m.ambient = ambient.rgb;
+    m.shininess = ambient.a;
+    m.diffuse = texelFetch(materials, base + 1).rgb;
+    m.specular = texelFetch(materials, base + 2).rgb;
+    return m;
+}
+
 uniform Light light;
 
 out vec4 FragColor;
@@ -26,6 +41,8 @@ in vec3 Normal;
 uniform vec3 viewPos;
 
 void main() {
+    Material material = FetchMaterial(MaterialIndex);
+
     // diffuse
     vec3 norm = normalize(Normal);
     vec3 lightDir = normalize(light.position - FragPos);
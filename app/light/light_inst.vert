@@ -0,0 +1,34 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+// per instance, see instance_s
+layout (location = 3) in mat4 iModel;
+layout (location = 7) in mat3 iNormalMatrix;
+layout (location = 10) in vec4 iColor;
+layout (location = 11) in uint iMaterial;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+out vec4 Color;
+flat out uint MaterialIndex;
+
+// must match depth_inst.vert bit for bit, see the depth pre-pass
+invariant gl_Position;
+
+void main() {
+    vec4 viewPos = view * (iModel * vec4(aPos, 1.0));
+    gl_Position = projection * viewPos;
+
+    FragPos = vec3(viewPos);
+    // the view is rigid, its rotation keeps normals perpendicular
+    Normal = mat3(view) * (iNormalMatrix * aNormal);
+    TexCoords = aTexCoords;
+    Color = iColor;
+    MaterialIndex = iMaterial;
+}
@@ -3,7 +3,9 @@
 
 #include "unity.h"
 
+#include "cmd_list.h"
 #include "shader.h"
+#include "transform.h"
 
 struct light_s {
   // coords and directions must be in view space
@@ -25,7 +27,7 @@ struct light_s {
 
 };
 
-void shader_set_light(shader_s* sh, light_s* light) {
+void shader_set_light(const shader_s* sh, light_s* light) {
   shader_use(sh);
 
   shader_3f(sh, "light.ambient", light->ambient.r, light->ambient.g,
@@ -44,7 +46,7 @@ void shader_set_light(shader_s* sh, light_s* light) {
             light->position.z);
 }
 
-void shader_set_dirlight(shader_s* sh, light_s* l) {
+void shader_set_dirlight(const shader_s* sh, light_s* l) {
   shader_use(sh);
   shader_3f(sh, "dirLight.ambient", l->ambient.r, l->ambient.g, l->ambient.b);
   shader_3f(sh, "dirLight.diffuse", l->diffuse.r, l->diffuse.g, l->diffuse.b);
@@ -55,34 +57,7 @@ void shader_set_dirlight(shader_s* sh, light_s* l) {
             l->direction.z);
 }
 
-void shader_set_pointlight(shader_s* sh, mat4 view, light_s* l, int l_idx) {
-  char key[50];
-  shader_use(sh);
-
-  sprintf(key, "pointLights[%d].%s", l_idx, "position");
-  vec3 position = vec3(view * vec4(l->position, 1.0f));
-  shader_3f(sh, key, position.x, position.y, position.z);
-
-  sprintf(key, "pointLights[%d].%s", l_idx, "ambient");
-  shader_3f(sh, key, l->ambient.x, l->ambient.y, l->ambient.z);
-
-  sprintf(key, "pointLights[%d].%s", l_idx, "diffuse");
-  shader_3f(sh, key, l->diffuse.x, l->diffuse.y, l->diffuse.z);
-
-  sprintf(key, "pointLights[%d].%s", l_idx, "specular");
-  shader_3f(sh, key, l->specular.x, l->specular.y, l->specular.z);
-
-  sprintf(key, "pointLights[%d].%s", l_idx, "constant");
-  shader_1f(sh, key, l->constant);
-
-  sprintf(key, "pointLights[%d].%s", l_idx, "linear");
-  shader_1f(sh, key, l->linear);
-
-  sprintf(key, "pointLights[%d].%s", l_idx, "quadratic");
-  shader_1f(sh, key, l->quadratic);
-}
-
-void shader_set_spotlight(shader_s* sh, light_s* l) {
+void shader_set_spotlight(const shader_s* sh, light_s* l) {
   shader_use(sh);
   shader_3f(sh, "spotLight.position", l->position.x, l->position.y,
             l->position.z);
@@ -96,26 +71,93 @@ void shader_set_spotlight(shader_s* sh, light_s* l) {
   shader_1f(sh, "spotLight.outerCutOff", l->outerCutOff);
 }
 
-void shader_set_lightsrc(shader_s* sh, glm::vec3 col) {
+void shader_set_lightsrc(const shader_s* sh, glm::vec3 col) {
   shader_use(sh);
   shader_3f(sh, "lightColor", col.x, col.y, col.z);
 }
 
-void shader_set_transform(shader_s* sh, glm::mat4 model, glm::mat4 view,
-                          glm::mat4 proj) {
-  shader_mat4fv(sh, "model", glm::value_ptr(model));
+// shader_set_projection_and_viewpos sets what instanced shaders share, the
+// rest of the transform comes with instance_s.
+void shader_set_projection_and_viewpos(const shader_s* sh, mat4 projection,
+                                       mat4 view, vec3 camera_pos_view) {
+  shader_use(sh);
+  shader_3f(sh, "viewPos", camera_pos_view.x, camera_pos_view.y,
+            camera_pos_view.z);
+  shader_mat4fv(sh, "projection", glm::value_ptr(projection));
   shader_mat4fv(sh, "view", glm::value_ptr(view));
-  shader_mat4fv(sh, "projection", glm::value_ptr(proj));
 }
 
-void shader_set_transform_and_viewpos(shader_s* sh, mat4 model, mat4 view,
-                       mat4 proj, vec3 camera_pos_view) {
+// cmd_set_* record what the shader_set_* above set, see cmd_list_s.
+void cmd_set_light(cmd_list_s* cl, const shader_s* sh, const light_s* l) {
+  cmd_uniform_3f(cl, sh, "light.ambient", l->ambient.r, l->ambient.g,
+                 l->ambient.b);
+  cmd_uniform_3f(cl, sh, "light.diffuse", l->diffuse.r, l->diffuse.g,
+                 l->diffuse.b);
+  cmd_uniform_3f(cl, sh, "light.specular", l->specular.r, l->specular.g,
+                 l->specular.b);
+  cmd_uniform_3f(cl, sh, "light.direction", l->direction.x, l->direction.y,
+                 l->direction.z);
+  cmd_uniform_3f(cl, sh, "light.position", l->position.x, l->position.y,
+                 l->position.z);
+}
+
+void cmd_set_dirlight(cmd_list_s* cl, const shader_s* sh, const light_s* l) {
+  cmd_uniform_3f(cl, sh, "dirLight.ambient", l->ambient.r, l->ambient.g,
+                 l->ambient.b);
+  cmd_uniform_3f(cl, sh, "dirLight.diffuse", l->diffuse.r, l->diffuse.g,
+                 l->diffuse.b);
+  cmd_uniform_3f(cl, sh, "dirLight.specular", l->specular.r, l->specular.g,
+                 l->specular.b);
+  cmd_uniform_3f(cl, sh, "dirLight.direction", l->direction.x,
+                 l->direction.y, l->direction.z);
+}
+
+void cmd_set_spotlight(cmd_list_s* cl, const shader_s* sh, const light_s* l) {
+  cmd_uniform_3f(cl, sh, "spotLight.position", l->position.x, l->position.y,
+                 l->position.z);
+  cmd_uniform_3f(cl, sh, "spotLight.direction", l->direction.x,
+                 l->direction.y, l->direction.z);
+  cmd_uniform_3f(cl, sh, "spotLight.ambient", l->ambient.x, l->ambient.y,
+                 l->ambient.z);
+  cmd_uniform_3f(cl, sh, "spotLight.diffuse", l->diffuse.x, l->diffuse.y,
+                 l->diffuse.z);
+  cmd_uniform_3f(cl, sh, "spotLight.specular", l->specular.x, l->specular.y,
+                 l->specular.z);
+  cmd_uniform_1f(cl, sh, "spotLight.cutOff", l->cutOff);
+  cmd_uniform_1f(cl, sh, "spotLight.outerCutOff", l->outerCutOff);
+}
+
+void cmd_set_projection_and_viewpos(cmd_list_s* cl, const shader_s* sh,
+                                    mat4 projection, mat4 view,
+                                    vec3 camera_pos_view) {
+  cmd_uniform_3f(cl, sh, "viewPos", camera_pos_view.x, camera_pos_view.y,
+                 camera_pos_view.z);
+  cmd_uniform_mat4fv(cl, sh, "projection", glm::value_ptr(projection));
+  cmd_uniform_mat4fv(cl, sh, "view", glm::value_ptr(view));
+}
+
+void shader_set_transform(const shader_s* sh, const xform_s* x) {
+  shader_use(sh);
+  shader_mat4fv(sh, "modelView", glm::value_ptr(x->model_view));
+  shader_mat4fv(sh, "mvp", glm::value_ptr(x->mvp));
+  shader_mat3fv(sh, "normalMatrix", glm::value_ptr(x->normal));
+}
+
+// shader_set_world_transform sets what light_world_space.vert places the
+// object with, x is made with no view and the view projection as projection,
+// its model_view is the model then.
+void shader_set_world_transform(const shader_s* sh, const xform_s* x) {
+  shader_use(sh);
+  shader_mat4fv(sh, "model", glm::value_ptr(x->model_view));
+  shader_mat4fv(sh, "mvp", glm::value_ptr(x->mvp));
+  shader_mat3fv(sh, "modelNormalMatrix", glm::value_ptr(x->normal));
+}
+
+void shader_set_transform_and_viewpos(const shader_s* sh, const xform_s* x,
+                                      vec3 camera_pos_view) {
   shader_use(sh);
   shader_3f(sh, "viewPos", camera_pos_view.x, camera_pos_view.y,
             camera_pos_view.z);
-
-  shader_mat4fv(sh, "model", glm::value_ptr(model));
-  shader_mat4fv(sh, "view", glm::value_ptr(view));
-  shader_mat4fv(sh, "projection", glm::value_ptr(proj));
+  shader_set_transform(sh, x);
 }
 #endif
\ No newline at end of file
@@ -1,8 +1,9 @@
 #version 330 core
 out vec4 FragColor;
 
-uniform vec3 lightColor;
+// light color of the lamp instance
+in vec4 Color;
 
 void main() {
-    FragColor = vec4(lightColor, 1.0f);
-}
\ No newline at end of file
+    FragColor = Color;
+}
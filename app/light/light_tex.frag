@@ -78,6 +78,7 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir) {
 
 struct PointLight {
     vec3 position;
+    float range;
 
     vec3 ambient;
     vec3 diffuse;
@@ -88,8 +89,43 @@ struct PointLight {
     float quadratic;
 };
 
-#define NR_POINT_LIGHTS 4
-uniform PointLight pointLights[NR_POINT_LIGHTS];
+// point lights are culled into clusters of the view frustum, see cluster.h.
+// Lights of a cluster are clusterLights[offset, offset + count) of its
+// clusterGrid texel, every light is four lightData texels:
+// position + range, diffuse + constant, specular + linear, ambient + quadratic
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterLights;
+uniform samplerBuffer lightData;
+// tiles per pixel, and the slice of a depth d is log(d) * x + y
+uniform vec2 clusterTileScale;
+uniform vec2 clusterSlice;
+const ivec3 clusterDim = ivec3(16, 9, 24);
+
+PointLight FetchPointLight(int idx) {
+    int base = idx * 4;
+    vec4 t0 = texelFetch(lightData, base);
+    vec4 t1 = texelFetch(lightData, base + 1);
+    vec4 t2 = texelFetch(lightData, base + 2);
+    vec4 t3 = texelFetch(lightData, base + 3);
+    PointLight l;
+    l.position = t0.xyz;
+    l.range = t0.w;
+    l.diffuse = t1.rgb;
+    l.constant = t1.a;
+    l.specular = t2.rgb;
+    l.linear = t2.a;
+    l.ambient = t3.rgb;
+    l.quadratic = t3.a;
+    return l;
+}
+
+int ClusterIndex(vec3 fragPos) {
+    ivec2 tile = ivec2(gl_FragCoord.xy * clusterTileScale);
+    tile = clamp(tile, ivec2(0), clusterDim.xy - 1);
+    int slice = int(floor(log(-fragPos.z) * clusterSlice.x + clusterSlice.y));
+    slice = clamp(slice, 0, clusterDim.z - 1);
+    return (slice * clusterDim.y + tile.y) * clusterDim.x + tile.x;
+}
 
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 viewDir, vec3 fragPos) {
     vec3 lightDir = normalize(light.position - fragPos);
@@ -99,6 +135,9 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 viewDir, vec3 fragPos) {
 
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // fades to zero at the range, lights of other clusters stop there
+    float window = clamp(1.0 - pow(distance / light.range, 4.0), 0.0, 1.0);
+    attenuation *= window * window;
 
 
     vec3 ambient = light.ambient * GetDiffuseColor(TexCoords);
@@ -157,9 +196,11 @@ void main() {
 
     result += CalcDirLight(dirLight, norm, viewDir);
 
-    for(int i = 0; i < NR_POINT_LIGHTS; i++)
-    result += CalcPointLight(pointLights[i], norm, viewDir, FragPos);
-    // result += CalcPointLight(pointLights[1], norm, viewDir, FragPos);
+    uvec2 cluster = texelFetch(clusterGrid, ClusterIndex(FragPos)).xy;
+    for (uint i = 0u; i < cluster.y; i++) {
+        int idx = int(texelFetch(clusterLights, int(cluster.x + i)).r);
+        result += CalcPointLight(FetchPointLight(idx), norm, viewDir, FragPos);
+    }
 
     result += CalcSpotLight(spotLight, norm, viewDir);
 
@@ -2,9 +2,10 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// computed once per object on the CPU, see xform_batch
+uniform mat4 modelView;
+uniform mat4 mvp;
+uniform mat3 normalMatrix;
 
 uniform vec3 lightPos;
 uniform vec3 viewPos;
@@ -16,10 +17,10 @@ out vec3 Normal;
 out vec3 ourColor;
 
 void main() {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = mvp * vec4(aPos, 1.0);
 
-    FragPos = vec3(view * model * vec4(aPos, 1.0));
-    Normal = vec3(transpose(inverse(view)) * transpose(inverse(model)) * vec4(aNormal, 0.0));
+    FragPos = vec3(modelView * vec4(aPos, 1.0));
+    Normal = normalMatrix * aNormal;
 
     float ambientStrength = 0.5;
     float ambient = ambientStrength;
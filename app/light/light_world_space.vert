@@ -2,17 +2,19 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 
+// set with shader_set_world_transform
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat4 mvp;
+// inverse transpose of the model matrix, computed on the CPU
+uniform mat3 modelNormalMatrix;
 
 out vec3 FragPos;
 out vec3 Normal;
 
 void main() {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = mvp * vec4(aPos, 1.0);
 
     FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = vec3(transpose(inverse(model)) * vec4(aNormal, 0.0));
+    Normal = modelNormalMatrix * aNormal;
 
-}
\ No newline at end of file
+}
@@ -203,7 +203,7 @@ global_variable mat_color_s g_mat_color_materials[] = {g_mat_sh_0};
 //   g_red_rubber,     g_white_rubber,  g_yellow_rubber,
 // };
 
-internal void mat_color_apply(mat_color_s mat, shader_s *shader) {
+internal void mat_color_apply(mat_color_s mat, const shader_s *shader) {
   shader_3f(shader, "material.ambient", mat.ambient.r, mat.ambient.g,
             mat.ambient.b);
   shader_3f(shader, "material.diffuse", mat.diffuse.r, mat.diffuse.g,
@@ -1,6 +1,11 @@
 #include "light.h"
 
-void app_scene_mat_view_render(Scene *app, float dt) {
+// app_update_frame runs the simulation and culling of a frame and leaves
+// what drawing it needs in snapshot frame. No GL, it runs alongside the
+// render thread.
+void app_update_frame(Scene *app, float dt, int frame) {
+  Uint64 update_start = SDL_GetPerformanceCounter();
+  scene_frame_s *f = &app->frames[frame];
   Camera *camera = &app->camera;
   flycamera_update(camera, dt);
 
@@ -31,59 +36,151 @@ void app_scene_mat_view_render(Scene *app, float dt) {
   light_s g_light = app->p_light[0];
 
   app_update_dirlight(&app->dir_light, camViewMat(camera));
+  sceneClusterLights(app, f);
 
-  shader_use(&app->lighting_shader);
-  shader_1i(&app->lighting_shader, "material.diffuse", 0);
-  shader_1i(&app->lighting_shader, "material.specular", 1);
-
-  draw_material_preview(app, &app->camera);
+  for (int i = 0; i < app->go_size; i++) {
+    if (app->go[i].instance == LampInstance) {
+      sceneLampUpdate(&app->go[i]);
+    }
+  }
 
-  if (app->enable_maze) {
-    sceneDrawCube(app, camera);
-    // draw_maze(app, camera);
-    draw_ramp1(app, camera);
-    draw_ramp2(app, camera);
+  // only what moved or changed is looked at again
+  sceneRetainUpdate(app);
+
+  // the render thread is busy with the previous frame while the occluders
+  // are rasterized
+  sceneFrustumCull(app);
+  sceneStaticHide(app);
+  scenePvsCull(app);
+  sceneOcclusionBegin(app);
+
+  // the draw lists don't wait for the occluders, what they hide is skipped
+  // when the batches are gathered
+  sceneRetainBuild(app);
+  sceneQueueObjects(app);
+  sceneOcclusionEnd(app);
+  sceneQueryCull(app, f);
+  sceneStaticResolve(app);
+  // objects sharing mesh, pipeline and material go with one draw
+  sceneGatherBatches(app, f);
+
+  scene_retained_s *r = &app->retained;
+  if (f->retained_build != r->builds) {
+    memcpy(f->retained, r->instances, r->size * sizeof(instance_s));
+    f->retained_size = r->size;
+    f->retained_build = r->builds;
   }
 
-  for (int i = 0; i < GOSize; i++) {
-    GameObject *obj = &app->go[i];
-    switch (obj->instance) {
-    case LampInstance: {
-      sceneLampDraw(app, obj);
-      break;
-    }
-    case BoxInstance: {
-      sceneRenderMatColor(app, obj);
-      break;
-    }
-    case MazeInstance: {
-      // sceneDrawCube(app, camera);
-      sceneRenderMatColor(app, obj);
-      // draw_ramp1(app, camera);
-      // draw_ramp2(app, camera);
-      break;
-    }
+  f->camera = app->camera;
+  f->dir_light = app->dir_light;
+  for (int i = 0; i < 4; i++) {
+    f->p_light[i] = app->p_light[i];
+  }
+  f->sp_light = app->sp_light;
+  f->screen_width = app->screen_width;
+  f->screen_height = app->screen_height;
+  f->deferred = app->deferred;
+  f->depth_prepass = app->depth_prepass;
+  f->multi_draw = app->multi_draw;
+  f->cull_enabled = app->cull_available && app->cull_enabled;
+  f->query_enabled = app->query_enabled;
+  f->pvs_enabled = app->pvs_enabled;
+  f->occlusion_enabled = app->occlusion_enabled;
+  f->dynamic_resolution = app->dynamic_resolution;
+  f->enable_maze = app->enable_maze;
+  f->threaded = app->threaded;
+  f->record_parallel = app->record_parallel;
+  f->retain_enabled = app->retain_enabled;
+  f->static_enabled = app->static_enabled;
+  f->max_frames = app->max_frames;
+
+  f->visible_count = app->visible_count;
+  f->culled_count = app->culled_count;
+  f->pvs_hidden_count = app->pvs_hidden_count;
+  f->occluded_count = app->occluded_count;
+  f->query_hidden_count = app->query_hidden_count;
+  f->sort_unsorted = render_queue_stats_total(app->queue.unsorted);
+  f->sort_sorted = render_queue_stats_total(app->queue.sorted);
+  f->retained_count = app->retained.size;
+  f->retain_builds = app->retained.builds;
+  f->static_visible = app->static_visible;
+  f->occlusion_ms = app->occlusion_ms;
+  f->cluster_ms = app->cluster_ms;
+
+  float ms = (SDL_GetPerformanceCounter() - update_start) * 1000.0f /
+             SDL_GetPerformanceFrequency();
+  app->update_ms = app->update_ms * 0.95f + ms * 0.05f;
+  f->update_ms = app->update_ms;
+}
 
-    default: {
-      break;
-    }
+// app_render_frame draws snapshot frame, on the thread owning the context.
+void app_render_frame(Scene *app, int frame) {
+  scene_frame_s *f = &app->frames[frame];
+  app->frame = f;
+  frame_pacer_set_frames(f->max_frames);
+
+  Uint64 now = SDL_GetPerformanceCounter();
+  if (app->frame_start != 0) {
+    float ms = (now - app->frame_start) * 1000.0f /
+               SDL_GetPerformanceFrequency();
+    app->frame_ms = app->frame_ms * 0.95f + ms * 0.05f;
+  }
+  app->frame_start = now;
+
+  // the scale is the one picked from the timers of earlier frames
+  float scale = f->dynamic_resolution ? app->resolution.scale : 1.0f;
+  app->render_width = (int)(f->screen_width * scale);
+  app->render_height = (int)(f->screen_height * scale);
+  app->render_width = app->render_width > 1 ? app->render_width : 1;
+  app->render_height = app->render_height > 1 ? app->render_height : 1;
+
+  // the instances of the frame go to the stream, it starts before them
+  stream_begin(&app->stream);
+  sceneUploadFrame(app);
+  sceneQueryPoll(app);
+
+  // GPU work of the frame, the graph leaves out what nothing reads
+  frame_graph_s *fg = &app->graph;
+  frame_graph_begin(fg);
+  sceneDeclarePasses(app);
+  if (!frame_graph_compile(fg)) {
+    stream_end(&app->stream);
+    return;
+  }
+  // the slices are recorded while the passes before the groups run
+  sceneRecordBegin(app);
+
+  int timer = app->draw_timer;
+  app->draw_timer = (timer + 1) % COUNT_OF(app->draw_timers);
+  float draw_ms = 0.0f;
+  if (app->draw_timer_pending[timer] &&
+      gpu_timer_result(app->draw_timers[timer], &draw_ms)) {
+    app->draw_timer_pending[timer] = false;
+    app->draw_ms = app->draw_ms * 0.95f + draw_ms * 0.05f;
+    // the controller filters on its own, it has to see changes quickly
+    if (f->dynamic_resolution) {
+      resolution_update(&app->resolution, draw_ms);
     }
   }
-
-  int text_y = 20;
-  text_draw(&app->text_renderer, 10, 20, "Hello, world!");
-  text_y += 32;
-  char buf[50];
-  for (int i = 0; i < 4; i++) {
-    sprintf(buf, "[%.2f; %.2f; %.2f]", app->p_light[i].position.x,
-            app->p_light[i].position.y, app->p_light[i].position.z);
-    text_draw(&app->text_renderer, 10, text_y, buf);
-    text_y += 32;
+  f->draw_ms = app->draw_ms;
+  bool timed = !app->draw_timer_pending[timer];
+  if (timed) {
+    gpu_timer_begin(app->draw_timers[timer]);
+  }
+  frame_graph_execute(fg);
+  stream_end(&app->stream);
+  // passes reading the slices may have been left out
+  sceneRecordWait(app);
+  if (timed) {
+    gpu_timer_end();
+    app->draw_timer_pending[timer] = true;
   }
 }
 
+// app_update updates and draws a frame on the calling thread.
 internal void app_update(Scene *app, float dt) {
-  app_scene_mat_view_render(app, dt);
+  app_update_frame(app, dt, 0);
+  app_render_frame(app, 0);
 }
 
 // TODO: fix cube mesh usage
@@ -159,8 +256,8 @@ internal void draw_ramp1(Scene *app, Camera *camera) {
                                 1.3f, 1.0f));
 
   app->mat_color = g_mat_sh_2;
-  app_render_mat_color_cube(app, &app->ramp_mesh, &app->lighting_shader, model,
-                            camera, &app->p_light[0]);
+  app_render_mat_color_cube(app, &app->ramp_mesh, &app->lighting_pipeline,
+                            model, camera, &app->frame->p_light[0]);
 }
 
 internal void draw_ramp2(Scene *app, Camera *camera) {
@@ -183,8 +280,8 @@ internal void draw_ramp2(Scene *app, Camera *camera) {
                       glm::vec3(0.0f, 1.0f, 0.0f));
 
   app->mat_color = g_mat_sh_2;
-  app_render_mat_color_cube(app, &app->ramp_mesh, &app->lighting_shader, model,
-                            camera, &app->p_light[0]);
+  app_render_mat_color_cube(app, &app->ramp_mesh, &app->lighting_pipeline,
+                            model, camera, &app->frame->p_light[0]);
 }
 internal void update_move_zigzag(glm::vec3 *pos) {
   float time = SDL_GetTicks() / 1000.0f;
@@ -237,11 +334,13 @@ internal void app_update_dirlight(light_s *l, glm::mat4 view) {
   l->direction = glm::vec3(view * dir_light_direction);
 }
 
-internal void app_render_mat_color_cube(Scene *app, mesh_s *mesh, shader_s *sh,
+internal void app_render_mat_color_cube(Scene *app, mesh_s *mesh,
+                                        gpu_pipeline_s *pipeline,
                                         glm::mat4 model, Camera *camera,
                                         light_s *light) {
+  const shader_s *sh = pipeline->layout;
 
-  shader_use(sh);
+  gpu_pipeline_bind(pipeline);
   // if (app->enable_mat_color) {
   // mat_color_apply(app->mat_color, sh);
   // } else {
@@ -250,65 +349,1193 @@ internal void app_render_mat_color_cube(Scene *app, mesh_s *mesh, shader_s *sh,
 
   light->direction = camViewDirection(camera);
 
-  shader_set_dirlight(sh, &app->dir_light);
+  shader_set_dirlight(sh, &app->frame->dir_light);
+  sceneBindClusters(app, sh);
+  shader_set_spotlight(sh, &app->frame->sp_light);
 
-  for (int i = 0; i < 4; i++) {
-    app->p_light[i].position = vec3(vec4(app->p_light[i].position, 1.0f));
-    shader_set_pointlight(sh, camViewMat(camera), &app->p_light[i], i);
+  shader_set_light(sh, light);
+  xform_s xform = xform_compute(model, camViewMat(camera), camProjMat(camera));
+  shader_set_transform_and_viewpos(sh, &xform, camViewPosition(camera));
+  MeshDraw(mesh, sh);
+}
+
+// sceneClusterLights culls the lamps and the light field into the clusters
+// of this frame's view and leaves the lists and the lights in view space in
+// f.
+internal void sceneClusterLights(Scene *scn, scene_frame_s *f) {
+  Uint64 start = SDL_GetPerformanceCounter();
+  Camera *cam = &scn->camera;
+  clusters_s *cl = &scn->clusters;
+  clusters_begin(cl, camProjMat(cam), cam->z_near, cam->z_far);
+
+  // texels as light_tex.frag reads them
+  mat4 view = camViewMat(cam);
+  vec4 *data = f->light_data;
+  int count = 4 + scn->light_field_size;
+  for (int i = 0; i < count; i++) {
+    light_s *l = i < 4 ? &scn->p_light[i] : &scn->field_lights[i - 4];
+    float brightness =
+        fmax(glm::compMax(l->diffuse), glm::compMax(l->specular));
+    float range =
+        cluster_light_range(l->constant, l->linear, l->quadratic, brightness);
+    vec3 position = vec3(view * vec4(l->position, 1.0f));
+    int idx = clusters_add_light(cl, position, range);
+    if (idx < 0) {
+      break;
+    }
+    data[idx * 4 + 0] = vec4(position, range);
+    data[idx * 4 + 1] = vec4(l->diffuse, l->constant);
+    data[idx * 4 + 2] = vec4(l->specular, l->linear);
+    data[idx * 4 + 3] = vec4(l->ambient, l->quadratic);
   }
+  clusters_assign(cl, &scn->jobs);
+
+  f->lights_size = cl->lights_size;
+  memcpy(f->light_spheres, cl->lights, cl->lights_size * sizeof(vec4));
+  f->slice_scale = cl->slice_scale;
+  f->slice_bias = cl->slice_bias;
+  memcpy(f->cluster_grid, cl->grid, sizeof(f->cluster_grid));
+  f->cluster_indices_size = cl->indices_size;
+  memcpy(f->cluster_indices, cl->indices,
+         cl->indices_size * sizeof(uint16_t));
+
+  float ms = (SDL_GetPerformanceCounter() - start) * 1000.0f /
+             SDL_GetPerformanceFrequency();
+  scn->cluster_ms = scn->cluster_ms * 0.95f + ms * 0.05f;
+}
 
-  shader_set_spotlight(sh, &app->sp_light);
+// sceneRecordClusters gives sh the light lists of the frame.
+internal void sceneRecordClusters(Scene *scn, cmd_list_s *cl,
+                                const shader_s *sh) {
+  scene_frame_s *f = scn->frame;
+  cmd_texture_buffer(cl, scn->cluster_grid, ClusterGridSlot);
+  cmd_texture_buffer(cl, scn->cluster_lights, ClusterLightsSlot);
+  cmd_texture_buffer(cl, scn->light_data, LightDataSlot);
+  cmd_uniform_1i(cl, sh, "clusterGrid", ClusterGridSlot);
+  cmd_uniform_1i(cl, sh, "clusterLights", ClusterLightsSlot);
+  cmd_uniform_1i(cl, sh, "lightData", LightDataSlot);
+  cmd_uniform_2f(cl, sh, "clusterTileScale",
+                 (float)CLUSTER_X / scn->render_width,
+                 (float)CLUSTER_Y / scn->render_height);
+  cmd_uniform_2f(cl, sh, "clusterSlice", f->slice_scale, f->slice_bias);
+}
 
-  shader_set_light(sh, light);
-  shader_set_transform_and_viewpos(sh, model, camViewMat(camera),
-                                   camProjMat(camera), camViewPosition(camera));
-  MeshDraw(mesh, sh);
+// sceneBindClusters gives sh the light lists right away, on the render
+// thread.
+internal void sceneBindClusters(Scene *scn, const shader_s *sh) {
+  cmd_list_s *cl = &scn->immediate;
+  cmd_list_reset(cl);
+  sceneRecordClusters(scn, cl, sh);
+  cmd_list_replay(cl);
 }
 
-internal void sceneRenderMatColor(Scene *scn, GameObject *obj) {
+// sceneBatchLight is the light that changes how the object is shaded, lamps
+// only take their color from it and it goes with the instance.
+internal light_s *sceneBatchLight(GameObject *obj) {
+  return obj->instance == LampInstance ? NULL : obj->light;
+}
+
+// sceneFrameLight is the copy in the drawn frame of light, a lamp of the
+// Scene or NULL.
+internal light_s *sceneFrameLight(Scene *scn, light_s *light) {
+  if (light == NULL) {
+    return NULL;
+  }
+  return &scn->frame->p_light[light - scn->p_light];
+}
+
+// sceneFrustumCull marks objects whose bounding sphere is outside the view
+// frustum, they are left out of the render queue.
+internal void sceneFrustumCull(Scene *scn) {
   Camera *cam = &scn->camera;
-  shader_s *sh = obj->shader;
-  light_s *light = obj->light;
+  vec4 planes[6];
+  frustum_planes(camProjMat(cam) * camViewMat(cam), planes);
+  scn->visible_count =
+      frustum_cull_spheres(planes, scn->spheres, scn->go_size, scn->visible);
+  scn->culled_count = scn->go_size - scn->visible_count;
+}
 
-  shader_use(sh);
-  if (obj->mat_color != NULL) {
-    mat_color_apply(*obj->mat_color, sh);
+// sceneStaticHide takes the chunks out of the frame visibility, after the
+// frustum culling. The culling after it sees the objects of the chunks, they
+// occlude and are found hidden as ever.
+internal void sceneStaticHide(Scene *scn) {
+  for (int i = scn->static_first; i < scn->go_size; i++) {
+    if (scn->visible[i]) {
+      scn->visible[i] = 0;
+      scn->visible_count--;
+    }
+  }
+}
+
+// sceneStaticResolve draws a chunk in place of its objects when any of them
+// is still visible. Needs the frame visibility.
+internal void sceneStaticResolve(Scene *scn) {
+  scn->static_visible = 0;
+  if (!scn->static_enabled) {
+    return;
+  }
+
+  for (int i = 0; i < scn->static_first; i++) {
+    int chunk = scn->go[i].chunk;
+    if (chunk >= 0 && scn->visible[i]) {
+      scn->visible[i] = 0;
+      scn->static_visible += !scn->visible[chunk];
+      scn->visible[chunk] = 1;
+    }
+  }
+}
+
+// scenePvsCull hides maze objects in cells the camera's cell can't see.
+internal void scenePvsCull(Scene *scn) {
+  scn->pvs_hidden_count = 0;
+  if (!scn->pvs_enabled) {
+    return;
+  }
+
+  pvs_select(&scn->pvs, pvs_cell_at(&scn->pvs, scn->camera.position));
+  for (int i = 0; i < scn->go_size; i++) {
+    if (scn->visible[i] && !pvs_visible(&scn->pvs, scn->go[i].cell)) {
+      scn->visible[i] = 0;
+      scn->pvs_hidden_count++;
+    }
+  }
+  scn->visible_count -= scn->pvs_hidden_count;
+}
+
+// sceneOcclusionBegin starts rasterizing boxes of the visible occluders on
+// the job workers. Needs the frame visibility.
+internal void sceneOcclusionBegin(Scene *scn) {
+  scn->occluded_count = 0;
+  if (!scn->occlusion_enabled) {
+    return;
+  }
+
+  Camera *cam = &scn->camera;
+  occlusion_s *oc = &scn->occlusion;
+  scn->occlusion_start = SDL_GetPerformanceCounter();
+  occlusion_begin(oc, camProjMat(cam) * camViewMat(cam));
+  for (int i = 0; i < scn->go_size; i++) {
+    GameObject *obj = &scn->go[i];
+    if (scn->visible[i] && obj->occluder) {
+      occlusion_add_box(oc, &obj->mesh->bounds, obj->transform);
+    }
+  }
+  jobs_dispatch(&scn->jobs, occlusion_raster_job, oc, OCCLUSION_BANDS);
+}
+
+// sceneOcclusionEnd waits for the occluders and hides visible objects whose
+// boxes are behind them.
+internal void sceneOcclusionEnd(Scene *scn) {
+  if (!scn->occlusion_enabled) {
+    return;
+  }
+
+  occlusion_s *oc = &scn->occlusion;
+  jobs_wait(&scn->jobs);
+  occlusion_build_pyramid(oc);
+  for (int i = 0; i < scn->go_size; i++) {
+    GameObject *obj = &scn->go[i];
+    if (scn->visible[i] &&
+        !occlusion_test_box(oc, &obj->mesh->bounds, obj->transform)) {
+      scn->visible[i] = 0;
+    }
+  }
+  scn->occluded_count = oc->occluded;
+  scn->visible_count -= oc->occluded;
+
+  float ms = (SDL_GetPerformanceCounter() - scn->occlusion_start) * 1000.0f /
+             SDL_GetPerformanceFrequency();
+  scn->occlusion_ms = scn->occlusion_ms * 0.95f + ms * 0.05f;
+}
+
+// sceneQueryCull hides objects whose box the queries of the frame last drawn
+// from f found hidden. The results are two frames old by then, an object
+// coming into view shows a frame or two late.
+internal void sceneQueryCull(Scene *scn, scene_frame_s *f) {
+  scn->query_hidden_count = 0;
+  if (!scn->query_enabled) {
+    return;
+  }
+
+  for (int i = 0; i < scn->go_size; i++) {
+    f->query_candidate[i] = scn->visible[i];
+    if (scn->visible[i] && f->query_occluded[i]) {
+      scn->visible[i] = 0;
+      scn->query_hidden_count++;
+    }
+  }
+  scn->visible_count -= scn->query_hidden_count;
+
+  // grown a bit so they are never behind the faces of the objects themselves
+  for (int i = 0; i < scn->go_size; i++) {
+    if (!f->query_candidate[i]) {
+      continue;
+    }
+    GameObject *obj = &scn->go[i];
+    bounds_s box = bounds_transform(&obj->mesh->bounds, obj->transform);
+    vec3 grow = (box.max - box.min) * 0.01f + vec3(0.01f);
+    box.min -= grow;
+    box.max += grow;
+    f->query_boxes[i] = box;
+  }
+}
+
+// sceneQueryPoll reads back the queries that are done into the frame for
+// its next update. Objects out of the running lose their queries to the
+// pool.
+internal void sceneQueryPoll(Scene *scn) {
+  scene_frame_s *f = scn->frame;
+  if (!f->query_enabled) {
+    memset(f->query_occluded, 0, sizeof(f->query_occluded));
+    return;
+  }
+
+  for (int i = 0; i < scn->go_size; i++) {
+    query_slot_s *slot = &scn->query_slots[i];
+    query_slot_poll(&scn->queries, slot);
+    if (!f->query_candidate[i]) {
+      query_slot_release(&scn->queries, slot);
+    }
+    f->query_occluded[i] = f->query_candidate[i] && slot->occluded;
+  }
+}
+
+// sceneQueryIssue draws boxes of the candidates, hidden ones included so
+// they come back when they show up again, each in its own query.
+internal void sceneQueryIssue(Scene *scn) {
+  scene_frame_s *f = scn->frame;
+  scn->query_issued_count = 0;
+  if (!f->query_enabled) {
+    return;
+  }
+
+  Camera *cam = &f->camera;
+  shader_s *sh = &scn->bounds_shader;
+  mat4 view_proj = camProjMat(cam) * camViewMat(cam);
+  gpu_pipeline_bind(&scn->bounds_pipeline);
+  for (int i = 0; i < scn->go_size; i++) {
+    query_slot_s *slot = &scn->query_slots[i];
+    if (!f->query_candidate[i]) {
+      continue;
+    }
+    if (!query_slot_wanted(slot)) {
+      query_slot_release(&scn->queries, slot);
+      continue;
+    }
+
+    bounds_s box = f->query_boxes[i];
+
+    // near plane cuts the faces of a box around the eye
+    vec3 eye = cam->position;
+    float near = cam->z_near * 2.0f;
+    if (glm::all(glm::greaterThan(eye, box.min - near)) &&
+        glm::all(glm::lessThan(eye, box.max + near))) {
+      query_slot_release(&scn->queries, slot);
+      continue;
+    }
+
+    if (!query_slot_begin(&scn->queries, slot)) {
+      continue;
+    }
+    mat4 model = glm::scale(glm::translate(mat4(1.0f), box.center),
+                            box.max - box.min);
+    mat4 mvp = view_proj * model;
+    shader_mat4fv(sh, "mvp", glm::value_ptr(mvp));
+    MeshDraw(scn->box_mesh, sh);
+    query_slot_end();
+    scn->query_issued_count++;
+  }
+}
+
+// sceneObjectKey is the render queue key of object i at depth.
+internal uint64_t sceneObjectKey(Scene *scn, int i, float depth) {
+  GameObject *obj = &scn->go[i];
+  // pipeline stands for the shader, it is bound as a whole
+  uint32_t shader = render_id(&scn->pipeline_ids, obj->pipeline);
+  uint32_t material =
+      render_id(&scn->material_ids, obj->mat_color, sceneBatchLight(obj));
+  uint32_t mesh = render_id(&scn->mesh_ids, obj->mesh);
+  return render_key(RENDER_PASS_OPAQUE, shader, material, mesh, depth);
+}
+
+// sceneObjectInstance packs the instance of object i, needs its normal
+// matrix.
+internal void sceneObjectInstance(Scene *scn, int i, instance_s *inst) {
+  GameObject *obj = &scn->go[i];
+  inst->model = obj->transform;
+  inst->normal = scn->normals[i];
+  if (obj->instance == LampInstance) {
+    inst->color = vec4(obj->light->specular, 1.0f);
   } else {
-    // mat_tex_apply(scn->mat_tex, object->shader);
+    inst->color = vec4(1.0f);
   }
+  inst->material = obj->mat_color != NULL
+                       ? render_id(&scn->mat_color_ids, obj->mat_color)
+                       : 0;
+}
 
-  // TODO: actually bad thing
-  obj->light->direction = camViewDirection(cam);
+// sceneRetainUpdate makes bounds and normal matrices of the objects that
+// moved or are dirty, of all of them with retaining off, and marks the
+// retained list stale when an object in it is dirty.
+internal void sceneRetainUpdate(Scene *scn) {
+  scene_retained_s *r = &scn->retained;
+  if (!scn->retain_enabled) {
+    xform_normal_batch(&scn->go[0].transform, sizeof(GameObject),
+                       scn->go_size, scn->normals);
+    for (int i = 0; i < scn->go_size; i++) {
+      GameObject *obj = &scn->go[i];
+      scn->spheres[i] = bounds_sphere(&obj->mesh->bounds, obj->transform);
+      obj->dirty = 0;
+    }
+    r->stale = true;
+    r->size = 0;
+    return;
+  }
 
-  shader_set_dirlight(sh, &scn->dir_light);
+  for (int i = 0; i < scn->go_size; i++) {
+    GameObject *obj = &scn->go[i];
+    if (!obj->moves && obj->dirty == 0) {
+      continue;
+    }
+    xform_normal_batch(&obj->transform, sizeof(mat4), 1, &scn->normals[i]);
+    scn->spheres[i] = bounds_sphere(&obj->mesh->bounds, obj->transform);
+    r->stale = r->stale || (!obj->moves && obj->dirty != 0);
+    obj->dirty = 0;
+  }
+}
 
-  for (int i = 0; i < 4; i++) {
-    scn->p_light[i].position = vec3(vec4(scn->p_light[i].position, 1.0f));
-    shader_set_pointlight(sh, camViewMat(cam), &scn->p_light[i], i);
+// sceneRetainBuild sorts the objects that don't move and packs their
+// instances when the list is stale, with their normals made. Needs no
+// visibility.
+internal void sceneRetainBuild(Scene *scn) {
+  scene_retained_s *r = &scn->retained;
+  if (!scn->retain_enabled || !r->stale) {
+    return;
+  }
+  render_queue_s *rq = &scn->queue;
+  render_queue_reset(rq);
+  for (int i = 0; i < scn->go_size; i++) {
+    if (!scn->go[i].moves) {
+      render_queue_submit(rq, sceneObjectKey(scn, i, 0.0f), i);
+    }
   }
+  render_queue_sort(rq);
 
-  shader_set_spotlight(sh, &scn->sp_light);
+  for (int k = 0; k < rq->size; k++) {
+    r->packets[k] = rq->packets[k];
+    sceneObjectInstance(scn, rq->packets[k].item, &r->instances[k]);
+  }
+  r->size = rq->size;
+  r->stale = false;
+  r->builds++;
+}
 
-  shader_set_light(sh, light);
-  shader_set_transform_and_viewpos(sh, obj->transform, camViewMat(cam),
-                                   camProjMat(cam), camViewPosition(cam));
-  MeshDraw(obj->mesh, sh);
+// sceneQueueObjects sorts moving objects, or all of them with retaining off,
+// in the render queue. Needs the visibility up to the PVS, the chunks are
+// queued while sceneStaticHide hides them, sceneStaticResolve decides.
+internal void sceneQueueObjects(Scene *scn) {
+  render_queue_s *rq = &scn->queue;
+  mat4 view = camViewMat(&scn->camera);
+
+  render_queue_reset(rq);
+  for (int i = 0; i < scn->go_size; i++) {
+    bool candidate = scn->visible[i] || i >= scn->static_first;
+    if (!candidate || (scn->retain_enabled && !scn->go[i].moves)) {
+      continue;
+    }
+    // camera looks down -z
+    float depth = -(view * scn->go[i].transform[3]).z / scn->camera.z_far;
+    render_queue_submit(rq, sceneObjectKey(scn, i, depth), i);
+  }
+  render_queue_sort(rq);
 }
 
-internal void sceneLampDraw(Scene *scene, GameObject *lamp) {
-  light_s *light = lamp->light;
-  shader_s *shader = lamp->shader;
+// sceneGatherBatches turns visible objects into batches of f. The render
+// queue is merged with the retained list, both are sorted by state, objects
+// hidden since they were queued are skipped. Instances of the queue go to
+// f, the retained ones are drawn from where they are. Needs the frame
+// visibility.
+internal void sceneGatherBatches(Scene *scn, scene_frame_s *f) {
+  render_queue_s *rq = &scn->queue;
+  scene_retained_s *r = &scn->retained;
+  instance_buffer_s *ib = &f->instances;
+
+  f->batches_size = 0;
+  scene_batch_s *batch = NULL;
+  int a = 0;
+  int b = 0;
+  int n = 0;
+  while (true) {
+    while (a < r->size && !scn->visible[r->packets[a].item]) {
+      a++;
+    }
+    while (b < rq->size && !scn->visible[rq->packets[b].item]) {
+      b++;
+    }
+    if (a >= r->size && b >= rq->size) {
+      break;
+    }
+    // the retained one goes first between equal states
+    bool retained =
+        a < r->size &&
+        (b >= rq->size || (r->packets[a].key & RENDER_KEY_STATE_MASK) <=
+                              (rq->packets[b].key & RENDER_KEY_STATE_MASK));
+    render_packet_s *p = retained ? &r->packets[a] : &rq->packets[b];
+    GameObject *obj = &scn->go[p->item];
+    // a batch is a range of one buffer, hidden objects between visible ones
+    // of the retained list split it
+    int at = retained ? a : n;
+    if (batch == NULL || batch->retained != retained ||
+        batch->first + batch->count != at ||
+        (batch->key & RENDER_KEY_STATE_MASK) !=
+            (p->key & RENDER_KEY_STATE_MASK)) {
+      batch = &f->batches[f->batches_size++];
+      *batch = {obj, p->key, at, 0, retained};
+    }
+    batch->count++;
+
+    if (retained) {
+      a++;
+    } else {
+      sceneObjectInstance(scn, p->item, &ib->data[n++]);
+      b++;
+    }
+  }
 
-  lamp->transform = mat4(1.0f);
-  lamp->transform = translate(lamp->transform, light->position);
-  lamp->transform = scale(lamp->transform, glm::vec3(.2f));
+  ib->size = n;
+
+  // the culling pass reads the retained instances and then the frame's
+  for (int i = 0; i < r->size; i++) {
+    f->instance_draw[i] = CULL_GPU_NO_DRAW;
+  }
+  for (int b = 0; b < f->batches_size; b++) {
+    batch = &f->batches[b];
+    int at = batch->retained ? batch->first : r->size + batch->first;
+    for (int i = 0; i < batch->count; i++) {
+      f->instance_draw[at + i] = b;
+    }
+  }
+
+  indirect_buffer_s *ind = &f->commands;
+  for (int b = 0; b < f->batches_size; b++) {
+    batch = &f->batches[b];
+    ind->data[b] = MeshIndirectCommand(batch->obj->mesh, batch->first,
+                                       batch->count);
+  }
+  ind->size = f->batches_size;
+
+  f->groups_size = 0;
+  int culled_first = 0;
+  for (int b = 0; b < f->batches_size; b++) {
+    if (b == 0 ||
+        !sceneSameGroup(&f->batches[f->groups[f->groups_size - 1].first],
+                        &f->batches[b])) {
+      f->groups[f->groups_size++] = {b, 0};
+    }
+    scene_group_s *group = &f->groups[f->groups_size - 1];
+    group->count++;
+
+    // what the GPU needs to cull the batch and write its command
+    batch = &f->batches[b];
+    mesh_s *mesh = batch->obj->mesh;
+    cull_draw_s *draw = &f->cull_draws[b];
+    draw->sphere = vec4(mesh->bounds.center, mesh->bounds.radius);
+    draw->index_count = ind->data[b].count;
+    draw->first_index = ind->data[b].first_index;
+    draw->base_vertex = ind->data[b].base_vertex;
+    // the visible ones are packed per batch, in batch order
+    draw->first_instance = culled_first;
+    draw->instance_count = batch->count;
+    culled_first += batch->count;
+    draw->group = f->groups_size - 1;
+    draw->group_first = group->first;
+  }
+
+  // material table rows, see light_color.frag
+  vec4 *rows = f->materials;
+  render_ids_s *ids = &scn->mat_color_ids;
+  for (int m = 0; m < ids->size; m++) {
+    const mat_color_s *mat = (const mat_color_s *)ids->a[m];
+    rows[m * 3 + 0] = vec4(mat->ambient, mat->shininess);
+    rows[m * 3 + 1] = vec4(mat->diffuse, 0.0f);
+    rows[m * 3 + 2] = vec4(mat->specular, 0.0f);
+  }
+  f->materials_size = ids->size;
+}
+
+// sceneUploadFrame sends what the update of the frame left for the GPU, on
+// the render thread.
+internal void sceneUploadFrame(Scene *scn) {
+  scene_frame_s *f = scn->frame;
+  instance_buffer_stream(&f->instances, &scn->stream);
+  if (f->retained_build != scn->retained_uploaded) {
+    instance_buffer_s *ib = &scn->retained_instances;
+    gpu_buffer_write(ib->buf, 0, f->retained_size * sizeof(instance_s),
+                     f->retained);
+    ib->size = f->retained_size;
+    scn->retained_uploaded = f->retained_build;
+  }
+  indirect_buffer_upload(&f->commands);
+  if (f->materials_size > 0) {
+    gpu_buffer_write(scn->material_buf, 0,
+                     f->materials_size * 3 * sizeof(vec4), f->materials);
+  }
+
+  gpu_buffer_write(scn->light_buf, 0, f->lights_size * 4 * sizeof(vec4),
+                   f->light_data);
+  gpu_buffer_write(scn->cluster_grid_buf, 0, sizeof(f->cluster_grid),
+                   f->cluster_grid);
+  if (f->cluster_indices_size > 0) {
+    gpu_buffer_write(scn->cluster_index_buf, 0,
+                     f->cluster_indices_size * sizeof(uint16_t),
+                     f->cluster_indices);
+  }
+}
+
+// sceneSameState tells whether batches draw with the same pipeline and
+// lights, the material comes from the table.
+internal bool sceneSameState(scene_batch_s *a, scene_batch_s *b) {
+  return a->obj->pipeline == b->obj->pipeline &&
+         sceneBatchLight(a->obj) == sceneBatchLight(b->obj);
+}
 
-  shader_use(shader);
-  shader_set_lightsrc(shader, light->specular);
-  shader_set_transform(shader, lamp->transform, camViewMat(&scene->camera),
-                       camProjMat(&scene->camera));
+// sceneShininess is the shininess of the material of obj, 0 without one.
+internal float sceneShininess(GameObject *obj) {
+  return obj->mat_color != NULL ? obj->mat_color->shininess : 0.0f;
+}
+
+// sceneBatchInstances is the buffer the instances of batch are in.
+internal instance_buffer_s *sceneBatchInstances(Scene *scn,
+                                                scene_batch_s *batch) {
+  return batch->retained ? &scn->retained_instances : &scn->frame->instances;
+}
+
+// sceneSameGroup tells whether b can go to the multi draw of a. Textures
+// are bound per draw call, so meshes with them are drawn alone. Shininess is
+// a uniform of light_tex.frag and gbuffer.frag, set per group.
+internal bool sceneSameGroup(scene_batch_s *a, scene_batch_s *b) {
+  return sceneSameState(a, b) && a->retained == b->retained &&
+         a->obj->mesh->textures_size == 0 &&
+         b->obj->mesh->textures_size == 0 &&
+         sceneShininess(a->obj) == sceneShininess(b->obj);
+}
+
+// sceneRecordGroup records batches of the group as one multi draw, commands
+// come from the culling pass when it ran. pipeline stands in for the group's
+// own and its shader gets no lights, NULL draws the group lit. Lights are set
+// only with bind_state, the previous group may have left them in place.
+internal void sceneRecordGroup(Scene *scn, cmd_list_s *cl, int group,
+                               const gpu_pipeline_s *pipeline,
+                               bool bind_state) {
+  scene_frame_s *f = scn->frame;
+  Camera *cam = &f->camera;
+  int first = f->groups[group].first;
+  int count = f->groups[group].count;
+  GameObject *obj = f->batches[first].obj;
+  gpu_pipeline_s state = pipeline != NULL ? *pipeline : *obj->pipeline;
+  const shader_s *sh = state.layout;
+  light_s *light =
+      pipeline == NULL ? sceneFrameLight(scn, sceneBatchLight(obj)) : NULL;
+
+  // after the pre-pass depth is final, only the nearest fragments shade
+  if (f->depth_prepass && !f->deferred) {
+    state.depth_write = false;
+    state.depth_compare = GPU_COMPARE_EQUAL;
+  }
+  cmd_pipeline(cl, &state);
+  cmd_texture_buffer(cl, scn->material_table, MaterialTableSlot);
+
+  if (bind_state) {
+    if (light != NULL) {
+      // the lamp shines along the view, slices share the frame's copy
+      light_s lamp = *light;
+      lamp.direction = camViewDirection(cam);
+
+      cmd_set_dirlight(cl, sh, &f->dir_light);
+      sceneRecordClusters(scn, cl, sh);
+      cmd_set_spotlight(cl, sh, &f->sp_light);
+      cmd_set_light(cl, sh, &lamp);
+    }
+
+    cmd_uniform_1i(cl, sh, "materials", MaterialTableSlot);
+    cmd_set_projection_and_viewpos(cl, sh, camProjMat(cam), camViewMat(cam),
+                                   camViewPosition(cam));
+  }
+  // the rest of the material comes from the table
+  if (obj->mat_color != NULL) {
+    cmd_uniform_1f(cl, sh, "material.shininess", sceneShininess(obj));
+  }
+
+  if (f->cull_enabled) {
+    cull_gpu_s *c = &scn->cull;
+    MeshRecordMultiCount(cl, obj->mesh, sh, c->instances_out, c->commands_out,
+                         first, c->group_counts, group, count);
+    return;
+  }
+
+  instance_buffer_s *ib = sceneBatchInstances(scn, &f->batches[first]);
+  MeshRecordMulti(cl, obj->mesh, sh, ib, &f->commands, first, count,
+                  f->multi_draw);
+}
+
+// sceneRecordSlice records slice index of the groups, the ones the deferred
+// path draws to the G-buffer and the rest. Runs on a job worker, everything
+// it reads stays put until the slice is replayed.
+internal void sceneRecordSlice(void *data, int index) {
+  Scene *scn = (Scene *)data;
+  scene_frame_s *f = scn->frame;
+  scene_slice_s *slice = &scn->slices[index];
+  Uint64 start = SDL_GetPerformanceCounter();
+  int first = f->groups_size * index / scn->slices_size;
+  int end = f->groups_size * (index + 1) / scn->slices_size;
+
+  cmd_list_reset(&slice->gbuffer);
+  if (f->deferred) {
+    bool bind_state = true;
+    for (int g = first; g < end; g++) {
+      if (sceneDeferredGroup(scn, g)) {
+        sceneRecordGroup(scn, &slice->gbuffer, g, &scn->gbuffer_pipeline,
+                         bind_state);
+        bind_state = false;
+      }
+    }
+  }
+
+  cmd_list_reset(&slice->opaque);
+  int drawn = -1;
+  for (int g = first; g < end; g++) {
+    if (f->deferred && sceneDeferredGroup(scn, g)) {
+      continue;
+    }
+    // state is left by the last group drawn, skipped ones don't count
+    bool bind_state = drawn < 0;
+    if (!bind_state) {
+      scene_group_s *last = &f->groups[drawn];
+      bind_state =
+          !sceneSameState(&f->batches[last->first + last->count - 1],
+                          &f->batches[f->groups[g].first]);
+    }
+    sceneRecordGroup(scn, &slice->opaque, g, NULL, bind_state);
+    drawn = g;
+  }
+
+  slice->ms = (SDL_GetPerformanceCounter() - start) * 1000.0f /
+              SDL_GetPerformanceFrequency();
+}
+
+// sceneRecordBegin starts recording the groups of the frame, on the job
+// workers while the passes before the G-buffer and opaque ones run, or all
+// of it right here.
+internal void sceneRecordBegin(Scene *scn) {
+  scene_frame_s *f = scn->frame;
+  scn->slices_size = f->record_parallel ? SceneSlices : 1;
+  if (f->groups_size < scn->slices_size) {
+    scn->slices_size = f->groups_size > 0 ? f->groups_size : 1;
+  }
+  if (!f->record_parallel) {
+    sceneRecordSlice(scn, 0);
+    return;
+  }
+  jobs_dispatch(&scn->record_jobs, sceneRecordSlice, scn, scn->slices_size);
+}
+
+// sceneRecordWait waits for the slices, once they are needed.
+internal void sceneRecordWait(Scene *scn) {
+  jobs_wait(&scn->record_jobs);
+}
+
+// sceneDepthPrepass lays down depth of all batches with no textures or
+// lights. Groups only matter with GPU culling, its counts are per group,
+// otherwise all commands go in one multi draw.
+internal void sceneDepthPrepass(Scene *scn) {
+  scene_frame_s *f = scn->frame;
+  shader_s *sh = &scn->depth_shader;
+  mat4 projection = camProjMat(&f->camera);
+  mat4 view = camViewMat(&f->camera);
+  gpu_pipeline_bind(&scn->depth_pipeline);
+  shader_mat4fv(sh, "projection", glm::value_ptr(projection));
+  shader_mat4fv(sh, "view", glm::value_ptr(view));
+
+  if (f->cull_enabled) {
+    cull_gpu_s *c = &scn->cull;
+    for (int g = 0; g < f->groups_size; g++) {
+      MeshDrawDepthMultiCount(c->instances_out, c->commands_out,
+                              f->groups[g].first, c->group_counts, g,
+                              f->groups[g].count);
+    }
+    return;
+  }
+
+  // one call per run of batches drawn from the same buffer
+  for (int b = 0; b < f->batches_size;) {
+    int end = b + 1;
+    while (end < f->batches_size &&
+           f->batches[end].retained == f->batches[b].retained) {
+      end++;
+    }
+    MeshDrawDepthMulti(sceneBatchInstances(scn, &f->batches[b]),
+                       &f->commands, b, end - b, f->multi_draw);
+    b = end;
+  }
+}
+
+// sceneDeferredGroup tells whether the group is shaded by the deferred path,
+// only the textured lighting writes the G-buffer.
+internal bool sceneDeferredGroup(Scene *scn, int group) {
+  scene_frame_s *f = scn->frame;
+  GameObject *obj = f->batches[f->groups[group].first].obj;
+  return obj->pipeline == &scn->lighting_inst_pipeline;
+}
+
+// sceneDeferredGeometry draws the deferred groups to the G-buffer gb, at the
+// render size.
+internal void sceneDeferredGeometry(Scene *scn, const gpu_target_s *gb) {
+  gpu_target_bind(gb);
+  gpu_viewport(0, 0, scn->render_width, scn->render_height);
+  gpu_clear(0.0f, 0.0f, 0.0f, 0.0f);
+  sceneRecordWait(scn);
+  for (int i = 0; i < scn->slices_size; i++) {
+    cmd_list_replay(&scn->slices[i].gbuffer);
+  }
+}
+
+// sceneDeferredUse binds pipeline and gives its shader the G-buffer gb.
+internal void sceneDeferredUse(Scene *scn, const gpu_target_s *gb,
+                               const gpu_pipeline_s *pipeline) {
+  scene_frame_s *f = scn->frame;
+  const shader_s *sh = pipeline->layout;
+  mat4 inv_projection = glm::inverse(camProjMat(&f->camera));
+  gpu_pipeline_bind(pipeline);
+  gpu_texture_bind(gb->colors[0], GAlbedoSpecSlot);
+  gpu_texture_bind(gb->colors[1], GNormalSlot);
+  gpu_texture_bind(gb->depth, GDepthSlot);
+  shader_1i(sh, "gAlbedoSpec", GAlbedoSpecSlot);
+  shader_1i(sh, "gNormal", GNormalSlot);
+  shader_1i(sh, "gDepth", GDepthSlot);
+  shader_mat4fv(sh, "invProjection", glm::value_ptr(inv_projection));
+  shader_2f(sh, "screenSize", (float)scn->render_width,
+            (float)scn->render_height);
+}
+
+// sceneDeferredLighting adds the lights to the scene from the G-buffer gb:
+// the directional light over the whole of it, then every point light in
+// view inside its sphere and the spotlight inside its cone. Spheres mark the
+// stencil where the depth is inside them first, so shading runs only where
+// the light reaches a surface.
+internal void sceneDeferredLighting(Scene *scn, const gpu_target_s *gb) {
+  scene_frame_s *f = scn->frame;
+  sceneBindScene(&scn->graph, scn);
+  Camera *cam = &f->camera;
+  mat4 projection = camProjMat(cam);
+
+  sceneDeferredUse(scn, gb, &scn->deferred_dir_pipeline);
+  shader_set_dirlight(scn->deferred_dir_pipeline.layout, &f->dir_light);
+  gpu_draw_s draw = {};
+  draw.input = scn->fullscreen_input;
+  draw.count = 3;
+  gpu_draw(&draw);
+
+  // the lights of the clusters, already in view space and with their range
+  local_persist vec4 spheres[4 + LightFieldSize];
+  local_persist uint8_t visible[4 + LightFieldSize];
+  for (int i = 0; i < f->lights_size; i++) {
+    vec4 l = f->light_spheres[i];
+    // clusters keep depth, view space looks down -z
+    spheres[i] = vec4(l.x, l.y, -l.z, fmin(l.w, cam->z_far));
+  }
+  vec4 planes[6];
+  frustum_planes(projection, planes);
+  frustum_cull_spheres(planes, spheres, f->lights_size, visible);
+
+  const shader_s *mark = scn->volume_mark_pipeline.layout;
+  const shader_s *point = scn->deferred_point_pipeline.layout;
+  sceneDeferredUse(scn, gb, &scn->deferred_point_pipeline);
+  scn->volume_count = 0;
+  for (int i = 0; i < f->lights_size; i++) {
+    if (!visible[i]) {
+      continue;
+    }
+    light_s *l = i < 4 ? &f->p_light[i] : &scn->field_lights[i - 4];
+    vec3 center = vec3(spheres[i]);
+    mat4 mvp = projection * glm::scale(glm::translate(mat4(1.0f), center),
+                                       vec3(spheres[i].w));
+
+    gpu_pipeline_bind(&scn->volume_mark_pipeline);
+    shader_mat4fv(mark, "mvp", glm::value_ptr(mvp));
+    MeshDraw(&scn->sphere_volume, mark);
+
+    gpu_pipeline_bind(&scn->deferred_point_pipeline);
+    shader_mat4fv(point, "mvp", glm::value_ptr(mvp));
+    shader_3f(point, "light.position", center.x, center.y, center.z);
+    shader_1f(point, "light.range", spheres[i].w);
+    shader_3f(point, "light.diffuse", l->diffuse.x, l->diffuse.y,
+              l->diffuse.z);
+    shader_3f(point, "light.specular", l->specular.x, l->specular.y,
+              l->specular.z);
+    shader_1f(point, "light.constant", l->constant);
+    shader_1f(point, "light.linear", l->linear);
+    shader_1f(point, "light.quadratic", l->quadratic);
+    MeshDraw(&scn->sphere_volume, point);
+    scn->volume_count++;
+  }
+
+  // the cone reaches the far plane, the spotlight has no attenuation
+  const shader_s *spot = scn->deferred_spot_pipeline.layout;
+  float radius = tanf(acosf(f->sp_light.outerCutOff)) * cam->z_far;
+  mat4 mvp = projection * glm::scale(mat4(1.0f),
+                                     vec3(radius, radius, cam->z_far));
+  sceneDeferredUse(scn, gb, &scn->deferred_spot_pipeline);
+  shader_set_spotlight(spot, &f->sp_light);
+  shader_mat4fv(spot, "mvp", glm::value_ptr(mvp));
+  MeshDraw(&scn->cone_volume, spot);
+}
+
+// sceneDeclarePasses declares the GPU passes of the frame. The window, the
+// batch commands and the depth pyramid outlive the frame and are imported,
+// the G-buffer and the scaled scene are transient.
+internal void sceneDeclarePasses(Scene *scn) {
+  scene_frame_s *f = scn->frame;
+  frame_graph_s *fg = &scn->graph;
+  bool cull = f->cull_enabled;
+  int window = frame_graph_import(fg, "window", NULL);
+  int draws = frame_graph_import(fg, "draws", NULL);
+  int hiz = frame_graph_import(fg, "hiz", NULL);
+
+  // the scene is drawn to a window size target so it keeps its size, and
+  // with it its place in the pool, when the scale changes
+  int p = 0;
+  scn->scene = window;
+  if (f->dynamic_resolution) {
+    gpu_format_e color[1] = {GPU_FORMAT_RGBA8};
+    scn->scene = frame_graph_target(fg, "scene", f->screen_width,
+                                    f->screen_height, color, 1);
+    p = frame_graph_pass(fg, "clear", scenePassClear, scn);
+    frame_graph_write(fg, p, scn->scene);
+  }
+
+  if (cull) {
+    // the pyramid is the last frame's
+    p = frame_graph_pass(fg, "gpu cull", scenePassCull, scn);
+    frame_graph_read(fg, p, hiz);
+    frame_graph_write(fg, p, draws);
+  }
+
+  // the deferred path fills the scene depth, the forward groups and draws
+  // test against it
+  if (f->deferred) {
+    // see gbuffer.frag
+    gpu_format_e colors[2] = {GPU_FORMAT_RGBA8, GPU_FORMAT_RGBA16F};
+    scn->gbuffer = frame_graph_target(fg, "gbuffer", f->screen_width,
+                                      f->screen_height, colors,
+                                      COUNT_OF(colors));
+    p = frame_graph_pass(fg, "gbuffer", scenePassGeometry, scn);
+    frame_graph_read(fg, p, draws);
+    frame_graph_write(fg, p, scn->gbuffer);
+    p = frame_graph_pass(fg, "deferred lights", scenePassLighting, scn);
+    frame_graph_read(fg, p, scn->gbuffer);
+    frame_graph_write(fg, p, scn->scene);
+  } else if (f->depth_prepass) {
+    p = frame_graph_pass(fg, "prepass", scenePassPrepass, scn);
+    frame_graph_read(fg, p, draws);
+    frame_graph_write(fg, p, scn->scene);
+  }
+
+  p = frame_graph_pass(fg, "opaque", scenePassOpaque, scn);
+  frame_graph_read(fg, p, draws);
+  frame_graph_write(fg, p, scn->scene);
+
+  // depth of the opaque objects is complete, boxes are tested against it
+  if (f->query_enabled) {
+    p = frame_graph_pass(fg, "queries", scenePassQueries, scn);
+    frame_graph_read(fg, p, scn->scene);
+  }
+  // and the next frame culls against it
+  if (cull) {
+    p = frame_graph_pass(fg, "hiz", scenePassPyramid, scn);
+    frame_graph_read(fg, p, scn->scene);
+    frame_graph_write(fg, p, hiz);
+  }
+
+  if (f->dynamic_resolution) {
+    p = frame_graph_pass(fg, "upscale", scenePassUpscale, scn);
+    frame_graph_read(fg, p, scn->scene);
+    frame_graph_write(fg, p, window);
+  }
+
+  // text stays sharp, it is drawn at the window size
+  p = frame_graph_pass(fg, "overlay", scenePassOverlay, scn);
+  frame_graph_write(fg, p, window);
+}
+
+// sceneBindScene makes the scene the target of the draws that follow, at the
+// render size.
+internal void sceneBindScene(frame_graph_s *fg, Scene *scn) {
+  gpu_target_bind(frame_graph_get(fg, scn->scene));
+  gpu_viewport(0, 0, scn->render_width, scn->render_height);
+}
+
+// scenePassClear clears the scene like the window is at the start of the
+// frame.
+internal void scenePassClear(frame_graph_s *fg, void *data) {
+  sceneBindScene(fg, (Scene *)data);
+  gpu_clear(0.1f, 0.1f, 0.1f, 1.0f);
+}
+
+internal void scenePassCull(frame_graph_s *fg, void *data) {
+  Scene *scn = (Scene *)data;
+  scene_frame_s *f = scn->frame;
+  vec4 planes[6];
+  frustum_planes(camProjMat(&f->camera), planes);
+  cull_gpu_run(&scn->cull, &scn->retained_instances, f->retained_count,
+               &f->instances, f->cull_draws, f->batches_size, f->instance_draw,
+               camViewMat(&f->camera), planes, true);
+}
+
+internal void scenePassGeometry(frame_graph_s *fg, void *data) {
+  Scene *scn = (Scene *)data;
+  sceneDeferredGeometry(scn, frame_graph_get(fg, scn->gbuffer));
+}
+
+internal void scenePassLighting(frame_graph_s *fg, void *data) {
+  Scene *scn = (Scene *)data;
+  sceneDeferredLighting(scn, frame_graph_get(fg, scn->gbuffer));
+}
+
+internal void scenePassPrepass(frame_graph_s *fg, void *data) {
+  sceneBindScene(fg, (Scene *)data);
+  sceneDepthPrepass((Scene *)data);
+}
+
+// scenePassOpaque draws the groups the deferred path left, or all of them,
+// and the objects drawn one by one.
+internal void scenePassOpaque(frame_graph_s *fg, void *data) {
+  Scene *scn = (Scene *)data;
+  scene_frame_s *f = scn->frame;
+  Camera *camera = &f->camera;
+  sceneBindScene(fg, scn);
+
+  sceneRecordWait(scn);
+  float record_ms = 0.0f;
+  for (int i = 0; i < scn->slices_size; i++) {
+    record_ms += scn->slices[i].ms;
+  }
+  scn->record_ms = scn->record_ms * 0.95f + record_ms * 0.05f;
+
+  Uint64 submit_start = SDL_GetPerformanceCounter();
+  for (int i = 0; i < scn->slices_size; i++) {
+    cmd_list_replay(&scn->slices[i].opaque);
+  }
+  float submit_ms = (SDL_GetPerformanceCounter() - submit_start) * 1000.0f /
+                    SDL_GetPerformanceFrequency();
+  scn->submit_ms = scn->submit_ms * 0.95f + submit_ms * 0.05f;
+
+  gpu_pipeline_bind(&scn->lighting_pipeline);
+  shader_1i(&scn->lighting_shader, "material.diffuse", 0);
+  shader_1i(&scn->lighting_shader, "material.specular", 1);
+
+  draw_material_preview(scn, camera);
+
+  if (f->enable_maze) {
+    sceneDrawCube(scn, camera);
+    // draw_maze(app, camera);
+    draw_ramp1(scn, camera);
+    draw_ramp2(scn, camera);
+  }
+}
+
+internal void scenePassQueries(frame_graph_s *fg, void *data) {
+  sceneBindScene(fg, (Scene *)data);
+  sceneQueryIssue((Scene *)data);
+}
+
+// scenePassPyramid builds the pyramid from the depth of the render size part
+// of the scene.
+internal void scenePassPyramid(frame_graph_s *fg, void *data) {
+  Scene *scn = (Scene *)data;
+  scene_frame_s *f = scn->frame;
+  sceneBindScene(fg, scn);
+  cull_gpu_build_pyramid(&scn->cull, scn->render_width, scn->render_height,
+                         camViewMat(&f->camera), camProjMat(&f->camera));
+}
+
+// scenePassUpscale stretches the render size part of the scene over the
+// window and sharpens it.
+internal void scenePassUpscale(frame_graph_s *fg, void *data) {
+  Scene *scn = (Scene *)data;
+  scene_frame_s *f = scn->frame;
+  shader_s *sh = &scn->upscale_shader;
+  gpu_target_bind(NULL);
+  gpu_viewport(0, 0, f->screen_width, f->screen_height);
+  gpu_pipeline_bind(&scn->upscale_pipeline);
+  gpu_texture_bind(frame_graph_get(fg, scn->scene)->colors[0], SceneColorSlot);
+  shader_1i(sh, "scene", SceneColorSlot);
+  shader_2f(sh, "renderSize", (float)scn->render_width,
+            (float)scn->render_height);
+  shader_2f(sh, "windowSize", (float)f->screen_width,
+            (float)f->screen_height);
+  shader_1f(sh, "sharpness", 0.5f);
+  gpu_draw_s draw = {};
+  draw.input = scn->fullscreen_input;
+  draw.count = 3;
+  gpu_draw(&draw);
+}
+
+internal void scenePassOverlay(frame_graph_s *fg, void *data) {
+  Scene *scn = (Scene *)data;
+  scene_frame_s *f = scn->frame;
+  gpu_target_bind(NULL);
+  gpu_viewport(0, 0, f->screen_width, f->screen_height);
+  int text_y = 20;
+  text_draw(&scn->text_renderer, 10, 20, "Hello, world!");
+  text_y += 32;
+  char buf[50];
+  for (int i = 0; i < 4; i++) {
+    sprintf(buf, "[%.2f; %.2f; %.2f]", f->p_light[i].position.x,
+            f->p_light[i].position.y, f->p_light[i].position.z);
+    text_draw(&scn->text_renderer, 10, text_y, buf);
+    text_y += 32;
+  }
+
+  // text_draw fits 20 characters per line
+  sprintf(buf, "gl %d, skip %d", g_glstate.last.issued,
+          g_glstate.last.filtered);
+  text_draw(&scn->text_renderer, 10, text_y, buf);
+  text_y += 32;
+  sprintf(buf, "draws %d", g_glstate.last.draws);
+  text_draw(&scn->text_renderer, 10, text_y, buf);
+  text_y += 32;
+  // state changes of the queue in submission and in sorted order
+  sprintf(buf, "sort %d -> %d", f->sort_unsorted,
+          f->sort_sorted);
+  text_draw(&scn->text_renderer, 10, text_y, buf);
+  text_y += 32;
+  // m switches between one multi draw per group and a draw per batch
+  sprintf(buf, "%s %.3fms", f->multi_draw ? "mdi" : "loop", scn->submit_ms);
+  text_draw(&scn->text_renderer, 10, text_y, buf);
+  text_y += 32;
+  // k switches the retained list, objects in it and times it was built
+  if (f->retain_enabled) {
+    sprintf(buf, "retain %d #%d", f->retained_count, f->retain_builds);
+  } else {
+    sprintf(buf, "retain off");
+  }
+  text_draw(&scn->text_renderer, 10, text_y, buf);
+  text_y += 32;
+  // b switches static batching, chunks drawn of all and their geometry
+  if (f->static_enabled) {
+    sprintf(buf, "static %d/%d %zuKB", f->static_visible,
+            scn->static_stats.chunks, scn->static_stats.bytes / 1024);
+  } else {
+    sprintf(buf, "static off");
+  }
+  text_draw(&scn->text_renderer, 10, text_y, buf);
+  text_y += 32;
+  // j switches recording on the job workers, slices and their CPU time
+  sprintf(buf, "rec %d %.3fms", scn->slices_size, scn->record_ms);
+  text_draw(&scn->text_renderer, 10, text_y, buf);
+  text_y += 32;
+  // c switches culling on the GPU
+  sprintf(buf, "gpu cull %s",
+          !scn->cull_available ? "n/a" : (f->cull_enabled ? "on" : "off"));
+  text_draw(&scn->text_renderer, 10, text_y, buf);
+  text_y += 32;
+  sprintf(buf, "vis %d, cull %d", f->visible_count, f->culled_count);
+  text_draw(&scn->text_renderer, 10, text_y, buf);
+  text_y += 32;
+  // p switches the maze visibility sets
+  if (f->pvs_enabled) {
+    sprintf(buf, "pvs %d", f->pvs_hidden_count);
+  } else {
+    sprintf(buf, "pvs off");
+  }
+  text_draw(&scn->text_renderer, 10, text_y, buf);
+  text_y += 32;
+  // l switches the light field, lights are culled into clusters
+  sprintf(buf, "lights %d %.2fms", f->lights_size,
+          f->cluster_ms);
+  text_draw(&scn->text_renderer, 10, text_y, buf);
+  text_y += 32;
+  // z switches the depth pre-pass
+  sprintf(buf, "prepass %s", f->depth_prepass ? "on" : "off");
+  text_draw(&scn->text_renderer, 10, text_y, buf);
+  text_y += 32;
+  // g switches the deferred path
+  if (f->deferred) {
+    sprintf(buf, "deferred %d vols", scn->volume_count);
+  } else {
+    sprintf(buf, "deferred off");
+  }
+  text_draw(&scn->text_renderer, 10, text_y, buf);
+  text_y += 32;
+  // GPU time of the frame graph, passes run of those declared and targets
+  // of the pool in use
+  sprintf(buf, "gpu %.2fms", scn->draw_ms);
+  text_draw(&scn->text_renderer, 10, text_y, buf);
+  text_y += 32;
+  // f switches the frames in flight, time the last frame waited for the
+  // GPU to catch up and time it stalled on it otherwise
+  frame_pacer_stats_s *pace = &g_frame_pacer.last;
+  sprintf(buf, "pace %d %.2fms", g_frame_pacer.max_frames, pace->pace_ms);
+  text_draw(&scn->text_renderer, 10, text_y, buf);
+  text_y += 32;
+  if (pace->stalls > 0) {
+    sprintf(buf, "stall %.2fms %.6s", pace->stall_ms, pace->worst);
+  } else {
+    sprintf(buf, "stall none");
+  }
+  text_draw(&scn->text_renderer, 10, text_y, buf);
+  text_y += 32;
+  // t switches the render thread, CPU time of the update and time between
+  // frames drawn
+  sprintf(buf, "thread %s", f->threaded ? "on" : "off");
+  text_draw(&scn->text_renderer, 10, text_y, buf);
+  text_y += 32;
+  sprintf(buf, "cpu %.2fms", f->update_ms);
+  text_draw(&scn->text_renderer, 10, text_y, buf);
+  text_y += 32;
+  sprintf(buf, "frame %.2fms", scn->frame_ms);
+  text_draw(&scn->text_renderer, 10, text_y, buf);
+  text_y += 32;
+  sprintf(buf, "graph %d/%d, rt %d", scn->graph.order_size,
+          scn->graph.passes_size, scn->graph.slot_count);
+  text_draw(&scn->text_renderer, 10, text_y, buf);
+  text_y += 32;
+  // r switches dynamic resolution, the scale and the budget it holds
+  if (f->dynamic_resolution) {
+    sprintf(buf, "res %.2f %.1fms", scn->resolution.scale,
+            scn->resolution.budget_ms);
+  } else {
+    sprintf(buf, "res off");
+  }
+  text_draw(&scn->text_renderer, 10, text_y, buf);
+  text_y += 32;
+  // h switches hardware occlusion queries
+  if (f->query_enabled) {
+    sprintf(buf, "query %d/%d", f->query_hidden_count,
+            scn->query_issued_count);
+  } else {
+    sprintf(buf, "query off");
+  }
+  text_draw(&scn->text_renderer, 10, text_y, buf);
+  text_y += 32;
+  // o switches software occlusion culling
+  if (f->occlusion_enabled) {
+    sprintf(buf, "occl %d %.2fms", f->occluded_count, f->occlusion_ms);
+  } else {
+    sprintf(buf, "occl off");
+  }
+  text_draw(&scn->text_renderer, 10, text_y, buf);
+  text_y += 32;
+  range_alloc_stats_s geo = range_alloc_stats(&g_mesh_geometry.vertices);
+  sprintf(buf, "geo frag %.2f", geo.fragmentation);
+  text_draw(&scn->text_renderer, 10, text_y, buf);
+  text_y += 32;
+}
 
-  MeshDraw(lamp->mesh, shader);
+// sceneLampUpdate moves lamp to its light, before the normals are made.
+internal void sceneLampUpdate(GameObject *lamp) {
+  mat4 transform = translate(mat4(1.0f), lamp->light->position);
+  game_object_set_transform(lamp, scale(transform, glm::vec3(.2f)));
 }
 
 internal void draw_material_preview(Scene *app, Camera *camera) {
@@ -337,13 +1564,14 @@ internal void draw_material_preview(Scene *app, Camera *camera) {
       sphere_view = glm::scale(sphere_view, glm::vec3(0.2));
       printf("colliding (%.2f %.2f %.2f)\n", rayIntersection.x,
              rayIntersection.y, rayIntersection.z);
-      app_render_mat_color_cube(app, &app->debug_sphere, &app->lighting_shader,
-                                sphere_view, camera, &app->p_light[0]);
+      app_render_mat_color_cube(app, &app->debug_sphere,
+                                &app->lighting_pipeline, sphere_view, camera,
+                                &app->frame->p_light[0]);
     }
     // } else {
     app_render_mat_color_cube(app, &app->texture_cube_mesh,
-                              &app->lighting_shader, model, camera,
-                              &app->p_light[0]);
+                              &app->lighting_pipeline, model, camera,
+                              &app->frame->p_light[0]);
     // }
   }
 }
\ No newline at end of file
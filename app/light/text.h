@@ -3,18 +3,42 @@
 
 #include "unity.h"
 
+#include "renderer.h"
 #include "shader.h"
+#include "stream.h"
 #include "texture.h"
+#include "vertex_format.h"
+
+struct text_vertex_s {
+  vec2 pos;
+  vec2 texcoord;
+};
+
+template <> struct vertex_format<text_vertex_s> {
+  static constexpr vertex_attrib_s attribs[] = {
+      VERTEX_ATTRIB(0, text_vertex_s, pos),
+      VERTEX_ATTRIB(1, text_vertex_s, texcoord),
+  };
+};
+
+// 6 vertices per character, 20 characters per string
+#define TEXT_MAX_VERTS (6 * 20)
 
 struct text_s {
   shader_s shader;
-  GLuint tex, vao, vbo;
+  gpu_pipeline_s pipeline;
+  gpu_texture_s tex;
+  gpu_input_s input;
+  // vertices of every string go to a range of the frame's stream, draws
+  // start at its first vertex
+  stream_buffer_s *stream;
 };
 
-internal bool text_init(text_s* t) {
+internal bool text_init(text_s* t, stream_buffer_s *stream) {
   bool ok = false;
 
-  ok = shader_init(&t->shader, "app/text/text.vert", "app/text/text.frag");
+  ok = shader_init_layout<text_vertex_s>(&t->shader, "app/text/text.vert",
+                                         "app/text/text.frag");
   if (!ok) {
     printf("text: failed to load text shaders\n");
     return ok;
@@ -26,30 +50,18 @@ internal bool text_init(text_s* t) {
     return ok;
   }
 
-  float text[] = {
-    0.0f,
-    0.0f,
-    0.0f,
-    0.0f,
-  };
+  t->pipeline = gpu_pipeline_opaque(&t->shader);
 
-  glGenVertexArrays(1, &t->vao);
-  glBindVertexArray(t->vao);
-  glGenBuffers(1, &t->vbo);
-  glBindBuffer(GL_ARRAY_BUFFER, t->vbo);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(text), text, GL_DYNAMIC_DRAW);
-  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float),
-                        (void*)(2 * sizeof(float)));
-  glEnableVertexAttribArray(1);
+  t->input = gpu_input_create();
+  t->stream = stream;
+  gpu_input_stream<text_vertex_s>(t->input, 0, stream->buf);
 
   return ok;
 }
 
 internal void text_draw(text_s* t, int x, int y, const char* str) {
   // 24 floats per character
-  const int chars_size = 24 * 20;
+  const int chars_size = TEXT_MAX_VERTS * 4;
   float chars[chars_size] = {};
   int size = 0;
 
@@ -103,27 +115,28 @@ internal void text_draw(text_s* t, int x, int y, const char* str) {
     idx++;
   }
 
-  shader_use(&t->shader);
-  glActiveTexture(GL_TEXTURE1);
-  glBindTexture(GL_TEXTURE_2D, t->tex);
+  size_t offset = 0;
+  void *verts = stream_alloc(t->stream, size * sizeof(float),
+                             sizeof(text_vertex_s), &offset);
+  if (verts == NULL) {
+    return;
+  }
+  memcpy(verts, chars, size * sizeof(float));
+  stream_flush(t->stream);
 
-  glBindVertexArray(t->vao);
-  glBindBuffer(GL_ARRAY_BUFFER, t->vbo);
-  glBufferData(GL_ARRAY_BUFFER, size * sizeof(float), chars, GL_STATIC_DRAW);
-  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float),
-                        (void*)(2 * sizeof(float)));
-  glEnableVertexAttribArray(1);
+  gpu_pipeline_bind(&t->pipeline);
+  gpu_texture_bind(t->tex, 1);
 
   mat4 model(1.0f);
   // model = glm::scale(model, vec3(1.0f / 800.0f, 1.0f / 600.0f, 1.0f));
   shader_mat4fv(&t->shader, "model", glm::value_ptr(model));
   shader_1i(&t->shader, "tex", 1);
 
-  glBindVertexArray(t->vao);
-  glBindBuffer(GL_ARRAY_BUFFER, t->vbo);
-  glDrawArrays(GL_TRIANGLES, 0, size / 4);
+  gpu_draw_s draw = {};
+  draw.input = t->input;
+  draw.first = offset / sizeof(text_vertex_s);
+  draw.count = size / 4;
+  gpu_draw(&draw);
 }
 
 #endif
\ No newline at end of file
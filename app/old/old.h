@@ -4,7 +4,10 @@
 #include "unity.h"
 
 #include "flycamera.h"
+#include "glstate.h"
+#include "mesh.h"
 #include "shader.h"
+#include "vertex_format.h"
 
 int g_screenWidth = 1000;
 int g_screenHeight = 600;
@@ -18,6 +21,20 @@ GLuint g_vao1 = 0;
 GLuint g_vbo1 = 0;
 
 shader_s g_shaders[2] = {{0}, {0}};
+
+struct old_vertex_s {
+  vec3 pos;
+  vec3 color;
+  vec2 texcoord;
+};
+
+template <> struct vertex_format<old_vertex_s> {
+  static constexpr vertex_attrib_s attribs[] = {
+      VERTEX_ATTRIB(0, old_vertex_s, pos),
+      VERTEX_ATTRIB(1, old_vertex_s, color),
+      VERTEX_ATTRIB(2, old_vertex_s, texcoord),
+  };
+};
 GLuint g_tex[2] = {0, 0};
 
 Camera g_camera = {};
@@ -66,34 +83,20 @@ void initTwoVAO() {
                        2.0f, 0.0f};
 
   glGenVertexArrays(1, &g_vao);
-  glBindVertexArray(g_vao);
+  glstate_bind_vao(g_vao);
   glGenBuffers(1, &g_vbo);
-  glBindBuffer(GL_ARRAY_BUFFER, g_vbo);
+  glstate_bind_buffer(GL_ARRAY_BUFFER, g_vbo);
   glBufferData(GL_ARRAY_BUFFER, sizeof(triangle1), triangle1, GL_STATIC_DRAW);
 
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float),
-                        (void *)(3 * sizeof(float)));
-  glEnableVertexAttribArray(1);
-  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float),
-                        (void *)(6 * sizeof(float)));
-  glEnableVertexAttribArray(2);
+  vertex_format_setup<old_vertex_s>();
 
   glGenVertexArrays(1, &g_vao1);
-  glBindVertexArray(g_vao1);
+  glstate_bind_vao(g_vao1);
   glGenBuffers(1, &g_vbo1);
-  glBindBuffer(GL_ARRAY_BUFFER, g_vbo1);
+  glstate_bind_buffer(GL_ARRAY_BUFFER, g_vbo1);
   glBufferData(GL_ARRAY_BUFFER, sizeof(triangle2), triangle2, GL_STATIC_DRAW);
 
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float),
-                        (void *)(3 * sizeof(float)));
-  glEnableVertexAttribArray(1);
-  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float),
-                        (void *)(6 * sizeof(float)));
-  glEnableVertexAttribArray(2);
+  vertex_format_setup<old_vertex_s>();
 }
 
 void renderTwoVAO() {
@@ -159,7 +162,7 @@ void renderTwoVAO() {
   shader_mat4fv(&g_shaders[0], "view", glm::value_ptr(view));
   shader_mat4fv(&g_shaders[0], "projection", glm::value_ptr(projection));
 
-  glBindVertexArray(g_vao);
+  glstate_bind_vao(g_vao);
   glDrawArrays(GL_TRIANGLES, 0, 3);
 
   shader_use(&g_shaders[1]);
@@ -173,7 +176,7 @@ void renderTwoVAO() {
   shader_mat4fv(&g_shaders[1], "view", glm::value_ptr(view));
   shader_mat4fv(&g_shaders[1], "projection", glm::value_ptr(projection));
 
-  glBindVertexArray(g_vao1);
+  glstate_bind_vao(g_vao1);
   glDrawArrays(GL_TRIANGLES, 0, 3);
 
   {
@@ -193,7 +196,7 @@ void renderTwoVAO() {
     shader_1i(&g_shaders[0], "tex2", 1);
     shader_mat4fv(&g_shaders[0], "transform", glm::value_ptr(trans));
 
-    glBindVertexArray(g_vao);
+    glstate_bind_vao(g_vao);
     glDrawArrays(GL_TRIANGLES, 0, 3);
 
     shader_use(&g_shaders[1]);
@@ -203,7 +206,7 @@ void renderTwoVAO() {
     shader_1i(&g_shaders[1], "tex2", 1);
     shader_mat4fv(&g_shaders[1], "transform", glm::value_ptr(trans));
 
-    glBindVertexArray(g_vao1);
+    glstate_bind_vao(g_vao1);
     glDrawArrays(GL_TRIANGLES, 0, 3);
   }
   {
@@ -226,7 +229,7 @@ void renderTwoVAO() {
     shader_1i(&g_shaders[0], "tex2", 1);
     shader_mat4fv(&g_shaders[0], "transform", glm::value_ptr(trans));
 
-    glBindVertexArray(g_vao);
+    glstate_bind_vao(g_vao);
     glDrawArrays(GL_TRIANGLES, 0, 3);
 
     shader_use(&g_shaders[1]);
@@ -236,7 +239,7 @@ void renderTwoVAO() {
     shader_1i(&g_shaders[1], "tex2", 1);
     shader_mat4fv(&g_shaders[1], "transform", glm::value_ptr(trans));
 
-    glBindVertexArray(g_vao1);
+    glstate_bind_vao(g_vao1);
     glDrawArrays(GL_TRIANGLES, 0, 3);
   }
 }
@@ -284,23 +287,26 @@ void triangleExampleVBO() {
   unsigned int indices[] = {0, 1, 2, 3, 4, 5};
 
   glGenVertexArrays(1, &g_vao);
-  glBindVertexArray(g_vao);
+  glstate_bind_vao(g_vao);
 
   glGenBuffers(1, &g_vbo);
-  glBindBuffer(GL_ARRAY_BUFFER, g_vbo);
+  glstate_bind_buffer(GL_ARRAY_BUFFER, g_vbo);
   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
-  glEnableVertexAttribArray(0);
+  vertex_format_setup<vertex_pos_s>();
 
   glGenBuffers(1, &g_ebo);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_ebo);
+  glstate_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, g_ebo);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
                GL_STATIC_DRAW);
 }
 
 void clean() {
 
+  glstate_forget_vao(g_vao1);
+  glstate_forget_vao(g_vao);
+  glstate_forget_buffer(g_vbo);
+  glstate_forget_buffer(g_vbo1);
   glDeleteVertexArrays(1, &g_vao1);
   glDeleteVertexArrays(1, &g_vao);
   glDeleteBuffers(1, &g_vbo);
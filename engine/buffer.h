@@ -0,0 +1,176 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include "unity.h"
+
+#include "glcaps.h"
+#include "glstate.h"
+#include "vertex_format.h"
+
+// Buffers and vertex arrays are created through these helpers so that, when
+// the context has direct state access, uploads don't disturb any binding and
+// static data gets immutable storage. Without DSA they fall back to the
+// bind-to-edit GL 3.3 calls.
+
+enum buffer_flags_e {
+  // contents are going to be rewritten with buffer_write
+  BUFFER_DYNAMIC = 1 << 0,
+  // rewritten every frame, through buffer_map_persistent when the context
+  // has buffer storage or buffer_orphan and buffer_write when it hasn't
+  BUFFER_STREAM = 1 << 1,
+};
+
+// buffer_create makes a buffer of size bytes, data may be NULL.
+GLuint buffer_create(size_t size, const void *data, int flags = 0) {
+  GLuint buf = 0;
+
+  if (g_glcaps.dsa) {
+    glCreateBuffers(1, &buf);
+    GLbitfield storage = (flags & BUFFER_DYNAMIC) ? GL_DYNAMIC_STORAGE_BIT : 0;
+    if (flags & BUFFER_STREAM) {
+      storage |= GL_DYNAMIC_STORAGE_BIT | GL_MAP_WRITE_BIT |
+                 GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    }
+    glNamedBufferStorage(buf, size, data, storage);
+    return buf;
+  }
+
+  // buffers are untyped, copy target doesn't touch the vao state the way
+  // element array target would
+  glGenBuffers(1, &buf);
+  glstate_bind_buffer(GL_COPY_WRITE_BUFFER, buf);
+  GLenum usage = (flags & BUFFER_DYNAMIC) ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW;
+  glBufferData(GL_COPY_WRITE_BUFFER, size, data,
+               (flags & BUFFER_STREAM) ? GL_STREAM_DRAW : usage);
+  return buf;
+}
+
+// buffer_map_persistent maps the size bytes of a BUFFER_STREAM buffer for
+// writing until the buffer is destroyed. Writes are seen by the commands
+// issued after them, the caller makes sure the GPU is done with what it
+// overwrites. NULL without buffer storage.
+void *buffer_map_persistent(GLuint buf, size_t size) {
+  if (!g_glcaps.dsa) {
+    return NULL;
+  }
+  return glMapNamedBufferRange(buf, 0, size,
+                               GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+                                   GL_MAP_COHERENT_BIT);
+}
+
+// buffer_orphan gives the buffer new contents without waiting for the
+// commands still reading the old ones, which the driver keeps aside.
+void buffer_orphan(GLuint buf, size_t size) {
+  if (g_glcaps.dsa) {
+    glInvalidateBufferData(buf);
+    return;
+  }
+
+  glstate_bind_buffer(GL_COPY_WRITE_BUFFER, buf);
+  glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_DRAW);
+}
+
+// buffer_write replaces size bytes at offset, the buffer must be dynamic.
+void buffer_write(GLuint buf, size_t offset, size_t size, const void *data) {
+  if (g_glcaps.dsa) {
+    glNamedBufferSubData(buf, offset, size, data);
+    return;
+  }
+
+  glstate_bind_buffer(GL_COPY_WRITE_BUFFER, buf);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+}
+
+// buffer_copy copies size bytes between buffers on the GPU, ranges of the
+// same buffer must not overlap.
+void buffer_copy(GLuint src, size_t src_offset, GLuint dst, size_t dst_offset,
+                 size_t size) {
+  if (g_glcaps.dsa) {
+    glCopyNamedBufferSubData(src, dst, src_offset, dst_offset, size);
+    return;
+  }
+
+  glstate_bind_buffer(GL_COPY_READ_BUFFER, src);
+  glstate_bind_buffer(GL_COPY_WRITE_BUFFER, dst);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, src_offset,
+                      dst_offset, size);
+}
+
+// buffer_clear zeroes the whole buffer on the GPU, needs GL 4.3.
+void buffer_clear(GLuint buf) {
+  if (g_glcaps.dsa) {
+    glClearNamedBufferData(buf, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT,
+                           NULL);
+    return;
+  }
+
+  glstate_bind_buffer(GL_COPY_WRITE_BUFFER, buf);
+  glClearBufferData(GL_COPY_WRITE_BUFFER, GL_R32UI, GL_RED_INTEGER,
+                    GL_UNSIGNED_INT, NULL);
+}
+
+void buffer_destroy(GLuint *buf) {
+  if (*buf == 0) {
+    return;
+  }
+  glstate_forget_buffer(*buf);
+  glDeleteBuffers(1, buf);
+  *buf = 0;
+}
+
+GLuint vao_create() {
+  GLuint vao = 0;
+  if (g_glcaps.dsa) {
+    glCreateVertexArrays(1, &vao);
+  } else {
+    glGenVertexArrays(1, &vao);
+  }
+  return vao;
+}
+
+void vao_destroy(GLuint *vao) {
+  if (*vao == 0) {
+    return;
+  }
+  glstate_forget_vao(*vao);
+  glDeleteVertexArrays(1, vao);
+  *vao = 0;
+}
+
+// vao_attach_stream feeds attributes of V from buf starting at byte offset
+// base. Binding is the DSA buffer binding point, one per stream.
+template <typename V>
+void vao_attach_stream(GLuint vao, GLuint binding, GLuint buf, size_t base = 0,
+                       GLuint divisor = 0) {
+  if (!g_glcaps.dsa) {
+    glstate_bind_vao(vao);
+    glstate_bind_buffer(GL_ARRAY_BUFFER, buf);
+    vertex_format_setup<V>(base, divisor);
+    return;
+  }
+
+  glVertexArrayVertexBuffer(vao, binding, buf, base, sizeof(V));
+  glVertexArrayBindingDivisor(vao, binding, divisor);
+  for (const vertex_attrib_s &a : vertex_format<V>::attribs) {
+    glEnableVertexArrayAttrib(vao, a.location);
+    if (a.integer) {
+      glVertexArrayAttribIFormat(vao, a.location, a.size, a.type, a.offset);
+    } else {
+      glVertexArrayAttribFormat(vao, a.location, a.size, a.type, GL_FALSE,
+                                a.offset);
+    }
+    glVertexArrayAttribBinding(vao, a.location, binding);
+  }
+}
+
+void vao_attach_indices(GLuint vao, GLuint buf) {
+  if (g_glcaps.dsa) {
+    glVertexArrayElementBuffer(vao, buf);
+    return;
+  }
+
+  glstate_bind_vao(vao);
+  glstate_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, buf);
+}
+
+#endif
@@ -0,0 +1,306 @@
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include "unity.h"
+
+#include "alloc.h"
+#include "jobs.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CLUSTER_SSE 1
+#endif
+
+// Clustered light culling. The view frustum is split into a grid of froxels,
+// CLUSTER_X by CLUSTER_Y tiles of the screen and CLUSTER_Z slices of depth
+// growing exponentially from near to far. Point lights are spheres of the
+// range where they still add something, every cluster gets the list of
+// lights whose sphere touches its box, and shading only loops over the list
+// of the fragment's cluster.
+//
+// Clusters live in depth space: view space with z flipped, so z is the
+// distance in front of the eye. Lights must be given in view space.
+//
+// Every slice is one job. A job keeps the lights overlapping its depth range
+// and tests them against the boxes of its clusters, four at a time; lists
+// are packed into one array afterwards.
+
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define CLUSTER_COUNT (CLUSTER_X * CLUSTER_Y * CLUSTER_Z)
+// lights a cluster can hold, the rest are dropped and counted in overflow
+#define CLUSTER_MAX_LIGHTS 128
+// fraction of a light's brightest channel under which it no longer counts
+#define CLUSTER_LIGHT_CUTOFF (1.0f / 256.0f)
+
+struct clusters_s {
+  // projection the boxes were made for
+  float proj_x;
+  float proj_y;
+  float z_near;
+  float z_far;
+  // slice of a depth d is floor(log(d) * slice_scale + slice_bias)
+  float slice_scale;
+  float slice_bias;
+
+  // depth space boxes of the clusters
+  vec3 *box_min;
+  vec3 *box_max;
+
+  // depth space spheres of the frame's lights, center and range
+  vec4 *lights;
+  int lights_size;
+  int lights_cap;
+
+  // per slice, lights overlapping its depths as x, y, z and squared range
+  // arrays, padded to four with lights that touch nothing
+  float *slice_lights;
+  int *slice_index;
+  int slice_overflow[CLUSTER_Z];
+
+  // per cluster lists as the jobs write them, CLUSTER_MAX_LIGHTS each
+  uint16_t *scratch;
+  uint16_t *counts;
+
+  // packed result: offset and count into indices per cluster
+  uint32_t *grid;
+  uint16_t *indices;
+  int indices_size;
+  int overflow;
+};
+
+inline int cluster_index(int x, int y, int z) {
+  return (z * CLUSTER_Y + y) * CLUSTER_X + x;
+}
+
+// cluster_light_range is the distance at which attenuation 1 / (constant +
+// linear * d + quadratic * d^2) of a light of the given brightest channel
+// falls under CLUSTER_LIGHT_CUTOFF.
+float cluster_light_range(float constant, float linear, float quadratic,
+                          float brightness) {
+  float c = constant - brightness / CLUSTER_LIGHT_CUTOFF;
+  if (c >= 0.0f) {
+    return 0.0f;
+  }
+  if (quadratic <= 0.0f) {
+    return linear > 0.0f ? -c / linear : INFINITY;
+  }
+  return (-linear + sqrtf(linear * linear - 4.0f * quadratic * c)) /
+         (2.0f * quadratic);
+}
+
+void clusters_init(clusters_s *cl, int max_lights) {
+  *cl = {};
+  cl->lights_cap = max_lights;
+  cl->lights = (vec4 *)alloc_make(max_lights * sizeof(vec4));
+
+  int padded = (max_lights + 3) & ~3;
+  cl->slice_lights =
+      (float *)alloc_make(CLUSTER_Z * padded * 4 * sizeof(float));
+  cl->slice_index = (int *)alloc_make(CLUSTER_Z * padded * sizeof(int));
+
+  cl->box_min = (vec3 *)alloc_make(CLUSTER_COUNT * sizeof(vec3));
+  cl->box_max = (vec3 *)alloc_make(CLUSTER_COUNT * sizeof(vec3));
+  cl->scratch = (uint16_t *)alloc_make(CLUSTER_COUNT * CLUSTER_MAX_LIGHTS *
+                                       sizeof(uint16_t));
+  cl->counts = (uint16_t *)alloc_make(CLUSTER_COUNT * sizeof(uint16_t));
+  cl->grid = (uint32_t *)alloc_make(CLUSTER_COUNT * 2 * sizeof(uint32_t));
+  cl->indices = (uint16_t *)alloc_make(CLUSTER_COUNT * CLUSTER_MAX_LIGHTS *
+                                       sizeof(uint16_t));
+}
+
+void clusters_clean(clusters_s *cl) {
+  alloc_free(cl->lights);
+  alloc_free(cl->slice_lights);
+  alloc_free(cl->slice_index);
+  alloc_free(cl->box_min);
+  alloc_free(cl->box_max);
+  alloc_free(cl->scratch);
+  alloc_free(cl->counts);
+  alloc_free(cl->grid);
+  alloc_free(cl->indices);
+  *cl = {};
+}
+
+inline float cluster_slice_depth(const clusters_s *cl, int z) {
+  return cl->z_near * powf(cl->z_far / cl->z_near, (float)z / CLUSTER_Z);
+}
+
+// clusters_begin starts a frame with no lights. Boxes are remade when the
+// projection differs from the last one.
+void clusters_begin(clusters_s *cl, const mat4 &projection, float z_near,
+                    float z_far) {
+  cl->lights_size = 0;
+
+  float proj_x = projection[0][0];
+  float proj_y = projection[1][1];
+  if (proj_x == cl->proj_x && proj_y == cl->proj_y && z_near == cl->z_near &&
+      z_far == cl->z_far) {
+    return;
+  }
+  cl->proj_x = proj_x;
+  cl->proj_y = proj_y;
+  cl->z_near = z_near;
+  cl->z_far = z_far;
+
+  float log_range = logf(z_far / z_near);
+  cl->slice_scale = CLUSTER_Z / log_range;
+  cl->slice_bias = -CLUSTER_Z * logf(z_near) / log_range;
+
+  // a froxel spans its tile's ndc at both depths of its slice, the box holds
+  // all four extremes
+  for (int z = 0; z < CLUSTER_Z; z++) {
+    float d0 = cluster_slice_depth(cl, z);
+    float d1 = cluster_slice_depth(cl, z + 1);
+    for (int y = 0; y < CLUSTER_Y; y++) {
+      float ny0 = -1.0f + 2.0f * y / CLUSTER_Y;
+      float ny1 = -1.0f + 2.0f * (y + 1) / CLUSTER_Y;
+      for (int x = 0; x < CLUSTER_X; x++) {
+        float nx0 = -1.0f + 2.0f * x / CLUSTER_X;
+        float nx1 = -1.0f + 2.0f * (x + 1) / CLUSTER_X;
+
+        int c = cluster_index(x, y, z);
+        cl->box_min[c] = vec3(fmin(nx0 * d0, nx0 * d1) / proj_x,
+                              fmin(ny0 * d0, ny0 * d1) / proj_y, d0);
+        cl->box_max[c] = vec3(fmax(nx1 * d0, nx1 * d1) / proj_x,
+                              fmax(ny1 * d0, ny1 * d1) / proj_y, d1);
+      }
+    }
+  }
+}
+
+// clusters_add_light adds a point light at view space position and returns
+// its index in the lists, -1 when there is no room.
+int clusters_add_light(clusters_s *cl, vec3 position, float range) {
+  if (cl->lights_size == cl->lights_cap) {
+    return -1;
+  }
+  cl->lights[cl->lights_size] = vec4(position.x, position.y, -position.z,
+                                     range);
+  return cl->lights_size++;
+}
+
+// clusters_assign_slice fills lists of all clusters of slice z.
+void clusters_assign_slice(clusters_s *cl, int z) {
+  int padded = (cl->lights_cap + 3) & ~3;
+  float *lx = cl->slice_lights + z * padded * 4;
+  float *ly = lx + padded;
+  float *lz = ly + padded;
+  float *lr2 = lz + padded;
+  int *index = cl->slice_index + z * padded;
+
+  float d0 = cluster_slice_depth(cl, z);
+  float d1 = cluster_slice_depth(cl, z + 1);
+  int n = 0;
+  for (int i = 0; i < cl->lights_size; i++) {
+    vec4 l = cl->lights[i];
+    if (l.z + l.w < d0 || l.z - l.w > d1) {
+      continue;
+    }
+    lx[n] = l.x;
+    ly[n] = l.y;
+    lz[n] = l.z;
+    lr2[n] = l.w * l.w;
+    index[n] = i;
+    n++;
+  }
+  for (; n & 3; n++) {
+    lx[n] = ly[n] = lz[n] = 0.0f;
+    lr2[n] = -1.0f;
+    index[n] = 0;
+  }
+
+  cl->slice_overflow[z] = 0;
+  for (int y = 0; y < CLUSTER_Y; y++) {
+    for (int x = 0; x < CLUSTER_X; x++) {
+      int c = cluster_index(x, y, z);
+      vec3 lo = cl->box_min[c];
+      vec3 hi = cl->box_max[c];
+      uint16_t *list = cl->scratch + c * CLUSTER_MAX_LIGHTS;
+      int count = 0;
+
+      for (int i = 0; i < n; i += 4) {
+        int mask = 0;
+#ifdef CLUSTER_SSE
+        // squared distance from the centers to the box
+        __m128 zero = _mm_setzero_ps();
+        __m128 px = _mm_loadu_ps(lx + i);
+        __m128 py = _mm_loadu_ps(ly + i);
+        __m128 pz = _mm_loadu_ps(lz + i);
+        __m128 dx = _mm_max_ps(_mm_sub_ps(_mm_set1_ps(lo.x), px),
+                               _mm_sub_ps(px, _mm_set1_ps(hi.x)));
+        __m128 dy = _mm_max_ps(_mm_sub_ps(_mm_set1_ps(lo.y), py),
+                               _mm_sub_ps(py, _mm_set1_ps(hi.y)));
+        __m128 dz = _mm_max_ps(_mm_sub_ps(_mm_set1_ps(lo.z), pz),
+                               _mm_sub_ps(pz, _mm_set1_ps(hi.z)));
+        dx = _mm_max_ps(dx, zero);
+        dy = _mm_max_ps(dy, zero);
+        dz = _mm_max_ps(dz, zero);
+        __m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx),
+                               _mm_add_ps(_mm_mul_ps(dy, dy),
+                                          _mm_mul_ps(dz, dz)));
+        mask = _mm_movemask_ps(_mm_cmple_ps(d2, _mm_loadu_ps(lr2 + i)));
+#else
+        for (int k = 0; k < 4; k++) {
+          float dx = fmax(fmax(lo.x - lx[i + k], lx[i + k] - hi.x), 0.0f);
+          float dy = fmax(fmax(lo.y - ly[i + k], ly[i + k] - hi.y), 0.0f);
+          float dz = fmax(fmax(lo.z - lz[i + k], lz[i + k] - hi.z), 0.0f);
+          mask |= (dx * dx + dy * dy + dz * dz <= lr2[i + k]) << k;
+        }
+#endif
+        for (int k = 0; k < 4; k++) {
+          if (!(mask & (1 << k))) {
+            continue;
+          }
+          if (count == CLUSTER_MAX_LIGHTS) {
+            cl->slice_overflow[z]++;
+            continue;
+          }
+          list[count++] = (uint16_t)index[i + k];
+        }
+      }
+      cl->counts[c] = (uint16_t)count;
+    }
+  }
+}
+
+void clusters_assign_job(void *data, int z) {
+  clusters_s *cl = (clusters_s *)data;
+  clusters_assign_slice(cl, z);
+}
+
+// clusters_pack moves the lists of all clusters next to each other, in
+// cluster order.
+void clusters_pack(clusters_s *cl) {
+  int offset = 0;
+  cl->overflow = 0;
+  for (int c = 0; c < CLUSTER_COUNT; c++) {
+    int count = cl->counts[c];
+    memcpy(cl->indices + offset, cl->scratch + c * CLUSTER_MAX_LIGHTS,
+           count * sizeof(uint16_t));
+    cl->grid[c * 2 + 0] = offset;
+    cl->grid[c * 2 + 1] = count;
+    offset += count;
+  }
+  for (int z = 0; z < CLUSTER_Z; z++) {
+    cl->overflow += cl->slice_overflow[z];
+  }
+  cl->indices_size = offset;
+}
+
+// clusters_assign builds the lists of the lights added since clusters_begin,
+// on the workers when there are jobs.
+void clusters_assign(clusters_s *cl, jobs_s *jobs) {
+  if (jobs != NULL) {
+    jobs_dispatch(jobs, clusters_assign_job, cl, CLUSTER_Z);
+    jobs_wait(jobs);
+  } else {
+    for (int z = 0; z < CLUSTER_Z; z++) {
+      clusters_assign_slice(cl, z);
+    }
+  }
+  clusters_pack(cl);
+}
+
+#endif
@@ -0,0 +1,107 @@
+#include "unity.h"
+
+#ifndef CLUSTER_TEST_H
+#define CLUSTER_TEST_H
+
+#include "cluster.h"
+
+// clusterTestRandom is a small lcg in [0, 1), results must not depend on the
+// platform's rand
+internal float clusterTestRandom(uint32_t *state) {
+  *state = *state * 1664525u + 1013904223u;
+  return (*state >> 8) / 16777216.0f;
+}
+
+bool testClusters() {
+  float range = cluster_light_range(1.0f, 0.09f, 0.032f, 0.5f);
+  float attenuation = 0.5f / (1.0f + 0.09f * range + 0.032f * range * range);
+  if (fabs(attenuation - CLUSTER_LIGHT_CUTOFF) > 0.0001f) {
+    printf("clusters: range %f gives %f\n", range, attenuation);
+    return true;
+  }
+
+  clusters_s cl;
+  clusters_init(&cl, 64);
+  mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f,
+                               100.0f);
+  clusters_begin(&cl, proj, 0.1f, 100.0f);
+
+  // view space lights in front of the eye, some crossing the near plane
+  uint32_t seed = 1;
+  for (int i = 0; i < 61; i++) {
+    vec3 p(clusterTestRandom(&seed) * 40.0f - 20.0f,
+           clusterTestRandom(&seed) * 20.0f - 10.0f,
+           -clusterTestRandom(&seed) * 60.0f);
+    clusters_add_light(&cl, p, 0.5f + clusterTestRandom(&seed) * 6.0f);
+  }
+  clusters_assign(&cl, NULL);
+
+  // lists hold exactly the lights touching the boxes
+  for (int c = 0; c < CLUSTER_COUNT; c++) {
+    int want = 0;
+    for (int i = 0; i < cl.lights_size; i++) {
+      vec4 l = cl.lights[i];
+      vec3 d = glm::max(glm::max(cl.box_min[c] - vec3(l), vec3(l) - cl.box_max[c]),
+                        vec3(0.0f));
+      if (glm::dot(d, d) > l.w * l.w) {
+        continue;
+      }
+      want++;
+
+      bool found = false;
+      for (uint32_t k = 0; k < cl.grid[c * 2 + 1]; k++) {
+        found = found || cl.indices[cl.grid[c * 2] + k] == i;
+      }
+      if (!found) {
+        printf("clusters: light %d missing from cluster %d\n", i, c);
+        return true;
+      }
+    }
+    if ((int)cl.grid[c * 2 + 1] != want) {
+      printf("clusters: cluster %d has %d lights, want %d\n", c,
+             cl.grid[c * 2 + 1], want);
+      return true;
+    }
+  }
+
+  // points lit by a light find it in their cluster, looked up the way the
+  // shader does
+  for (int n = 0; n < 1000; n++) {
+    int i = (int)(clusterTestRandom(&seed) * cl.lights_size);
+    vec4 l = cl.lights[i];
+    vec3 dir = glm::normalize(vec3(clusterTestRandom(&seed) - 0.5f,
+                                   clusterTestRandom(&seed) - 0.5f,
+                                   clusterTestRandom(&seed) - 0.5f));
+    vec3 p = vec3(l) + dir * l.w * clusterTestRandom(&seed);
+    if (p.z <= 0.1f || p.z >= 100.0f || fabs(p.x * cl.proj_x / p.z) >= 1.0f ||
+        fabs(p.y * cl.proj_y / p.z) >= 1.0f) {
+      continue;
+    }
+
+    int x = (int)((p.x * cl.proj_x / p.z * 0.5f + 0.5f) * CLUSTER_X);
+    int y = (int)((p.y * cl.proj_y / p.z * 0.5f + 0.5f) * CLUSTER_Y);
+    int z = (int)floorf(logf(p.z) * cl.slice_scale + cl.slice_bias);
+    z = z < 0 ? 0 : (z >= CLUSTER_Z ? CLUSTER_Z - 1 : z);
+    int c = cluster_index(x, y, z);
+
+    bool found = false;
+    for (uint32_t k = 0; k < cl.grid[c * 2 + 1]; k++) {
+      found = found || cl.indices[cl.grid[c * 2] + k] == i;
+    }
+    if (!found) {
+      printf("clusters: point lit by %d misses it in cluster %d %d %d\n", i, x,
+             y, z);
+      return true;
+    }
+  }
+
+  if (cl.overflow != 0) {
+    printf("clusters: %d lights over the limit\n", cl.overflow);
+    return true;
+  }
+
+  clusters_clean(&cl);
+  return false;
+}
+
+#endif
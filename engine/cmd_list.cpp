@@ -0,0 +1,46 @@
+#include "cmd_list.h"
+
+#include "mesh.h"
+
+// cmd_list_replay submits the commands of cl in the order they were
+// recorded, on the thread owning the context.
+void cmd_list_replay(const cmd_list_s *cl) {
+  for (cmd_s *c = cmd_list_next(cl, NULL); c != NULL;
+       c = cmd_list_next(cl, c)) {
+    switch (c->type) {
+    case CMD_PIPELINE: {
+      gpu_pipeline_bind(&((cmd_pipeline_s *)c)->pipeline);
+      break;
+    }
+    case CMD_TEXTURE: {
+      cmd_texture_s *cmd = (cmd_texture_s *)c;
+      gpu_texture_bind(cmd->tex, cmd->slot);
+      break;
+    }
+    case CMD_TEXTURE_BUFFER: {
+      cmd_texture_s *cmd = (cmd_texture_s *)c;
+      gpu_texture_buffer_bind(cmd->tex, cmd->slot);
+      break;
+    }
+    case CMD_UNIFORM: {
+      cmd_uniform_s *cmd = (cmd_uniform_s *)c;
+      gpu_uniform_set(cmd->program, cmd->uniform, (gpu_uniform_e)cmd->type,
+                      cmd + 1, 1);
+      break;
+    }
+    case CMD_MULTI: {
+      cmd_multi_s *cmd = (cmd_multi_s *)c;
+      MeshSubmitMulti(cmd->in, cmd->instances, cmd->commands, cmd->first,
+                      cmd->count, cmd->multi);
+      break;
+    }
+    case CMD_MULTI_COUNT: {
+      cmd_multi_count_s *cmd = (cmd_multi_count_s *)c;
+      MeshSubmitMultiCount(cmd->in, cmd->instances, cmd->commands,
+                           cmd->first, cmd->counts, cmd->count_at,
+                           cmd->max_count);
+      break;
+    }
+    }
+  }
+}
@@ -0,0 +1,231 @@
+#ifndef CMD_LIST_H
+#define CMD_LIST_H
+
+#include "unity.h"
+
+#include "alloc.h"
+#include "indirect.h"
+#include "instance.h"
+#include "renderer.h"
+#include "shader.h"
+
+// Command lists: binds, uniforms and draws recorded into a linear buffer
+// without the context, replayed in order later by the thread owning it. Job
+// workers record slices of a frame into lists of their own, so recording
+// scales with the cores and replaying costs the GL thread little more than
+// the calls themselves.
+//
+// Commands keep what they need by value, uniforms included with the entry
+// shader_uniform found for their name.
+// Pointers only go to what outlives the list until it is replayed: shader
+// layouts, and the instance and command buffers of the frame. A list starts
+// with nothing bound, its first commands set everything its draws need.
+
+enum cmd_type_e {
+  CMD_PIPELINE,
+  CMD_TEXTURE,
+  CMD_TEXTURE_BUFFER,
+  CMD_UNIFORM,
+  // MeshSubmitMulti, the batch commands of the frame
+  CMD_MULTI,
+  // MeshSubmitMultiCount, commands written on the GPU
+  CMD_MULTI_COUNT,
+};
+
+// commands start at multiples of it
+#define CMD_ALIGN 8
+
+struct cmd_s {
+  uint16_t type;
+  // bytes of the command, this header included
+  uint16_t size;
+};
+
+struct cmd_pipeline_s {
+  cmd_s head;
+  gpu_pipeline_s pipeline;
+};
+
+struct cmd_texture_s {
+  cmd_s head;
+  gpu_texture_s tex;
+  int slot;
+};
+
+// cmd_uniform_s is followed by its value, floats or one int.
+struct cmd_uniform_s {
+  cmd_s head;
+  gpu_program_s program;
+  const gpu_uniform_s *uniform;
+  uint8_t type;
+};
+
+struct cmd_multi_s {
+  cmd_s head;
+  gpu_input_s in;
+  instance_buffer_s *instances;
+  indirect_buffer_s *commands;
+  int first;
+  int count;
+  bool multi;
+};
+
+struct cmd_multi_count_s {
+  cmd_s head;
+  gpu_input_s in;
+  gpu_buffer_s instances;
+  gpu_buffer_s commands;
+  int first;
+  gpu_buffer_s counts;
+  int count_at;
+  int max_count;
+};
+
+struct cmd_list_s {
+  uint8_t *data;
+  size_t size;
+  size_t cap;
+  int count;
+};
+
+// cmd_list_replay is in cmd_list.cpp, the rest records without the context
+void cmd_list_replay(const cmd_list_s *cl);
+
+void cmd_list_init(cmd_list_s *cl, size_t cap) {
+  *cl = {};
+  cl->data = (uint8_t *)alloc_make(cap);
+  cl->cap = cap;
+}
+
+void cmd_list_clean(cmd_list_s *cl) {
+  alloc_free(cl->data);
+  *cl = {};
+}
+
+// cmd_list_reset drops the commands, the memory is kept for the next frame.
+void cmd_list_reset(cmd_list_s *cl) {
+  cl->size = 0;
+  cl->count = 0;
+}
+
+// cmd_list_push appends a zeroed command of size bytes, the header included.
+// The buffer doubles when it is full, a list grows to what its slice needs
+// in the first frames and stays there.
+internal void *cmd_list_push(cmd_list_s *cl, cmd_type_e type, size_t size) {
+  size = (size + CMD_ALIGN - 1) / CMD_ALIGN * CMD_ALIGN;
+  assert(size <= UINT16_MAX);
+  if (cl->size + size > cl->cap) {
+    while (cl->size + size > cl->cap) {
+      cl->cap *= 2;
+    }
+    cl->data = (uint8_t *)alloc_resize(cl->data, cl->cap);
+  }
+  cmd_s *cmd = (cmd_s *)(cl->data + cl->size);
+  memset(cmd, 0, size);
+  cmd->type = (uint16_t)type;
+  cmd->size = (uint16_t)size;
+  cl->size += size;
+  cl->count++;
+  return cmd;
+}
+
+// cmd_list_next is the command after cmd, the first one for NULL and NULL
+// after the last.
+cmd_s *cmd_list_next(const cmd_list_s *cl, cmd_s *cmd) {
+  size_t at = cmd == NULL ? 0 : (uint8_t *)cmd - cl->data + cmd->size;
+  return at < cl->size ? (cmd_s *)(cl->data + at) : NULL;
+}
+
+void cmd_pipeline(cmd_list_s *cl, const gpu_pipeline_s *p) {
+  cmd_pipeline_s *cmd = (cmd_pipeline_s *)cmd_list_push(
+      cl, CMD_PIPELINE, sizeof(cmd_pipeline_s));
+  cmd->pipeline = *p;
+}
+
+void cmd_texture(cmd_list_s *cl, gpu_texture_s tex, int slot) {
+  cmd_texture_s *cmd = (cmd_texture_s *)cmd_list_push(cl, CMD_TEXTURE,
+                                                      sizeof(cmd_texture_s));
+  cmd->tex = tex;
+  cmd->slot = slot;
+}
+
+void cmd_texture_buffer(cmd_list_s *cl, gpu_texture_s tex, int slot) {
+  cmd_texture_s *cmd = (cmd_texture_s *)cmd_list_push(
+      cl, CMD_TEXTURE_BUFFER, sizeof(cmd_texture_s));
+  cmd->tex = tex;
+  cmd->slot = slot;
+}
+
+// cmd_uniform records the value v of type for the uniform name of sh, made
+// of count floats or ints. Uniforms the program doesn't use are left out.
+internal void cmd_uniform(cmd_list_s *cl, const shader_s *sh,
+                          const char *name, gpu_uniform_e type, const void *v,
+                          int count) {
+  const gpu_uniform_s *u = shader_uniform(sh, name);
+  if (u == NULL) {
+    return;
+  }
+  size_t values_size = count * sizeof(float);
+  cmd_uniform_s *cmd = (cmd_uniform_s *)cmd_list_push(
+      cl, CMD_UNIFORM, sizeof(cmd_uniform_s) + values_size);
+  cmd->program = sh->program;
+  cmd->uniform = u;
+  cmd->type = (uint8_t)type;
+  memcpy(cmd + 1, v, values_size);
+}
+
+void cmd_uniform_1i(cmd_list_s *cl, const shader_s *sh, const char *name,
+                    int x) {
+  cmd_uniform(cl, sh, name, GPU_UNIFORM_INT, &x, 1);
+}
+
+void cmd_uniform_1f(cmd_list_s *cl, const shader_s *sh, const char *name,
+                    float x) {
+  cmd_uniform(cl, sh, name, GPU_UNIFORM_FLOAT, &x, 1);
+}
+
+void cmd_uniform_2f(cmd_list_s *cl, const shader_s *sh, const char *name,
+                    float x, float y) {
+  float v[2] = {x, y};
+  cmd_uniform(cl, sh, name, GPU_UNIFORM_VEC2, v, 2);
+}
+
+void cmd_uniform_3f(cmd_list_s *cl, const shader_s *sh, const char *name,
+                    float x, float y, float z) {
+  float v[3] = {x, y, z};
+  cmd_uniform(cl, sh, name, GPU_UNIFORM_VEC3, v, 3);
+}
+
+void cmd_uniform_mat4fv(cmd_list_s *cl, const shader_s *sh, const char *name,
+                        const float *matrix) {
+  cmd_uniform(cl, sh, name, GPU_UNIFORM_MAT4, matrix, 16);
+}
+
+void cmd_multi(cmd_list_s *cl, gpu_input_s in, instance_buffer_s *instances,
+               indirect_buffer_s *commands, int first, int count,
+               bool multi) {
+  cmd_multi_s *cmd =
+      (cmd_multi_s *)cmd_list_push(cl, CMD_MULTI, sizeof(cmd_multi_s));
+  cmd->in = in;
+  cmd->instances = instances;
+  cmd->commands = commands;
+  cmd->first = first;
+  cmd->count = count;
+  cmd->multi = multi;
+}
+
+void cmd_multi_count(cmd_list_s *cl, gpu_input_s in, gpu_buffer_s instances,
+                     gpu_buffer_s commands, int first, gpu_buffer_s counts,
+                     int count_at, int max_count) {
+  cmd_multi_count_s *cmd = (cmd_multi_count_s *)cmd_list_push(
+      cl, CMD_MULTI_COUNT, sizeof(cmd_multi_count_s));
+  cmd->in = in;
+  cmd->instances = instances;
+  cmd->commands = commands;
+  cmd->first = first;
+  cmd->counts = counts;
+  cmd->count_at = count_at;
+  cmd->max_count = max_count;
+}
+
+#endif
@@ -0,0 +1,77 @@
+#include "unity.h"
+
+#ifndef CMD_LIST_TEST_H
+#define CMD_LIST_TEST_H
+
+#include "cmd_list.h"
+
+bool testCmdList() {
+  // small enough to grow while recording
+  cmd_list_s cl;
+  cmd_list_init(&cl, 16);
+  // as shader_init would list them
+  local_persist shader_s sh = {};
+  sh.program = {11};
+  shader_uniform_add(&sh, "materials", 3, GPU_UNIFORM_INT, 1);
+  shader_uniform_add(&sh, "clusterSlice", 5, GPU_UNIFORM_VEC2, 1);
+  gpu_pipeline_s pipeline = {};
+  pipeline.program = sh.program;
+  pipeline.layout = &sh;
+  pipeline.depth_compare = GPU_COMPARE_EQUAL;
+
+  cmd_pipeline(&cl, &pipeline);
+  cmd_uniform_1i(&cl, &sh, "materials", 8);
+  // the program doesn't use it, nothing is recorded
+  cmd_uniform_1f(&cl, &sh, "material.shininess", 32.0f);
+  cmd_uniform_2f(&cl, &sh, "clusterSlice", 0.5f, -2.0f);
+  cmd_texture(&cl, {7}, 3);
+
+  int types[4] = {CMD_PIPELINE, CMD_UNIFORM, CMD_UNIFORM, CMD_TEXTURE};
+  int i = 0;
+  for (cmd_s *c = cmd_list_next(&cl, NULL); c != NULL;
+       c = cmd_list_next(&cl, c), i++) {
+    if (i >= 4 || c->type != types[i] || c->size % CMD_ALIGN != 0) {
+      printf("cmd list: command %d of type %d, size %d\n", i, c->type,
+             c->size);
+      return true;
+    }
+    cmd_uniform_s *u = (cmd_uniform_s *)c;
+    const float *v = (const float *)(u + 1);
+    bool ok = true;
+    if (i == 0) {
+      cmd_pipeline_s *p = (cmd_pipeline_s *)c;
+      ok = p->pipeline.program.id == 11 && p->pipeline.layout == &sh &&
+           p->pipeline.depth_compare == GPU_COMPARE_EQUAL;
+    } else if (i == 1) {
+      ok = u->program.id == 11 && u->type == GPU_UNIFORM_INT &&
+           *(const int *)v == 8 && u->uniform->slot == 3;
+    } else if (i == 2) {
+      ok = u->type == GPU_UNIFORM_VEC2 && v[0] == 0.5f && v[1] == -2.0f &&
+           u->uniform->slot == 5;
+    } else {
+      cmd_texture_s *t = (cmd_texture_s *)c;
+      ok = t->tex.id == 7 && t->slot == 3;
+    }
+    if (!ok) {
+      printf("cmd list: command %d recorded wrong\n", i);
+      return true;
+    }
+  }
+  if (i != 4 || cl.count != 4) {
+    printf("cmd list: %d commands replayed of %d\n", i, cl.count);
+    return true;
+  }
+
+  // the memory stays for the next frame
+  size_t cap = cl.cap;
+  cmd_list_reset(&cl);
+  if (cmd_list_next(&cl, NULL) != NULL || cl.cap != cap) {
+    printf("cmd list: reset left commands\n");
+    return true;
+  }
+
+  cmd_list_clean(&cl);
+  return false;
+}
+
+#endif
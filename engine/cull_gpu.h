@@ -0,0 +1,245 @@
+#ifndef CULL_GPU_H
+#define CULL_GPU_H
+
+#include "unity.h"
+
+#include "instance.h"
+#include "renderer.h"
+#include "shader.h"
+
+// GPU culling of instanced multi draws, on compute (gpu_has_compute).
+//
+// Every frame the caller uploads its instances and one cull_draw_s per
+// indirect command. Instances that stay put may come from a buffer of their
+// own, uploaded when they change. The cull pass tests every instance's
+// bounding sphere against the frustum and the depth pyramid of the previous
+// frame and appends the visible ones to the range of their draw in
+// instances_out.
+// The compact pass then writes the commands of draws with visible instances,
+// packed at the start of their group, and counts them per group. The CPU
+// never reads any of it back: groups are drawn with the count from
+// group_counts, or with all their commands when the count variant of multi
+// draw is missing, the leftover ones are zeroed and draw nothing.
+//
+// The pyramid is built from the depth buffer after the opaque draws with
+// cull_gpu_build_pyramid. It holds the farthest depth of every texel's area,
+// an object whose nearest point is farther is hidden. Spheres are tested in
+// the view the pyramid was made with, not the current one, so a turning
+// camera doesn't hide what just came into view.
+
+// cull_draw_s is the std430 layout of Draw in cull.comp.
+struct cull_draw_s {
+  // bounding sphere in mesh space, center and radius
+  vec4 sphere;
+
+  uint32_t index_count;
+  uint32_t first_index;
+  int32_t base_vertex;
+  uint32_t first_instance;
+  uint32_t instance_count;
+
+  uint32_t group;
+  // first command of the group
+  uint32_t group_first;
+  uint32_t pad;
+};
+
+#define CULL_GPU_GROUP 64
+// draw of an instance no draw takes
+#define CULL_GPU_NO_DRAW 0xFFFFFFFFu
+
+struct cull_gpu_s {
+  shader_s cull;
+  shader_s compact;
+  shader_s hiz;
+
+  gpu_buffer_s draws;
+  gpu_buffer_s instance_draw;
+  gpu_buffer_s draw_counts;
+  gpu_buffer_s group_counts;
+  gpu_buffer_s commands_out;
+  gpu_buffer_s instances_out;
+  int instance_cap;
+  int draw_cap;
+
+  // copy of the depth buffer and the pyramid made from it, r32f with mips
+  gpu_texture_s depth;
+  gpu_texture_s pyramid;
+  int width;
+  int height;
+  int levels;
+  bool pyramid_ready;
+
+  // view and projection the pyramid was made with
+  mat4 pyramid_view;
+  mat4 pyramid_projection;
+};
+
+bool cull_gpu_init(cull_gpu_s *c, int instance_cap, int draw_cap) {
+  if (!gpu_has_compute() || !gpu_has_multi_draw()) {
+    printf("cull gpu: compute or multi draw indirect missing\n");
+    return false;
+  }
+
+  bool ok = shader_init_compute(&c->cull, "engine/shaders/cull.comp") &&
+            shader_init_compute(&c->compact, "engine/shaders/compact.comp") &&
+            shader_init_compute(&c->hiz, "engine/shaders/hiz.comp");
+  if (!ok) {
+    printf("cull gpu: shaders failed\n");
+    return false;
+  }
+
+  c->instance_cap = instance_cap;
+  c->draw_cap = draw_cap;
+  c->draws = gpu_buffer_create(draw_cap * sizeof(cull_draw_s), NULL,
+                               GPU_BUFFER_DYNAMIC);
+  c->instance_draw = gpu_buffer_create(instance_cap * sizeof(uint32_t), NULL,
+                                       GPU_BUFFER_DYNAMIC);
+  c->draw_counts = gpu_buffer_create(draw_cap * sizeof(uint32_t), NULL,
+                                     GPU_BUFFER_DYNAMIC);
+  c->group_counts = gpu_buffer_create(draw_cap * sizeof(uint32_t), NULL,
+                                      GPU_BUFFER_DYNAMIC);
+  c->commands_out = gpu_buffer_create(
+      draw_cap * sizeof(gpu_draw_indirect_s), NULL, GPU_BUFFER_DYNAMIC);
+  c->instances_out = gpu_buffer_create(instance_cap * sizeof(instance_s),
+                                       NULL, GPU_BUFFER_DYNAMIC);
+
+  c->depth = {};
+  c->pyramid = {};
+  c->width = 0;
+  c->height = 0;
+  c->pyramid_ready = false;
+  return true;
+}
+
+void cull_gpu_clean(cull_gpu_s *c) {
+  shader_clean(&c->cull);
+  shader_clean(&c->compact);
+  shader_clean(&c->hiz);
+  gpu_buffer_destroy(&c->draws);
+  gpu_buffer_destroy(&c->instance_draw);
+  gpu_buffer_destroy(&c->draw_counts);
+  gpu_buffer_destroy(&c->group_counts);
+  gpu_buffer_destroy(&c->commands_out);
+  gpu_buffer_destroy(&c->instances_out);
+  gpu_texture_destroy(&c->depth);
+  gpu_texture_destroy(&c->pyramid);
+}
+
+// cull_gpu_run culls the first retained_size instances of retained and then
+// those of ib, instance_draw[i] is the draw of the i-th of them or
+// CULL_GPU_NO_DRAW. view takes the world space instances to view space,
+// planes are the view space frustum planes, see frustum_planes.
+void cull_gpu_run(cull_gpu_s *c, instance_buffer_s *retained,
+                  int retained_size, instance_buffer_s *ib,
+                  const cull_draw_s *draws, int draws_size,
+                  const uint32_t *instance_draw, const mat4 &view,
+                  const vec4 planes[6], bool use_pyramid) {
+  int count = retained_size + ib->size;
+  assert(count <= c->instance_cap && draws_size <= c->draw_cap);
+  if (count == 0) {
+    return;
+  }
+
+  gpu_buffer_write(c->draws, 0, draws_size * sizeof(cull_draw_s), draws);
+  gpu_buffer_write(c->instance_draw, 0, count * sizeof(uint32_t),
+                   instance_draw);
+  gpu_buffer_clear(c->draw_counts);
+  gpu_buffer_clear(c->group_counts);
+  gpu_buffer_clear(c->commands_out);
+
+  gpu_buffer_bind_range(ib->src, 0, ib->base,
+                        (ib->size > 0 ? ib->size : 1) * sizeof(instance_s));
+  gpu_buffer_bind_base(c->instances_out, 1);
+  gpu_buffer_bind_base(c->draws, 2);
+  gpu_buffer_bind_base(c->instance_draw, 3);
+  gpu_buffer_bind_base(c->draw_counts, 4);
+  gpu_buffer_bind_base(c->group_counts, 5);
+  gpu_buffer_bind_base(c->commands_out, 6);
+  gpu_buffer_bind_base(retained->buf, 7);
+
+  shader_s *sh = &c->cull;
+  shader_use(sh);
+  shader_1ui(sh, "instanceCount", count);
+  shader_1ui(sh, "retainedCount", retained_size);
+  shader_1ui(sh, "instanceWords", sizeof(instance_s) / sizeof(uint32_t));
+  shader_mat4fv(sh, "view", glm::value_ptr(view));
+  shader_4fv(sh, "planes", 6, glm::value_ptr(planes[0]));
+
+  bool pyramid = use_pyramid && c->pyramid_ready;
+  shader_1i(sh, "usePyramid", pyramid);
+  if (pyramid) {
+    gpu_texture_bind(c->pyramid, 0);
+    shader_1i(sh, "pyramid", 0);
+    shader_mat4fv(sh, "pyramidView", glm::value_ptr(c->pyramid_view));
+    shader_mat4fv(sh, "projection", glm::value_ptr(c->pyramid_projection));
+    shader_2f(sh, "pyramidSize", c->width, c->height);
+    shader_1f(sh, "pyramidLevels", c->levels);
+  }
+  gpu_dispatch((count + CULL_GPU_GROUP - 1) / CULL_GPU_GROUP, 1, 1);
+  gpu_barrier(GPU_BARRIER_STORAGE);
+
+  sh = &c->compact;
+  shader_use(sh);
+  shader_1ui(sh, "drawCount", draws_size);
+  gpu_dispatch((draws_size + CULL_GPU_GROUP - 1) / CULL_GPU_GROUP, 1, 1);
+
+  // results are read as draw commands, draw counts and vertex attributes
+  gpu_barrier(GPU_BARRIER_COMMAND | GPU_BARRIER_VERTEX);
+}
+
+internal void cull_gpu_resize(cull_gpu_s *c, int width, int height) {
+  gpu_texture_destroy(&c->depth);
+  gpu_texture_destroy(&c->pyramid);
+  c->width = width;
+  c->height = height;
+  c->levels = 1;
+  for (int size = width > height ? width : height; size > 1; size /= 2) {
+    c->levels++;
+  }
+
+  c->depth = gpu_texture_storage(width, height, 1, GPU_FORMAT_DEPTH24);
+  c->pyramid = gpu_texture_storage(width, height, c->levels, GPU_FORMAT_R32F);
+}
+
+// cull_gpu_build_pyramid copies width by height of the depth of the bound
+// target and reduces it to the pyramid the next frame culls against. View
+// and projection are the ones the depth was rendered with.
+void cull_gpu_build_pyramid(cull_gpu_s *c, int width, int height,
+                            const mat4 &view, const mat4 &projection) {
+  if (width <= 0 || height <= 0) {
+    return;
+  }
+  if (width != c->width || height != c->height) {
+    cull_gpu_resize(c, width, height);
+  }
+
+  gpu_texture_copy_target(c->depth, width, height);
+  gpu_texture_bind(c->depth, 0);
+
+  shader_s *sh = &c->hiz;
+  shader_use(sh);
+  shader_1i(sh, "depth", 0);
+
+  int w = width;
+  int h = height;
+  for (int level = 0; level < c->levels; level++) {
+    shader_1i(sh, "level", level);
+    if (level > 0) {
+      gpu_image_bind(c->pyramid, level - 1, 0, GPU_FORMAT_R32F, false);
+    }
+    gpu_image_bind(c->pyramid, level, 1, GPU_FORMAT_R32F, true);
+    gpu_dispatch((w + 7) / 8, (h + 7) / 8, 1);
+    gpu_barrier(GPU_BARRIER_IMAGE);
+
+    w = w > 1 ? w / 2 : 1;
+    h = h > 1 ? h / 2 : 1;
+  }
+
+  gpu_barrier(GPU_BARRIER_TEXTURE);
+  c->pyramid_view = view;
+  c->pyramid_projection = projection;
+  c->pyramid_ready = true;
+}
+
+#endif
@@ -119,9 +119,7 @@ void MeshSetCube(mesh_s *m) {
     m->indices[i] = indices[i];
   }
 
-  assert(m->vao == 0);
-  assert(m->vbo == 0);
-  assert(m->ebo == 0);
+  assert(m->geometry == 0);
 }
 
 #endif
\ No newline at end of file
@@ -5,9 +5,7 @@
 #include "mesh.h"
 
 void MeshSetCubeTextured(mesh_s *m) {
-  assert(m->vao == 0);
-  assert(m->vbo == 0);
-  assert(m->ebo == 0);
+  assert(m->geometry == 0);
 
   float cube[] = {// front
                   -0.5f, -0.5f, -0.5f, 0.0f, 0.0f, -0.5f, 0.0f, 0.0f,
@@ -5,9 +5,7 @@
 #include "mesh.h"
 
 void mesh_init_ramp(mesh_s *m) {
-  assert(m->vao == 0);
-  assert(m->vbo == 0);
-  assert(m->ebo == 0);
+  assert(m->geometry == 0);
 
   float x_45deg = 0.70710678118f;
 
@@ -0,0 +1,96 @@
+#ifndef EXAMPLE_VOLUME_MESH_H
+#define EXAMPLE_VOLUME_MESH_H
+
+#include "alloc.h"
+#include "mesh.h"
+
+// Light volumes. Faces are wound counter clockwise seen from outside and lie
+// outside of the shape they stand for, so a volume never misses a pixel its
+// light reaches.
+
+internal void MeshVolumeAlloc(mesh_s *m, int verts, int indices) {
+  m->verts_size = verts;
+  m->verts_cap = verts;
+  m->verts = (vertex_s *)alloc_make(sizeof(vertex_s) * verts);
+  m->indices_size = indices;
+  m->indices_cap = indices;
+  m->indices = (uint *)alloc_make(sizeof(uint) * indices);
+  for (int i = 0; i < verts; i++) {
+    m->verts[i] = {};
+  }
+}
+
+// MeshSetSphere makes a sphere of rings by segments around the unit sphere.
+void MeshSetSphere(mesh_s *m, int rings, int segments) {
+  assert(m->geometry == 0);
+  MeshVolumeAlloc(m, (rings + 1) * segments, (rings - 1) * segments * 6);
+
+  // flat faces cut inside the sphere by at most these cosines
+  float grow = 1.0f / (cosf(glm::pi<float>() / rings) *
+                       cosf(glm::pi<float>() / segments));
+  for (int r = 0; r <= rings; r++) {
+    float theta = glm::pi<float>() * r / rings;
+    for (int s = 0; s < segments; s++) {
+      float phi = 2.0f * glm::pi<float>() * s / segments;
+      vec3 n(sinf(theta) * cosf(phi), cosf(theta), -sinf(theta) * sinf(phi));
+      m->verts[r * segments + s].pos = n * grow;
+      m->verts[r * segments + s].normal = n;
+    }
+  }
+
+  int i = 0;
+  for (int r = 0; r < rings; r++) {
+    for (int s = 0; s < segments; s++) {
+      uint a = r * segments + s;
+      uint b = r * segments + (s + 1) % segments;
+      uint c = a + segments;
+      uint d = b + segments;
+      // the first and last ring are single points, their quads triangles
+      if (r > 0) {
+        m->indices[i++] = a;
+        m->indices[i++] = c;
+        m->indices[i++] = b;
+      }
+      if (r < rings - 1) {
+        m->indices[i++] = b;
+        m->indices[i++] = c;
+        m->indices[i++] = d;
+      }
+    }
+  }
+  assert(i == m->indices_size);
+}
+
+// MeshSetCone makes a cone with its apex at the origin and a unit radius
+// base at z = -1.
+void MeshSetCone(mesh_s *m, int segments) {
+  assert(m->geometry == 0);
+  MeshVolumeAlloc(m, segments + 2, segments * 6);
+
+  float grow = 1.0f / cosf(glm::pi<float>() / segments);
+  for (int s = 0; s < segments; s++) {
+    float phi = 2.0f * glm::pi<float>() * s / segments;
+    m->verts[s].pos = vec3(cosf(phi) * grow, sinf(phi) * grow, -1.0f);
+    m->verts[s].normal = vec3(cosf(phi), sinf(phi), 0.0f);
+  }
+  uint apex = segments;
+  uint center = segments + 1;
+  m->verts[apex].pos = vec3(0.0f);
+  m->verts[apex].normal = vec3(0.0f, 0.0f, 1.0f);
+  m->verts[center].pos = vec3(0.0f, 0.0f, -1.0f);
+  m->verts[center].normal = vec3(0.0f, 0.0f, -1.0f);
+
+  int i = 0;
+  for (int s = 0; s < segments; s++) {
+    uint a = s;
+    uint b = (s + 1) % segments;
+    m->indices[i++] = apex;
+    m->indices[i++] = a;
+    m->indices[i++] = b;
+    m->indices[i++] = center;
+    m->indices[i++] = b;
+    m->indices[i++] = a;
+  }
+}
+
+#endif
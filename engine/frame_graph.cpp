@@ -0,0 +1,37 @@
+#include "frame_graph.h"
+
+void frame_graph_execute(frame_graph_s *fg) {
+  for (int s = 0; s < fg->pool_size; s++) {
+    frame_pool_entry_s *e = &fg->pool[s];
+    if (e->idle < 0) {
+      continue;
+    }
+    if (e->remake) {
+      gpu_target_destroy(&e->target);
+      e->remake = false;
+    }
+    if (e->busy_until < 0 && ++e->idle > FRAME_GRAPH_POOL_FRAMES) {
+      gpu_target_destroy(&e->target);
+      e->made = false;
+      e->idle = -1;
+      continue;
+    }
+    if (e->busy_until >= 0 && !e->made) {
+      e->target = gpu_target_create(e->desc.width, e->desc.height,
+                                    e->desc.colors, e->desc.colors_size);
+      e->made = true;
+    }
+  }
+
+  for (int i = 0; i < fg->order_size; i++) {
+    frame_pass_s *pass = &fg->passes[fg->order[i]];
+    pass->fn(fg, pass->data);
+  }
+}
+
+void frame_graph_clean(frame_graph_s *fg) {
+  for (int s = 0; s < fg->pool_size; s++) {
+    gpu_target_destroy(&fg->pool[s].target);
+  }
+  frame_graph_init(fg);
+}
@@ -0,0 +1,457 @@
+#ifndef FRAME_GRAPH_H
+#define FRAME_GRAPH_H
+
+#include "unity.h"
+
+#include "renderer.h"
+
+// Frame graph. Every frame the passes are declared again together with the
+// resources they read and write, then the graph is compiled:
+//
+// - passes whose writes nobody reads are culled, and the passes feeding only
+//   them after that. Imported resources (the window, targets kept across
+//   frames) always count as read, writing them is what the frame is for.
+//   Passes writing nothing (queries, read backs) always run.
+// - passes are ordered: a read comes after the writes of the resource
+//   declared before it, or after all of them when none was, and writes keep
+//   their declaration order with earlier reads and writes of the resource.
+// - transient targets get a target of the pool for the passes between their
+//   first and last use. Targets of equal size and formats whose uses don't
+//   overlap share one, so the pool holds as many as are alive at once.
+//
+// frame_graph_execute (frame_graph.cpp) makes the pool targets that are
+// missing and runs the passes. Compiling never touches the GPU.
+
+#define FRAME_GRAPH_MAX_PASSES 32
+#define FRAME_GRAPH_MAX_RESOURCES 32
+// reads or writes of one pass
+#define FRAME_GRAPH_MAX_USES 8
+#define FRAME_GRAPH_POOL_SIZE 16
+// frames a pool target goes unused before it is destroyed
+#define FRAME_GRAPH_POOL_FRAMES 60
+
+struct frame_graph_s;
+typedef void (*frame_pass_fn)(frame_graph_s *fg, void *data);
+
+// frame_target_desc_s is what a transient target is made of, targets alias
+// only with equal descs.
+struct frame_target_desc_s {
+  int width;
+  int height;
+  gpu_format_e colors[GPU_TARGET_MAX_COLORS];
+  int colors_size;
+};
+
+struct frame_resource_s {
+  const char *name;
+  bool imported;
+  // imported only, see frame_graph_import
+  const gpu_target_s *target;
+  // transient only
+  frame_target_desc_s desc;
+
+  // from compiling: passes still reading it, positions of its first and
+  // last use in the order and the pool target it lives in
+  int readers;
+  int first;
+  int last;
+  int slot;
+};
+
+struct frame_pass_s {
+  const char *name;
+  frame_pass_fn fn;
+  void *data;
+  int reads[FRAME_GRAPH_MAX_USES];
+  int reads_size;
+  int writes[FRAME_GRAPH_MAX_USES];
+  int writes_size;
+
+  // from compiling: writes still read by someone
+  int refs;
+  bool culled;
+};
+
+struct frame_pool_entry_s {
+  frame_target_desc_s desc;
+  gpu_target_s target;
+  // a desc without a target yet, made by frame_graph_execute
+  bool made;
+  // target of an earlier desc, destroyed and made again by
+  // frame_graph_execute
+  bool remake;
+  // frames since the entry was last used, -1 when the slot is empty
+  int idle;
+  // position in this frame's order until which it is taken
+  int busy_until;
+};
+
+struct frame_graph_s {
+  frame_pass_s passes[FRAME_GRAPH_MAX_PASSES];
+  int passes_size;
+  frame_resource_s resources[FRAME_GRAPH_MAX_RESOURCES];
+  int resources_size;
+
+  // passes that run, in order
+  int order[FRAME_GRAPH_MAX_PASSES];
+  int order_size;
+
+  // lives across frames, the rest is declared every frame
+  frame_pool_entry_s pool[FRAME_GRAPH_POOL_SIZE];
+  int pool_size;
+
+  // transient targets of the frame and the pool targets they took
+  int transient_count;
+  int slot_count;
+};
+
+void frame_graph_init(frame_graph_s *fg) {
+  *fg = {};
+  for (int i = 0; i < FRAME_GRAPH_POOL_SIZE; i++) {
+    fg->pool[i].idle = -1;
+  }
+}
+
+// frame_graph_begin forgets the passes and resources of the last frame, pool
+// targets stay.
+void frame_graph_begin(frame_graph_s *fg) {
+  fg->passes_size = 0;
+  fg->resources_size = 0;
+  fg->order_size = 0;
+  fg->transient_count = 0;
+  fg->slot_count = 0;
+}
+
+internal int frame_graph_resource(frame_graph_s *fg, const char *name) {
+  assert(fg->resources_size < FRAME_GRAPH_MAX_RESOURCES);
+  int r = fg->resources_size++;
+  frame_resource_s *res = &fg->resources[r];
+  *res = {};
+  res->name = name;
+  res->slot = -1;
+  return r;
+}
+
+// frame_graph_import gives the graph a resource it doesn't own, target is
+// what frame_graph_get gives back: NULL for the window, or for buffers and
+// textures the passes know themselves.
+int frame_graph_import(frame_graph_s *fg, const char *name,
+                       const gpu_target_s *target) {
+  int r = frame_graph_resource(fg, name);
+  fg->resources[r].imported = true;
+  fg->resources[r].target = target;
+  return r;
+}
+
+// frame_graph_target declares a transient target, it exists only between
+// its first and last use in the frame.
+int frame_graph_target(frame_graph_s *fg, const char *name, int width,
+                       int height, const gpu_format_e *colors,
+                       int colors_size) {
+  assert(colors_size <= GPU_TARGET_MAX_COLORS);
+  int r = frame_graph_resource(fg, name);
+  frame_target_desc_s *desc = &fg->resources[r].desc;
+  desc->width = width;
+  desc->height = height;
+  for (int i = 0; i < colors_size; i++) {
+    desc->colors[i] = colors[i];
+  }
+  desc->colors_size = colors_size;
+  return r;
+}
+
+int frame_graph_pass(frame_graph_s *fg, const char *name, frame_pass_fn fn,
+                     void *data) {
+  assert(fg->passes_size < FRAME_GRAPH_MAX_PASSES);
+  int p = fg->passes_size++;
+  frame_pass_s *pass = &fg->passes[p];
+  *pass = {};
+  pass->name = name;
+  pass->fn = fn;
+  pass->data = data;
+  return p;
+}
+
+void frame_graph_read(frame_graph_s *fg, int pass, int resource) {
+  frame_pass_s *p = &fg->passes[pass];
+  assert(p->reads_size < FRAME_GRAPH_MAX_USES);
+  p->reads[p->reads_size++] = resource;
+}
+
+void frame_graph_write(frame_graph_s *fg, int pass, int resource) {
+  frame_pass_s *p = &fg->passes[pass];
+  assert(p->writes_size < FRAME_GRAPH_MAX_USES);
+  p->writes[p->writes_size++] = resource;
+}
+
+internal bool frame_graph_uses(const int *uses, int size, int resource) {
+  for (int i = 0; i < size; i++) {
+    if (uses[i] == resource) {
+      return true;
+    }
+  }
+  return false;
+}
+
+internal bool frame_desc_equal(const frame_target_desc_s *a,
+                               const frame_target_desc_s *b) {
+  if (a->width != b->width || a->height != b->height ||
+      a->colors_size != b->colors_size) {
+    return false;
+  }
+  for (int i = 0; i < a->colors_size; i++) {
+    if (a->colors[i] != b->colors[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// frame_graph_cull counts readers of resources and writes of passes, then
+// takes out passes from the resources nobody reads backwards.
+internal void frame_graph_cull(frame_graph_s *fg) {
+  for (int r = 0; r < fg->resources_size; r++) {
+    fg->resources[r].readers = fg->resources[r].imported ? 1 : 0;
+  }
+  for (int p = 0; p < fg->passes_size; p++) {
+    frame_pass_s *pass = &fg->passes[p];
+    pass->refs = pass->writes_size;
+    pass->culled = false;
+    for (int i = 0; i < pass->reads_size; i++) {
+      fg->resources[pass->reads[i]].readers++;
+    }
+  }
+
+  int stack[FRAME_GRAPH_MAX_RESOURCES];
+  int stack_size = 0;
+  for (int r = 0; r < fg->resources_size; r++) {
+    if (fg->resources[r].readers == 0) {
+      stack[stack_size++] = r;
+    }
+  }
+  while (stack_size > 0) {
+    int r = stack[--stack_size];
+    for (int p = 0; p < fg->passes_size; p++) {
+      frame_pass_s *pass = &fg->passes[p];
+      if (pass->culled ||
+          !frame_graph_uses(pass->writes, pass->writes_size, r)) {
+        continue;
+      }
+      if (--pass->refs > 0) {
+        continue;
+      }
+      pass->culled = true;
+      for (int i = 0; i < pass->reads_size; i++) {
+        frame_resource_s *read = &fg->resources[pass->reads[i]];
+        if (--read->readers == 0) {
+          stack[stack_size++] = pass->reads[i];
+        }
+      }
+    }
+  }
+}
+
+// frame_graph_written_before tells whether a surviving pass declared before
+// pass writes resource.
+internal bool frame_graph_written_before(frame_graph_s *fg, int pass,
+                                         int resource) {
+  for (int p = 0; p < pass; p++) {
+    frame_pass_s *w = &fg->passes[p];
+    if (!w->culled && frame_graph_uses(w->writes, w->writes_size, resource)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// frame_graph_ahead tells whether pass reads a transient resource before
+// anything wrote it, the read then waits for the writes declared later.
+internal bool frame_graph_ahead(frame_graph_s *fg, int pass, int resource) {
+  frame_pass_s *p = &fg->passes[pass];
+  return !fg->resources[resource].imported &&
+         !frame_graph_uses(p->writes, p->writes_size, resource) &&
+         !frame_graph_written_before(fg, pass, resource);
+}
+
+// frame_graph_depends tells whether pass a has to run before pass b, both
+// surviving the culling.
+internal bool frame_graph_depends(frame_graph_s *fg, int a, int b) {
+  frame_pass_s *pa = &fg->passes[a];
+  frame_pass_s *pb = &fg->passes[b];
+
+  // b reads what a writes
+  for (int i = 0; i < pb->reads_size; i++) {
+    int r = pb->reads[i];
+    if (frame_graph_uses(pa->writes, pa->writes_size, r) &&
+        (a < b || frame_graph_ahead(fg, b, r))) {
+      return true;
+    }
+  }
+
+  // b writes what a wrote or read before it
+  if (a > b) {
+    return false;
+  }
+  for (int i = 0; i < pb->writes_size; i++) {
+    int r = pb->writes[i];
+    if (frame_graph_uses(pa->writes, pa->writes_size, r) ||
+        (frame_graph_uses(pa->reads, pa->reads_size, r) &&
+         !frame_graph_ahead(fg, a, r))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// frame_graph_sort puts the surviving passes in order, the first declared of
+// the ready ones goes next. False on a cycle.
+internal bool frame_graph_sort(frame_graph_s *fg) {
+  uint32_t deps[FRAME_GRAPH_MAX_PASSES] = {};
+  uint32_t pending = 0;
+  for (int b = 0; b < fg->passes_size; b++) {
+    if (fg->passes[b].culled) {
+      continue;
+    }
+    pending |= 1u << b;
+    for (int a = 0; a < fg->passes_size; a++) {
+      if (a != b && !fg->passes[a].culled && frame_graph_depends(fg, a, b)) {
+        deps[b] |= 1u << a;
+      }
+    }
+  }
+
+  fg->order_size = 0;
+  while (pending != 0) {
+    int next = -1;
+    for (int p = 0; p < fg->passes_size && next < 0; p++) {
+      if ((pending >> p) & 1 && (deps[p] & pending) == 0) {
+        next = p;
+      }
+    }
+    if (next < 0) {
+      printf("frame graph: passes depend on each other\n");
+      return false;
+    }
+    pending &= ~(1u << next);
+    fg->order[fg->order_size++] = next;
+  }
+  return true;
+}
+
+// frame_graph_evict picks the slot idle the longest of those not taken this
+// frame, for a new desc when the pool is full. Sizes change on every resize,
+// the old ones would otherwise hold the pool for FRAME_GRAPH_POOL_FRAMES.
+internal int frame_graph_evict(frame_graph_s *fg) {
+  int slot = -1;
+  for (int s = 0; s < fg->pool_size; s++) {
+    frame_pool_entry_s *e = &fg->pool[s];
+    if (e->busy_until < 0 && (slot < 0 || e->idle > fg->pool[slot].idle)) {
+      slot = s;
+    }
+  }
+  // more targets alive at once than the pool holds
+  assert(slot >= 0);
+  fg->pool[slot].remake = fg->pool[slot].made;
+  return slot;
+}
+
+// frame_graph_alias gives every transient target a pool slot: a free one of
+// the same desc when there is one, an empty, new or evicted one otherwise.
+internal void frame_graph_alias(frame_graph_s *fg) {
+  for (int r = 0; r < fg->resources_size; r++) {
+    fg->resources[r].first = -1;
+    fg->resources[r].last = -1;
+    fg->resources[r].slot = -1;
+  }
+  for (int i = 0; i < fg->order_size; i++) {
+    frame_pass_s *pass = &fg->passes[fg->order[i]];
+    for (int k = 0; k < pass->reads_size + pass->writes_size; k++) {
+      int r = k < pass->reads_size ? pass->reads[k]
+                                   : pass->writes[k - pass->reads_size];
+      frame_resource_s *res = &fg->resources[r];
+      if (res->first < 0) {
+        res->first = i;
+      }
+      res->last = i;
+    }
+  }
+
+  for (int s = 0; s < fg->pool_size; s++) {
+    fg->pool[s].busy_until = -1;
+  }
+
+  fg->transient_count = 0;
+  fg->slot_count = 0;
+  for (int i = 0; i < fg->order_size; i++) {
+    for (int r = 0; r < fg->resources_size; r++) {
+      frame_resource_s *res = &fg->resources[r];
+      if (res->imported || res->first != i) {
+        continue;
+      }
+      fg->transient_count++;
+
+      int slot = -1;
+      int empty = -1;
+      for (int s = 0; s < fg->pool_size; s++) {
+        frame_pool_entry_s *e = &fg->pool[s];
+        if (e->idle < 0) {
+          empty = empty < 0 ? s : empty;
+          continue;
+        }
+        if (slot < 0 && e->busy_until < i &&
+            frame_desc_equal(&e->desc, &res->desc)) {
+          slot = s;
+        }
+      }
+      if (slot < 0) {
+        if (empty < 0 && fg->pool_size < FRAME_GRAPH_POOL_SIZE) {
+          empty = fg->pool_size++;
+        }
+        if (empty < 0) {
+          empty = frame_graph_evict(fg);
+        }
+        slot = empty;
+        frame_pool_entry_s *e = &fg->pool[slot];
+        e->desc = res->desc;
+        e->made = false;
+        e->busy_until = -1;
+      }
+
+      frame_pool_entry_s *e = &fg->pool[slot];
+      if (e->busy_until < 0) {
+        fg->slot_count++;
+      }
+      e->idle = 0;
+      e->busy_until = res->last;
+      res->slot = slot;
+    }
+  }
+}
+
+// frame_graph_compile culls, orders and places the targets of the passes
+// declared since frame_graph_begin.
+bool frame_graph_compile(frame_graph_s *fg) {
+  frame_graph_cull(fg);
+  if (!frame_graph_sort(fg)) {
+    return false;
+  }
+  frame_graph_alias(fg);
+  return true;
+}
+
+// frame_graph_get is the target of a resource while the passes run.
+const gpu_target_s *frame_graph_get(frame_graph_s *fg, int resource) {
+  frame_resource_s *res = &fg->resources[resource];
+  if (res->imported) {
+    return res->target;
+  }
+  assert(res->slot >= 0);
+  return &fg->pool[res->slot].target;
+}
+
+// frame_graph_execute makes missing pool targets, runs the ordered passes
+// and destroys targets unused for a while.
+void frame_graph_execute(frame_graph_s *fg);
+void frame_graph_clean(frame_graph_s *fg);
+
+#endif
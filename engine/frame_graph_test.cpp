@@ -0,0 +1,148 @@
+#include "unity.h"
+
+#ifndef FRAME_GRAPH_TEST_H
+#define FRAME_GRAPH_TEST_H
+
+#include "frame_graph.h"
+
+internal void frameGraphTestPass(frame_graph_s *fg, void *data) {}
+
+bool testFrameGraph() {
+  frame_graph_s fg;
+  frame_graph_init(&fg);
+  frame_graph_begin(&fg);
+
+  gpu_format_e gbuffer[2] = {GPU_FORMAT_RGBA8, GPU_FORMAT_RGBA16F};
+  gpu_format_e color[1] = {GPU_FORMAT_RGBA8};
+  int window = frame_graph_import(&fg, "window", NULL);
+  int geometry = frame_graph_target(&fg, "gbuffer", 64, 64, gbuffer, 2);
+  int lit = frame_graph_target(&fg, "lit", 64, 64, color, 1);
+  int bloom = frame_graph_target(&fg, "bloom", 64, 64, color, 1);
+  int unused = frame_graph_target(&fg, "unused", 64, 64, color, 1);
+  int debug = frame_graph_target(&fg, "debug", 64, 64, gbuffer, 2);
+
+  // declared ahead of the pass writing what it reads
+  int lighting = frame_graph_pass(&fg, "lighting", frameGraphTestPass, NULL);
+  frame_graph_read(&fg, lighting, geometry);
+  frame_graph_write(&fg, lighting, lit);
+  int gpass = frame_graph_pass(&fg, "geometry", frameGraphTestPass, NULL);
+  frame_graph_write(&fg, gpass, geometry);
+  int blur = frame_graph_pass(&fg, "blur", frameGraphTestPass, NULL);
+  frame_graph_read(&fg, blur, lit);
+  frame_graph_write(&fg, blur, bloom);
+  int compose = frame_graph_pass(&fg, "compose", frameGraphTestPass, NULL);
+  frame_graph_read(&fg, compose, bloom);
+  frame_graph_read(&fg, compose, lit);
+  frame_graph_write(&fg, compose, window);
+  // chain nobody reads the end of
+  int dead = frame_graph_pass(&fg, "dead", frameGraphTestPass, NULL);
+  frame_graph_write(&fg, dead, debug);
+  int deader = frame_graph_pass(&fg, "deader", frameGraphTestPass, NULL);
+  frame_graph_read(&fg, deader, debug);
+  frame_graph_write(&fg, deader, unused);
+  int overlay = frame_graph_pass(&fg, "overlay", frameGraphTestPass, NULL);
+  frame_graph_write(&fg, overlay, window);
+
+  if (!frame_graph_compile(&fg)) {
+    printf("frame graph: compile failed\n");
+    return true;
+  }
+
+  int want[5] = {gpass, lighting, blur, compose, overlay};
+  if (fg.order_size != 5) {
+    printf("frame graph: %d passes run, want 5\n", fg.order_size);
+    return true;
+  }
+  for (int i = 0; i < 5; i++) {
+    if (fg.order[i] != want[i]) {
+      printf("frame graph: pass %s at %d\n", fg.passes[fg.order[i]].name, i);
+      return true;
+    }
+  }
+  if (!fg.passes[dead].culled || !fg.passes[deader].culled) {
+    printf("frame graph: unread chain not culled\n");
+    return true;
+  }
+
+  // lit is alive until compose, bloom can't take its target. gbuffer is
+  // done after lighting but no other target has its formats.
+  int s_geometry = fg.resources[geometry].slot;
+  int s_lit = fg.resources[lit].slot;
+  int s_bloom = fg.resources[bloom].slot;
+  if (s_lit == s_bloom || s_geometry == s_lit || fg.slot_count != 3 ||
+      fg.transient_count != 3) {
+    printf("frame graph: slots %d %d %d, %d for %d targets\n", s_geometry,
+           s_lit, s_bloom, fg.slot_count, fg.transient_count);
+    return true;
+  }
+
+  // a second target of the gbuffer formats starting after lighting aliases
+  // the gbuffer, the pool doesn't grow across frames
+  for (int frame = 0; frame < 2; frame++) {
+    frame_graph_begin(&fg);
+    window = frame_graph_import(&fg, "window", NULL);
+    int a = frame_graph_target(&fg, "a", 64, 64, gbuffer, 2);
+    int b = frame_graph_target(&fg, "b", 64, 64, gbuffer, 2);
+    int p0 = frame_graph_pass(&fg, "p0", frameGraphTestPass, NULL);
+    frame_graph_write(&fg, p0, a);
+    int p1 = frame_graph_pass(&fg, "p1", frameGraphTestPass, NULL);
+    frame_graph_read(&fg, p1, a);
+    frame_graph_write(&fg, p1, window);
+    int p2 = frame_graph_pass(&fg, "p2", frameGraphTestPass, NULL);
+    frame_graph_write(&fg, p2, b);
+    int p3 = frame_graph_pass(&fg, "p3", frameGraphTestPass, NULL);
+    frame_graph_read(&fg, p3, b);
+    frame_graph_write(&fg, p3, window);
+
+    if (!frame_graph_compile(&fg) ||
+        fg.resources[a].slot != fg.resources[b].slot || fg.slot_count != 1 ||
+        fg.pool_size != 3) {
+      printf("frame graph: a %d b %d, pool %d\n", fg.resources[a].slot,
+             fg.resources[b].slot, fg.pool_size);
+      return true;
+    }
+  }
+
+  // a window being resized gives the target a new size every frame, the
+  // pool evicts old sizes instead of running out
+  for (int frame = 0; frame < FRAME_GRAPH_POOL_SIZE * 3; frame++) {
+    frame_graph_begin(&fg);
+    window = frame_graph_import(&fg, "window", NULL);
+    int scene = frame_graph_target(&fg, "scene", 64 + frame, 64, color, 1);
+    int draw = frame_graph_pass(&fg, "draw", frameGraphTestPass, NULL);
+    frame_graph_write(&fg, draw, scene);
+    int up = frame_graph_pass(&fg, "upscale", frameGraphTestPass, NULL);
+    frame_graph_read(&fg, up, scene);
+    frame_graph_write(&fg, up, window);
+
+    bool ok = frame_graph_compile(&fg);
+    int slot = fg.resources[scene].slot;
+    if (!ok || slot < 0 || fg.pool_size > FRAME_GRAPH_POOL_SIZE ||
+        fg.pool[slot].desc.width != 64 + frame) {
+      printf("frame graph: resize frame %d, slot %d, pool %d\n", frame, slot,
+             fg.pool_size);
+      return true;
+    }
+  }
+
+  // passes reading each other's writes can't be ordered
+  frame_graph_begin(&fg);
+  int x = frame_graph_target(&fg, "x", 64, 64, color, 1);
+  int y = frame_graph_target(&fg, "y", 64, 64, color, 1);
+  window = frame_graph_import(&fg, "window", NULL);
+  int px = frame_graph_pass(&fg, "px", frameGraphTestPass, NULL);
+  frame_graph_read(&fg, px, y);
+  frame_graph_write(&fg, px, x);
+  int py = frame_graph_pass(&fg, "py", frameGraphTestPass, NULL);
+  frame_graph_read(&fg, py, x);
+  frame_graph_write(&fg, py, y);
+  frame_graph_write(&fg, py, window);
+  if (frame_graph_compile(&fg)) {
+    printf("frame graph: cycle compiled\n");
+    return true;
+  }
+
+  return false;
+}
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include "unity.h"
+
+#include "renderer.h"
+
+// Frame pacing: a fence goes in after every frame and the CPU waits, before
+// starting a frame, for the fence of the frame max_frames back. At most
+// max_frames frames are then in flight, the one being built included, which
+// bounds the latency from input to display, instead of the driver queueing
+// as many frames as it likes and blocking wherever it happens to be full.
+//
+// Time the CPU spends blocked on the GPU is measured. Waiting for the pacing
+// fence is the CPU being ahead, expected when the GPU is the bottleneck.
+// Waiting anywhere else, for a readback or a buffer the GPU still reads, is
+// a stall: code that may block goes through frame_pacer_wait, or between
+// frame_pacer_stall_begin and frame_pacer_stall_end, so it is counted with a
+// name.
+
+#define FRAME_PACER_MAX 3
+// waits shorter than this are a fence that was already signaled
+#define FRAME_PACER_STALL_MS 0.05f
+
+struct frame_pacer_stats_s {
+  // blocked on the pacing fence
+  float pace_ms;
+  // blocked anywhere else, how often and on what the longest
+  float stall_ms;
+  int stalls;
+  const char *worst;
+  float worst_ms;
+};
+
+struct frame_pacer_s {
+  // frames in flight, 1 to FRAME_PACER_MAX
+  int max_frames;
+  // fence of the frame in progress goes at index
+  gpu_fence_s fences[FRAME_PACER_MAX];
+  int index;
+
+  // stats of the frame in progress and of the previous complete frame
+  frame_pacer_stats_s frame;
+  frame_pacer_stats_s last;
+};
+
+global_variable frame_pacer_s g_frame_pacer;
+
+// frame_pacer_set_frames allows max_frames in flight from the next frame on.
+void frame_pacer_set_frames(int max_frames) {
+  g_frame_pacer.max_frames =
+      max_frames < 1 ? 1
+                     : (max_frames > FRAME_PACER_MAX ? FRAME_PACER_MAX
+                                                     : max_frames);
+}
+
+void frame_pacer_init(int max_frames) {
+  g_frame_pacer = {};
+  frame_pacer_set_frames(max_frames);
+}
+
+void frame_pacer_clean() {
+  for (int i = 0; i < FRAME_PACER_MAX; i++) {
+    gpu_fence_destroy(&g_frame_pacer.fences[i]);
+  }
+}
+
+internal float frame_pacer_ms(Uint64 start) {
+  return (SDL_GetPerformanceCounter() - start) * 1000.0f /
+         SDL_GetPerformanceFrequency();
+}
+
+// frame_pacer_block waits for f as long as it takes, the time it took in ms.
+internal float frame_pacer_block(gpu_fence_s f) {
+  Uint64 start = SDL_GetPerformanceCounter();
+  while (!gpu_fence_wait(f, 1000000000)) {
+  }
+  return frame_pacer_ms(start);
+}
+
+// frame_pacer_stall counts ms blocked on what, when it is long enough to be
+// a stall.
+internal void frame_pacer_stall(float ms, const char *what) {
+  frame_pacer_stats_s *s = &g_frame_pacer.frame;
+  if (ms < FRAME_PACER_STALL_MS) {
+    return;
+  }
+  s->stall_ms += ms;
+  s->stalls++;
+  if (ms > s->worst_ms) {
+    s->worst_ms = ms;
+    s->worst = what;
+  }
+}
+
+Uint64 frame_pacer_stall_begin() { return SDL_GetPerformanceCounter(); }
+
+// frame_pacer_stall_end counts the time since start as blocked on what.
+void frame_pacer_stall_end(Uint64 start, const char *what) {
+  frame_pacer_stall(frame_pacer_ms(start), what);
+}
+
+// frame_pacer_wait waits for f and counts the time as blocked on what.
+void frame_pacer_wait(gpu_fence_s f, const char *what) {
+  frame_pacer_stall(frame_pacer_block(f), what);
+}
+
+// frame_pacer_begin waits until the GPU is at most max_frames - 1 frames
+// behind, before anything of the frame is issued.
+void frame_pacer_begin() {
+  frame_pacer_s *p = &g_frame_pacer;
+  p->last = p->frame;
+  p->frame = {};
+
+  int back = (p->index + FRAME_PACER_MAX - p->max_frames) % FRAME_PACER_MAX;
+  p->frame.pace_ms = frame_pacer_block(p->fences[back]);
+  gpu_fence_destroy(&p->fences[back]);
+}
+
+// frame_pacer_end fences the frame, after its swap.
+void frame_pacer_end() {
+  frame_pacer_s *p = &g_frame_pacer;
+  gpu_fence_destroy(&p->fences[p->index]);
+  p->fences[p->index] = gpu_fence_insert();
+  p->index = (p->index + 1) % FRAME_PACER_MAX;
+}
+
+#endif
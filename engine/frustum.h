@@ -0,0 +1,185 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "unity.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FRUSTUM_SSE 1
+#endif
+
+// Bounds of meshes and culling of spheres against the view frustum. Both run
+// over many elements at once, with SSE when the target has it.
+
+// bounds_s is the axis aligned box of a set of points and the sphere around
+// the center of the box that holds them all.
+struct bounds_s {
+  vec3 min;
+  vec3 max;
+  vec3 center;
+  float radius;
+};
+
+#ifdef FRUSTUM_SSE
+
+// w lane is zero, reads exactly three floats
+internal inline __m128 frustum_load3(const float *src) {
+  __m128 xy = _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)src);
+  return _mm_movelh_ps(xy, _mm_load_ss(src + 2));
+}
+
+#endif
+
+// bounds_compute reduces count points, read every stride bytes starting from
+// pos, so they can live inside vertices.
+bounds_s bounds_compute(const vec3 *pos, size_t stride, int count) {
+  bounds_s b = {};
+  if (count == 0) {
+    return b;
+  }
+  const char *src = (const char *)pos;
+
+#ifdef FRUSTUM_SSE
+  __m128 lo = frustum_load3((const float *)src);
+  __m128 hi = lo;
+  for (int i = 1; i < count; i++) {
+    __m128 p = frustum_load3((const float *)(src + i * stride));
+    lo = _mm_min_ps(lo, p);
+    hi = _mm_max_ps(hi, p);
+  }
+  __m128 c = _mm_mul_ps(_mm_add_ps(lo, hi), _mm_set1_ps(0.5f));
+
+  // w lanes are zero, the sum of all four is the squared length
+  __m128 radius2 = _mm_setzero_ps();
+  for (int i = 0; i < count; i++) {
+    __m128 d = _mm_sub_ps(frustum_load3((const float *)(src + i * stride)), c);
+    d = _mm_mul_ps(d, d);
+    d = _mm_add_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 3, 0, 1)));
+    d = _mm_add_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(1, 0, 3, 2)));
+    radius2 = _mm_max_ss(radius2, d);
+  }
+
+  float out[4];
+  _mm_storeu_ps(out, lo);
+  b.min = vec3(out[0], out[1], out[2]);
+  _mm_storeu_ps(out, hi);
+  b.max = vec3(out[0], out[1], out[2]);
+  _mm_storeu_ps(out, c);
+  b.center = vec3(out[0], out[1], out[2]);
+  b.radius = sqrtf(_mm_cvtss_f32(radius2));
+#else
+  b.min = b.max = *(const vec3 *)src;
+  for (int i = 1; i < count; i++) {
+    const vec3 *p = (const vec3 *)(src + i * stride);
+    b.min = glm::min(b.min, *p);
+    b.max = glm::max(b.max, *p);
+  }
+  b.center = (b.min + b.max) * 0.5f;
+
+  float radius2 = 0.0f;
+  for (int i = 0; i < count; i++) {
+    vec3 d = *(const vec3 *)(src + i * stride) - b.center;
+    radius2 = fmax(radius2, glm::dot(d, d));
+  }
+  b.radius = sqrtf(radius2);
+#endif
+  return b;
+}
+
+// bounds_transform gives the box around the box of b placed by model.
+bounds_s bounds_transform(const bounds_s *b, const mat4 &model) {
+  vec3 center = vec3(model * vec4((b->min + b->max) * 0.5f, 1.0f));
+  vec3 half = (b->max - b->min) * 0.5f;
+  vec3 extent = glm::abs(vec3(model[0])) * half.x +
+                glm::abs(vec3(model[1])) * half.y +
+                glm::abs(vec3(model[2])) * half.z;
+
+  bounds_s out;
+  out.min = center - extent;
+  out.max = center + extent;
+  out.center = center;
+  out.radius = glm::length(extent);
+  return out;
+}
+
+// bounds_sphere gives the sphere of the bounds placed by model, scaled by the
+// largest scale of its axes.
+vec4 bounds_sphere(const bounds_s *b, const mat4 &model) {
+  vec3 center = vec3(model * vec4(b->center, 1.0f));
+  float scale2 = fmax(glm::dot(vec3(model[0]), vec3(model[0])),
+                      fmax(glm::dot(vec3(model[1]), vec3(model[1])),
+                           glm::dot(vec3(model[2]), vec3(model[2]))));
+  return vec4(center, b->radius * sqrtf(scale2));
+}
+
+// frustum_planes gives the planes of the clip volume of m in the space m
+// transforms from (Gribb, Hartmann): projection alone gives view space planes,
+// projection * view world space ones. Normals point inside, a point p is
+// inside all of them when dot(plane, vec4(p, 1)) >= 0.
+void frustum_planes(const mat4 &m, vec4 planes[6]) {
+  mat4 t = glm::transpose(m);
+  planes[0] = t[3] + t[0];
+  planes[1] = t[3] - t[0];
+  planes[2] = t[3] + t[1];
+  planes[3] = t[3] - t[1];
+  planes[4] = t[3] + t[2];
+  planes[5] = t[3] - t[2];
+  for (int i = 0; i < 6; i++) {
+    planes[i] /= glm::length(vec3(planes[i]));
+  }
+}
+
+// frustum_cull_spheres sets visible[i] for spheres (center, radius) touching
+// the inside of all planes and returns how many do. Spheres go four at a time
+// through every plane.
+int frustum_cull_spheres(const vec4 planes[6], const vec4 *spheres, int count,
+                         uint8_t *visible) {
+  int visible_count = 0;
+  int i = 0;
+
+#ifdef FRUSTUM_SSE
+  __m128 px[6], py[6], pz[6], pw[6];
+  for (int p = 0; p < 6; p++) {
+    px[p] = _mm_set1_ps(planes[p].x);
+    py[p] = _mm_set1_ps(planes[p].y);
+    pz[p] = _mm_set1_ps(planes[p].z);
+    pw[p] = _mm_set1_ps(planes[p].w);
+  }
+
+  for (; i + 4 <= count; i += 4) {
+    __m128 x = _mm_loadu_ps(&spheres[i + 0].x);
+    __m128 y = _mm_loadu_ps(&spheres[i + 1].x);
+    __m128 z = _mm_loadu_ps(&spheres[i + 2].x);
+    __m128 r = _mm_loadu_ps(&spheres[i + 3].x);
+    _MM_TRANSPOSE4_PS(x, y, z, r);
+    __m128 neg_r = _mm_sub_ps(_mm_setzero_ps(), r);
+
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (int p = 0; p < 6; p++) {
+      __m128 d = _mm_add_ps(_mm_mul_ps(x, px[p]), pw[p]);
+      d = _mm_add_ps(d, _mm_mul_ps(y, py[p]));
+      d = _mm_add_ps(d, _mm_mul_ps(z, pz[p]));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(d, neg_r));
+    }
+
+    int mask = _mm_movemask_ps(inside);
+    for (int k = 0; k < 4; k++) {
+      visible[i + k] = (mask >> k) & 1;
+      visible_count += visible[i + k];
+    }
+  }
+#endif
+
+  for (; i < count; i++) {
+    vec4 s = spheres[i];
+    bool inside = true;
+    for (int p = 0; p < 6 && inside; p++) {
+      inside = glm::dot(vec3(planes[p]), vec3(s)) + planes[p].w >= -s.w;
+    }
+    visible[i] = inside;
+    visible_count += inside;
+  }
+  return visible_count;
+}
+
+#endif
@@ -0,0 +1,62 @@
+#include "unity.h"
+
+#ifndef FRUSTUM_TEST_H
+#define FRUSTUM_TEST_H
+
+#include "frustum.h"
+
+bool testFrustumCull() {
+  vec3 points[5] = {vec3(1, -2, 3), vec3(-4, 5, 0), vec3(2, 2, -6),
+                    vec3(0, 0, 0), vec3(3, -1, 1)};
+  bounds_s b = bounds_compute(points, sizeof(vec3), 5);
+  vec3 want_min(-4, -2, -6);
+  vec3 want_max(3, 5, 3);
+  if (glm::length(b.min - want_min) > 0.001f ||
+      glm::length(b.max - want_max) > 0.001f) {
+    printf("bounds: box [%f %f %f] [%f %f %f]\n", b.min.x, b.min.y, b.min.z,
+           b.max.x, b.max.y, b.max.z);
+    return true;
+  }
+  float radius = 0.0f;
+  for (int i = 0; i < 5; i++) {
+    radius = fmax(radius, glm::length(points[i] - b.center));
+  }
+  if (fabs(b.radius - radius) > 0.001f) {
+    printf("bounds: radius %f != %f\n", b.radius, radius);
+    return true;
+  }
+
+  // camera at the origin looking down -z, near 1, far 10
+  mat4 proj = glm::perspective(glm::radians(90.0f), 1.0f, 1.0f, 10.0f);
+  vec4 planes[6];
+  frustum_planes(proj, planes);
+
+  // more than four to go through the tail too
+  vec4 spheres[7] = {
+      vec4(0, 0, -5, 1),    // inside
+      vec4(0, 0, 5, 1),     // behind
+      vec4(0, 0, -20, 1),   // beyond far
+      vec4(0, 0, -10.5, 1), // crossing far
+      vec4(-9, 0, -5, 1),   // left
+      vec4(5.5, 0, -5, 1),  // crossing right
+      vec4(0, 8, -5, 1),    // above
+  };
+  uint8_t want[7] = {1, 0, 0, 1, 0, 1, 0};
+  uint8_t visible[7];
+  int count = frustum_cull_spheres(planes, spheres, 7, visible);
+  for (int i = 0; i < 7; i++) {
+    if (visible[i] != want[i]) {
+      printf("frustum: sphere %d visible %d, want %d\n", i, visible[i],
+             want[i]);
+      return true;
+    }
+  }
+  if (count != 3) {
+    printf("frustum: %d visible, want 3\n", count);
+    return true;
+  }
+
+  return false;
+}
+
+#endif
@@ -0,0 +1,273 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include "unity.h"
+
+#include "alloc.h"
+#include "range_alloc.h"
+#include "renderer.h"
+#include "vertex_format.h"
+
+// geometry_arena_s keeps the vertices and indices of many meshes of one
+// vertex format in a single vertex and a single index buffer, read through a
+// single input. Meshes own blocks of it and draw with base vertex, so going
+// from one mesh to another changes no binding.
+//
+// Blocks are referred to by handles, 0 is no block. Offsets of a block change
+// when the arena is defragmented, they have to be looked up at draw time.
+//
+// Positions are also kept apart, tightly packed at the same vertex offsets
+// and read through position_input, for passes that need nothing but depth.
+// Vertex formats of arenas must have a vec3 pos.
+
+// vertex_pos_s is a tightly packed position-only stream, for passes that
+// need nothing but depth.
+struct vertex_pos_s {
+  vec3 pos;
+};
+
+template <> struct vertex_format<vertex_pos_s> {
+  static constexpr vertex_attrib_s attribs[] = {
+      VERTEX_ATTRIB(0, vertex_pos_s, pos),
+  };
+};
+
+struct geometry_block_s {
+  // in vertices and indices, not bytes
+  int vertex_offset;
+  int vertex_count;
+  int index_offset;
+  int index_count;
+
+  bool live;
+};
+
+struct geometry_arena_s {
+  size_t stride;
+  size_t pos_offset;
+
+  gpu_input_s input;
+  gpu_buffer_s vbo;
+  gpu_buffer_s ebo;
+
+  gpu_input_s position_input;
+  gpu_buffer_s positions;
+
+  range_alloc_s vertices;
+  range_alloc_s indices;
+
+  // blocks[0] is never used
+  geometry_block_s *blocks;
+  int blocks_size;
+  int blocks_cap;
+};
+
+template <typename V>
+void geometry_arena_init(geometry_arena_s *ga, int vertex_cap, int index_cap) {
+  ga->stride = sizeof(V);
+  ga->pos_offset = offsetof(V, pos);
+
+  ga->vbo = gpu_buffer_create(vertex_cap * sizeof(V), NULL, GPU_BUFFER_DYNAMIC);
+  ga->ebo = gpu_buffer_create(index_cap * sizeof(uint32_t), NULL,
+                              GPU_BUFFER_DYNAMIC);
+  ga->input = gpu_input_create();
+  gpu_input_stream<V>(ga->input, 0, ga->vbo);
+  gpu_input_indices(ga->input, ga->ebo);
+
+  ga->positions = gpu_buffer_create(vertex_cap * sizeof(vertex_pos_s), NULL,
+                                    GPU_BUFFER_DYNAMIC);
+  ga->position_input = gpu_input_create();
+  gpu_input_stream<vertex_pos_s>(ga->position_input, 0, ga->positions);
+  gpu_input_indices(ga->position_input, ga->ebo);
+
+  range_alloc_init(&ga->vertices, vertex_cap);
+  range_alloc_init(&ga->indices, index_cap);
+
+  ga->blocks_cap = 16;
+  ga->blocks =
+      (geometry_block_s *)alloc_make(ga->blocks_cap * sizeof(geometry_block_s));
+  ga->blocks[0] = {};
+  ga->blocks_size = 1;
+}
+
+void geometry_arena_clean(geometry_arena_s *ga) {
+  gpu_input_destroy(&ga->input);
+  gpu_input_destroy(&ga->position_input);
+  gpu_buffer_destroy(&ga->vbo);
+  gpu_buffer_destroy(&ga->ebo);
+  gpu_buffer_destroy(&ga->positions);
+  range_alloc_clean(&ga->vertices);
+  range_alloc_clean(&ga->indices);
+  ga->blocks = (geometry_block_s *)alloc_free(ga->blocks);
+  ga->blocks_size = 0;
+  ga->blocks_cap = 0;
+}
+
+geometry_block_s *geometry_block(geometry_arena_s *ga, int handle) {
+  assert(handle > 0 && handle < ga->blocks_size && ga->blocks[handle].live);
+  return &ga->blocks[handle];
+}
+
+internal bool geometry_needs_defrag(const range_alloc_s *ra) {
+  // free space is in one range at the end already
+  if (ra->free_size == 0) {
+    return false;
+  }
+  return ra->free_size > 1 ||
+         ra->free[0].offset + ra->free[0].size != ra->capacity;
+}
+
+// geometry_compact moves the live vertices (or indices) of all blocks to the
+// start of their buffers. They go through temporary buffers, GL doesn't allow
+// overlapping copies within one buffer.
+internal void geometry_compact(geometry_arena_s *ga, bool indices) {
+  range_alloc_s *ra = indices ? &ga->indices : &ga->vertices;
+  // vertices move in both the full and the position buffer
+  gpu_buffer_s bufs[2] = {ga->vbo, ga->positions};
+  size_t units[2] = {ga->stride, sizeof(vertex_pos_s)};
+  int bufs_size = 2;
+  if (indices) {
+    bufs[0] = ga->ebo;
+    units[0] = sizeof(uint32_t);
+    bufs_size = 1;
+  }
+
+  int used = range_alloc_stats(ra).used;
+  if (used == 0) {
+    range_alloc_reset(ra, 0);
+    return;
+  }
+
+  gpu_buffer_s tmp[2];
+  for (int k = 0; k < bufs_size; k++) {
+    tmp[k] = gpu_buffer_create(used * units[k], NULL);
+  }
+  int packed = 0;
+  for (int i = 1; i < ga->blocks_size; i++) {
+    geometry_block_s *b = &ga->blocks[i];
+    int *offset = indices ? &b->index_offset : &b->vertex_offset;
+    int count = indices ? b->index_count : b->vertex_count;
+    if (!b->live || count == 0) {
+      continue;
+    }
+
+    for (int k = 0; k < bufs_size; k++) {
+      gpu_buffer_copy(bufs[k], *offset * units[k], tmp[k], packed * units[k],
+                      count * units[k]);
+    }
+    *offset = packed;
+    packed += count;
+  }
+  assert(packed == used);
+
+  for (int k = 0; k < bufs_size; k++) {
+    gpu_buffer_copy(tmp[k], 0, bufs[k], 0, packed * units[k]);
+    gpu_buffer_destroy(&tmp[k]);
+  }
+  range_alloc_reset(ra, packed);
+}
+
+// geometry_arena_defrag packs all blocks together, leaving the free space in
+// one range at the end of each buffer.
+void geometry_arena_defrag(geometry_arena_s *ga) {
+  if (geometry_needs_defrag(&ga->vertices)) {
+    geometry_compact(ga, false);
+  }
+  if (geometry_needs_defrag(&ga->indices)) {
+    geometry_compact(ga, true);
+  }
+}
+
+void geometry_free(geometry_arena_s *ga, int *handle) {
+  if (*handle == 0) {
+    return;
+  }
+
+  geometry_block_s *b = geometry_block(ga, *handle);
+  range_alloc_release(&ga->vertices, b->vertex_offset, b->vertex_count);
+  if (b->index_count > 0) {
+    range_alloc_release(&ga->indices, b->index_offset, b->index_count);
+  }
+  *b = {};
+  *handle = 0;
+}
+
+internal bool geometry_reserve(geometry_arena_s *ga, geometry_block_s *b) {
+  b->vertex_offset = range_alloc_make(&ga->vertices, b->vertex_count);
+  if (b->vertex_offset < 0) {
+    return false;
+  }
+
+  if (b->index_count > 0) {
+    b->index_offset = range_alloc_make(&ga->indices, b->index_count);
+    if (b->index_offset < 0) {
+      range_alloc_release(&ga->vertices, b->vertex_offset, b->vertex_count);
+      return false;
+    }
+  }
+  return true;
+}
+
+// geometry_alloc copies vertices and indices into the arena and returns handle
+// of their block, 0 when they don't fit even after defragmentation. Indices
+// are relative to the first vertex of the block.
+int geometry_alloc(geometry_arena_s *ga, const void *verts, int vertex_count,
+                   const uint32_t *indices, int index_count) {
+  assert(vertex_count > 0);
+
+  geometry_block_s b = {};
+  b.vertex_count = vertex_count;
+  b.index_count = index_count;
+  if (!geometry_reserve(ga, &b)) {
+    geometry_arena_defrag(ga);
+    if (!geometry_reserve(ga, &b)) {
+      printf("geometry alloc failed: no room for %d vertices, %d indices\n",
+             vertex_count, index_count);
+      return 0;
+    }
+  }
+  b.live = true;
+
+  gpu_buffer_write(ga->vbo, b.vertex_offset * ga->stride,
+                   vertex_count * ga->stride, verts);
+
+  vertex_pos_s *pos =
+      (vertex_pos_s *)alloc_make(vertex_count * sizeof(vertex_pos_s));
+  for (int i = 0; i < vertex_count; i++) {
+    const char *v = (const char *)verts + i * ga->stride + ga->pos_offset;
+    memcpy(&pos[i].pos, v, sizeof(vec3));
+  }
+  gpu_buffer_write(ga->positions, b.vertex_offset * sizeof(vertex_pos_s),
+                   vertex_count * sizeof(vertex_pos_s), pos);
+  alloc_free(pos);
+  if (index_count > 0) {
+    gpu_buffer_write(ga->ebo, b.index_offset * sizeof(uint32_t),
+                     index_count * sizeof(uint32_t), indices);
+  }
+
+  int handle = 1;
+  while (handle < ga->blocks_size && ga->blocks[handle].live) {
+    handle++;
+  }
+  if (handle == ga->blocks_size) {
+    ga->blocks = (geometry_block_s *)alloc_push(
+        ga->blocks, &ga->blocks_size, &ga->blocks_cap,
+        sizeof(geometry_block_s), &b);
+  } else {
+    ga->blocks[handle] = b;
+  }
+  return handle;
+}
+
+void geometry_arena_report(const geometry_arena_s *ga) {
+  range_alloc_stats_s v = range_alloc_stats(&ga->vertices);
+  range_alloc_stats_s i = range_alloc_stats(&ga->indices);
+  printf("geometry vertices: %d used, %d free in %d ranges, largest %d, "
+         "fragmentation %.2f\n",
+         v.used, v.free, v.free_ranges, v.largest_free, v.fragmentation);
+  printf("geometry indices: %d used, %d free in %d ranges, largest %d, "
+         "fragmentation %.2f\n",
+         i.used, i.free, i.free_ranges, i.largest_free, i.fragmentation);
+}
+
+#endif
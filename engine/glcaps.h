@@ -0,0 +1,50 @@
+#ifndef GLCAPS_H
+#define GLCAPS_H
+
+#include "unity.h"
+
+#include <stdlib.h>
+
+// glcaps_s tells which optional GL paths the context supports. The engine
+// always works with plain GL 3.3 core, everything here is an alternative.
+struct glcaps_s {
+  // direct state access with immutable buffer and texture storage
+  bool dsa;
+  // glMultiDrawElementsIndirect honouring base instance of the commands
+  bool mdi;
+  // and its variant taking the draw count from a buffer
+  bool mdi_count;
+  // compute shaders with storage buffers and images, GL 4.3
+  bool compute;
+  // GL_ANY_SAMPLES_PASSED_CONSERVATIVE occlusion queries
+  bool query_conservative;
+};
+
+global_variable glcaps_s g_glcaps;
+
+// glcaps_init must run after glewInit. Setting DANKETSU_GL33 in the
+// environment forces the GL 3.3 paths, to compare them.
+void glcaps_init() {
+  bool force_gl33 = getenv("DANKETSU_GL33") != NULL;
+
+  g_glcaps.dsa = !force_gl33 && GLEW_ARB_direct_state_access &&
+                 GLEW_ARB_buffer_storage && GLEW_ARB_texture_storage;
+  g_glcaps.mdi = !force_gl33 && GLEW_ARB_multi_draw_indirect &&
+                 GLEW_ARB_base_instance;
+  g_glcaps.mdi_count = g_glcaps.mdi && GLEW_ARB_indirect_parameters;
+  // compute shaders are written in glsl 430, extensions on an older context
+  // don't make them compile
+  g_glcaps.compute = !force_gl33 && GLEW_VERSION_4_3;
+  g_glcaps.query_conservative =
+      !force_gl33 && (GLEW_VERSION_4_3 || GLEW_ARB_ES3_compatibility);
+
+  printf("gl: %s\n", glGetString(GL_VERSION));
+  printf("gl: direct state access %s\n", g_glcaps.dsa ? "on" : "off");
+  printf("gl: multi draw indirect %s%s\n", g_glcaps.mdi ? "on" : "off",
+         g_glcaps.mdi_count ? ", with count" : "");
+  printf("gl: compute %s\n", g_glcaps.compute ? "on" : "off");
+  printf("gl: conservative queries %s\n",
+         g_glcaps.query_conservative ? "on" : "off");
+}
+
+#endif
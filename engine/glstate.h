@@ -0,0 +1,402 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include "unity.h"
+
+// glstate mirrors the bits of GL context state the engine touches, so that
+// binding something that is already bound never reaches the driver. All engine
+// and app code must bind through it, otherwise the mirror goes stale; code that
+// bypasses it (imgui, external libs) has to call glstate_invalidate after.
+
+#define GLSTATE_MAX_UNITS 16
+#define GLSTATE_MAX_STORAGE 8
+#define GLSTATE_UNKNOWN 0xFFFFFFFFu
+
+enum glstate_buffer_slot_e {
+  GLSTATE_ARRAY_BUFFER,
+  GLSTATE_ELEMENT_ARRAY_BUFFER,
+  GLSTATE_UNIFORM_BUFFER,
+  GLSTATE_TEXTURE_BUFFER,
+  GLSTATE_COPY_READ_BUFFER,
+  GLSTATE_COPY_WRITE_BUFFER,
+  GLSTATE_DRAW_INDIRECT_BUFFER,
+  GLSTATE_SHADER_STORAGE_BUFFER,
+  GLSTATE_PARAMETER_BUFFER,
+  GLSTATE_BUFFER_SLOTS,
+};
+
+enum glstate_cap_e {
+  GLSTATE_DEPTH_TEST,
+  GLSTATE_BLEND,
+  GLSTATE_CULL_FACE,
+  GLSTATE_STENCIL_TEST,
+  GLSTATE_SCISSOR_TEST,
+  GLSTATE_DEPTH_CLAMP,
+  GLSTATE_CAPS,
+};
+
+struct glstate_stats_s {
+  int issued;
+  int filtered;
+  int draws;
+};
+
+struct glstate_s {
+  GLuint program;
+  GLuint vao;
+  GLuint framebuffer;
+  GLuint buffers[GLSTATE_BUFFER_SLOTS];
+  // indexed shader storage bindings
+  GLuint storage[GLSTATE_MAX_STORAGE];
+
+  GLuint active_unit;
+  GLenum texture_targets[GLSTATE_MAX_UNITS];
+  GLuint textures[GLSTATE_MAX_UNITS];
+  GLuint samplers[GLSTATE_MAX_UNITS];
+
+  // 0 - disabled, 1 - enabled, GLSTATE_UNKNOWN - not known yet
+  GLuint caps[GLSTATE_CAPS];
+  GLenum depth_func;
+  GLuint depth_mask;
+  GLuint color_mask;
+  GLenum blend_src, blend_dst;
+  GLenum cull_mode;
+  GLint viewport[4];
+  GLenum stencil_func;
+  GLint stencil_ref;
+  // sfail, dpfail and dppass of front faces, then of back faces
+  GLenum stencil_ops[2][3];
+
+  // stats of the frame in progress and of the previous complete frame
+  glstate_stats_s frame;
+  glstate_stats_s last;
+};
+
+global_variable glstate_s g_glstate;
+
+internal int glstate_buffer_slot(GLenum target) {
+  switch (target) {
+  case GL_ARRAY_BUFFER:
+    return GLSTATE_ARRAY_BUFFER;
+  case GL_ELEMENT_ARRAY_BUFFER:
+    return GLSTATE_ELEMENT_ARRAY_BUFFER;
+  case GL_UNIFORM_BUFFER:
+    return GLSTATE_UNIFORM_BUFFER;
+  case GL_TEXTURE_BUFFER:
+    return GLSTATE_TEXTURE_BUFFER;
+  case GL_COPY_READ_BUFFER:
+    return GLSTATE_COPY_READ_BUFFER;
+  case GL_COPY_WRITE_BUFFER:
+    return GLSTATE_COPY_WRITE_BUFFER;
+  case GL_DRAW_INDIRECT_BUFFER:
+    return GLSTATE_DRAW_INDIRECT_BUFFER;
+  case GL_SHADER_STORAGE_BUFFER:
+    return GLSTATE_SHADER_STORAGE_BUFFER;
+  case GL_PARAMETER_BUFFER_ARB:
+    return GLSTATE_PARAMETER_BUFFER;
+  }
+  return -1;
+}
+
+internal int glstate_cap_slot(GLenum cap) {
+  switch (cap) {
+  case GL_DEPTH_TEST:
+    return GLSTATE_DEPTH_TEST;
+  case GL_BLEND:
+    return GLSTATE_BLEND;
+  case GL_CULL_FACE:
+    return GLSTATE_CULL_FACE;
+  case GL_STENCIL_TEST:
+    return GLSTATE_STENCIL_TEST;
+  case GL_SCISSOR_TEST:
+    return GLSTATE_SCISSOR_TEST;
+  case GL_DEPTH_CLAMP:
+    return GLSTATE_DEPTH_CLAMP;
+  }
+  return -1;
+}
+
+// glstate_invalidate forgets everything, next call of every kind reaches GL.
+void glstate_invalidate() {
+  glstate_s *s = &g_glstate;
+  s->program = GLSTATE_UNKNOWN;
+  s->vao = GLSTATE_UNKNOWN;
+  s->framebuffer = GLSTATE_UNKNOWN;
+  for (int i = 0; i < GLSTATE_BUFFER_SLOTS; i++) {
+    s->buffers[i] = GLSTATE_UNKNOWN;
+  }
+  for (int i = 0; i < GLSTATE_MAX_STORAGE; i++) {
+    s->storage[i] = GLSTATE_UNKNOWN;
+  }
+  s->active_unit = GLSTATE_UNKNOWN;
+  for (int i = 0; i < GLSTATE_MAX_UNITS; i++) {
+    s->texture_targets[i] = GLSTATE_UNKNOWN;
+    s->textures[i] = GLSTATE_UNKNOWN;
+    s->samplers[i] = GLSTATE_UNKNOWN;
+  }
+  for (int i = 0; i < GLSTATE_CAPS; i++) {
+    s->caps[i] = GLSTATE_UNKNOWN;
+  }
+  s->depth_func = GLSTATE_UNKNOWN;
+  s->depth_mask = GLSTATE_UNKNOWN;
+  s->color_mask = GLSTATE_UNKNOWN;
+  s->blend_src = GLSTATE_UNKNOWN;
+  s->blend_dst = GLSTATE_UNKNOWN;
+  s->cull_mode = GLSTATE_UNKNOWN;
+  s->viewport[0] = s->viewport[1] = s->viewport[2] = s->viewport[3] = -1;
+  s->stencil_func = GLSTATE_UNKNOWN;
+  s->stencil_ref = -1;
+  for (int f = 0; f < 2; f++) {
+    for (int i = 0; i < 3; i++) {
+      s->stencil_ops[f][i] = GLSTATE_UNKNOWN;
+    }
+  }
+}
+
+// glstate_frame_begin publishes the counters of the finished frame.
+void glstate_frame_begin() {
+  g_glstate.last = g_glstate.frame;
+  g_glstate.frame = {};
+}
+
+// glstate_changed counts the call and tells whether it has to be issued.
+internal bool glstate_changed(GLuint *cached, GLuint value) {
+  if (*cached == value) {
+    g_glstate.frame.filtered++;
+    return false;
+  }
+  *cached = value;
+  g_glstate.frame.issued++;
+  return true;
+}
+
+void glstate_use_program(GLuint program) {
+  if (glstate_changed(&g_glstate.program, program)) {
+    glUseProgram(program);
+  }
+}
+
+void glstate_bind_vao(GLuint vao) {
+  if (glstate_changed(&g_glstate.vao, vao)) {
+    glBindVertexArray(vao);
+    // element array binding is a part of the vao state
+    g_glstate.buffers[GLSTATE_ELEMENT_ARRAY_BUFFER] = GLSTATE_UNKNOWN;
+  }
+}
+
+// glstate_bind_framebuffer binds fb for both drawing and reading, 0 is the
+// window.
+void glstate_bind_framebuffer(GLuint fb) {
+  if (glstate_changed(&g_glstate.framebuffer, fb)) {
+    glBindFramebuffer(GL_FRAMEBUFFER, fb);
+  }
+}
+
+void glstate_bind_buffer(GLenum target, GLuint buffer) {
+  int slot = glstate_buffer_slot(target);
+  if (slot < 0) {
+    g_glstate.frame.issued++;
+    glBindBuffer(target, buffer);
+    return;
+  }
+
+  if (glstate_changed(&g_glstate.buffers[slot], buffer)) {
+    glBindBuffer(target, buffer);
+  }
+}
+
+// glstate_bind_storage_buffer binds buffer to shader storage binding index,
+// which binds it to the generic target too.
+void glstate_bind_storage_buffer(GLuint index, GLuint buffer) {
+  assert(index < GLSTATE_MAX_STORAGE);
+  if (glstate_changed(&g_glstate.storage[index], buffer)) {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, index, buffer);
+    g_glstate.buffers[GLSTATE_SHADER_STORAGE_BUFFER] = buffer;
+  }
+}
+
+// glstate_bind_storage_range binds size bytes of buffer from offset to
+// shader storage binding index. Ranges aren't mirrored, the binding is
+// unknown after it.
+void glstate_bind_storage_range(GLuint index, GLuint buffer, GLintptr offset,
+                                GLsizeiptr size) {
+  assert(index < GLSTATE_MAX_STORAGE);
+  g_glstate.frame.issued++;
+  glBindBufferRange(GL_SHADER_STORAGE_BUFFER, index, buffer, offset, size);
+  g_glstate.storage[index] = GLSTATE_UNKNOWN;
+  g_glstate.buffers[GLSTATE_SHADER_STORAGE_BUFFER] = buffer;
+}
+
+void glstate_active_texture(GLuint unit) {
+  assert(unit < GLSTATE_MAX_UNITS);
+  if (glstate_changed(&g_glstate.active_unit, unit)) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+  }
+}
+
+// glstate_bind_texture binds texture to the unit, switching active unit only
+// when the binding really changes.
+void glstate_bind_texture(GLuint unit, GLenum target, GLuint tex) {
+  glstate_s *s = &g_glstate;
+  assert(unit < GLSTATE_MAX_UNITS);
+  if (s->texture_targets[unit] == target && s->textures[unit] == tex) {
+    s->frame.filtered++;
+    return;
+  }
+
+  glstate_active_texture(unit);
+  s->texture_targets[unit] = target;
+  s->textures[unit] = tex;
+  s->frame.issued++;
+  glBindTexture(target, tex);
+}
+
+void glstate_bind_sampler(GLuint unit, GLuint sampler) {
+  assert(unit < GLSTATE_MAX_UNITS);
+  if (glstate_changed(&g_glstate.samplers[unit], sampler)) {
+    glBindSampler(unit, sampler);
+  }
+}
+
+void glstate_set(GLenum cap, bool enabled) {
+  int slot = glstate_cap_slot(cap);
+  if (slot >= 0 && !glstate_changed(&g_glstate.caps[slot], enabled)) {
+    return;
+  }
+  if (slot < 0) {
+    g_glstate.frame.issued++;
+  }
+
+  if (enabled) {
+    glEnable(cap);
+  } else {
+    glDisable(cap);
+  }
+}
+
+void glstate_depth_func(GLenum func) {
+  if (glstate_changed(&g_glstate.depth_func, func)) {
+    glDepthFunc(func);
+  }
+}
+
+void glstate_depth_mask(bool write) {
+  if (glstate_changed(&g_glstate.depth_mask, write)) {
+    glDepthMask(write ? GL_TRUE : GL_FALSE);
+  }
+}
+
+// glstate_color_mask switches writes of all color channels together.
+void glstate_color_mask(bool write) {
+  if (glstate_changed(&g_glstate.color_mask, write)) {
+    GLboolean w = write ? GL_TRUE : GL_FALSE;
+    glColorMask(w, w, w, w);
+  }
+}
+
+void glstate_blend_func(GLenum src, GLenum dst) {
+  glstate_s *s = &g_glstate;
+  if (s->blend_src == src && s->blend_dst == dst) {
+    s->frame.filtered++;
+    return;
+  }
+  s->blend_src = src;
+  s->blend_dst = dst;
+  s->frame.issued++;
+  glBlendFunc(src, dst);
+}
+
+// glstate_stencil_func tests against ref with all bits of the mask.
+void glstate_stencil_func(GLenum func, GLint ref) {
+  glstate_s *s = &g_glstate;
+  if (s->stencil_func == func && s->stencil_ref == ref) {
+    s->frame.filtered++;
+    return;
+  }
+  s->stencil_func = func;
+  s->stencil_ref = ref;
+  s->frame.issued++;
+  glStencilFunc(func, ref, 0xFF);
+}
+
+// glstate_stencil_op sets the operations of GL_FRONT or GL_BACK faces.
+void glstate_stencil_op(GLenum face, GLenum sfail, GLenum dpfail,
+                        GLenum dppass) {
+  GLenum *ops = g_glstate.stencil_ops[face == GL_BACK ? 1 : 0];
+  if (ops[0] == sfail && ops[1] == dpfail && ops[2] == dppass) {
+    g_glstate.frame.filtered++;
+    return;
+  }
+  ops[0] = sfail;
+  ops[1] = dpfail;
+  ops[2] = dppass;
+  g_glstate.frame.issued++;
+  glStencilOpSeparate(face, sfail, dpfail, dppass);
+}
+
+void glstate_cull_face(GLenum mode) {
+  if (glstate_changed(&g_glstate.cull_mode, mode)) {
+    glCullFace(mode);
+  }
+}
+
+void glstate_viewport(GLint x, GLint y, GLsizei w, GLsizei h) {
+  GLint *v = g_glstate.viewport;
+  if (v[0] == x && v[1] == y && v[2] == w && v[3] == h) {
+    g_glstate.frame.filtered++;
+    return;
+  }
+  v[0] = x;
+  v[1] = y;
+  v[2] = w;
+  v[3] = h;
+  g_glstate.frame.issued++;
+  glViewport(x, y, w, h);
+}
+
+// Deleting an object unbinds it from the context, the forget calls keep the
+// mirror in sync with that. They must be called before glDelete*.
+
+void glstate_forget_buffer(GLuint buffer) {
+  for (int i = 0; i < GLSTATE_BUFFER_SLOTS; i++) {
+    if (g_glstate.buffers[i] == buffer) {
+      g_glstate.buffers[i] = 0;
+    }
+  }
+  for (int i = 0; i < GLSTATE_MAX_STORAGE; i++) {
+    if (g_glstate.storage[i] == buffer) {
+      g_glstate.storage[i] = 0;
+    }
+  }
+}
+
+void glstate_forget_vao(GLuint vao) {
+  if (g_glstate.vao == vao) {
+    g_glstate.vao = 0;
+    g_glstate.buffers[GLSTATE_ELEMENT_ARRAY_BUFFER] = GLSTATE_UNKNOWN;
+  }
+}
+
+void glstate_forget_texture(GLuint tex) {
+  for (int i = 0; i < GLSTATE_MAX_UNITS; i++) {
+    if (g_glstate.textures[i] == tex) {
+      g_glstate.textures[i] = 0;
+    }
+  }
+}
+
+void glstate_forget_framebuffer(GLuint fb) {
+  // deleting the bound framebuffer binds the window back
+  if (g_glstate.framebuffer == fb) {
+    g_glstate.framebuffer = 0;
+  }
+}
+
+void glstate_forget_program(GLuint program) {
+  // deleting the current program is deferred by GL, the binding stays
+  if (g_glstate.program == program) {
+    g_glstate.program = GLSTATE_UNKNOWN;
+  }
+}
+
+#endif
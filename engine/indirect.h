@@ -0,0 +1,42 @@
+#ifndef INDIRECT_H
+#define INDIRECT_H
+
+#include "unity.h"
+
+#include "alloc.h"
+#include "renderer.h"
+
+// indirect_buffer_s collects multi draw commands of the frame on the CPU and
+// uploads them with one write, like instance_buffer_s does for instances.
+struct indirect_buffer_s {
+  gpu_buffer_s buf;
+
+  gpu_draw_indirect_s *data;
+  int size;
+  int cap;
+};
+
+void indirect_buffer_init(indirect_buffer_s *ind, int cap) {
+  ind->data =
+      (gpu_draw_indirect_s *)alloc_make(cap * sizeof(gpu_draw_indirect_s));
+  ind->size = 0;
+  ind->cap = cap;
+  ind->buf = gpu_buffer_create(cap * sizeof(gpu_draw_indirect_s), NULL,
+                               GPU_BUFFER_DYNAMIC);
+}
+
+void indirect_buffer_clean(indirect_buffer_s *ind) {
+  gpu_buffer_destroy(&ind->buf);
+  ind->data = (gpu_draw_indirect_s *)alloc_free(ind->data);
+  ind->size = 0;
+  ind->cap = 0;
+}
+
+void indirect_buffer_upload(indirect_buffer_s *ind) {
+  if (ind->size > 0) {
+    gpu_buffer_write(ind->buf, 0, ind->size * sizeof(gpu_draw_indirect_s),
+                     ind->data);
+  }
+}
+
+#endif
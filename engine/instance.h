@@ -0,0 +1,106 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include "unity.h"
+
+#include "alloc.h"
+#include "renderer.h"
+#include "stream.h"
+#include "vertex_format.h"
+
+// instance_s is the per-instance vertex stream of instanced draws. It takes
+// locations 3 and up, after the vertex_s attributes.
+struct instance_s {
+  // world space transform and normal matrix, the view comes as a uniform so
+  // instances of objects that don't move stay the same from frame to frame
+  mat4 model;
+  glm::mat3 normal;
+
+  vec4 color;
+  // row of the material table the shader reads, see light_color.frag
+  uint material;
+};
+
+#define VERTEX_ATTRIB_COLUMN(loc, V, field, col)                               \
+  vertex_attrib_s {                                                            \
+    loc,                                                                       \
+        vertex_attrib_traits<decltype(V::field)::col_type>::size,              \
+        vertex_attrib_traits<decltype(V::field)::col_type>::type, false,       \
+        (GLuint)(offsetof(V, field) +                                          \
+                 col * sizeof(decltype(V::field)::col_type))                   \
+  }
+
+template <> struct vertex_format<instance_s> {
+  static constexpr vertex_attrib_s attribs[] = {
+      VERTEX_ATTRIB_COLUMN(3, instance_s, model, 0),
+      VERTEX_ATTRIB_COLUMN(4, instance_s, model, 1),
+      VERTEX_ATTRIB_COLUMN(5, instance_s, model, 2),
+      VERTEX_ATTRIB_COLUMN(6, instance_s, model, 3),
+      VERTEX_ATTRIB_COLUMN(7, instance_s, normal, 0),
+      VERTEX_ATTRIB_COLUMN(8, instance_s, normal, 1),
+      VERTEX_ATTRIB_COLUMN(9, instance_s, normal, 2),
+      VERTEX_ATTRIB(10, instance_s, color),
+      VERTEX_ATTRIB(11, instance_s, material),
+  };
+};
+
+// instance_buffer_s collects instances of the frame on the CPU and uploads
+// them with one write. The GPU reads them from src at byte base, buf or the
+// range of the stream they were put in.
+struct instance_buffer_s {
+  gpu_buffer_s buf;
+  gpu_buffer_s src;
+  size_t base;
+
+  instance_s *data;
+  int size;
+  int cap;
+};
+
+void instance_buffer_init(instance_buffer_s *ib, int cap) {
+  ib->data = (instance_s *)alloc_make(cap * sizeof(instance_s));
+  ib->size = 0;
+  ib->cap = cap;
+  ib->buf = gpu_buffer_create(cap * sizeof(instance_s), NULL,
+                              GPU_BUFFER_DYNAMIC);
+  ib->src = ib->buf;
+  ib->base = 0;
+}
+
+void instance_buffer_clean(instance_buffer_s *ib) {
+  gpu_buffer_destroy(&ib->buf);
+  ib->data = (instance_s *)alloc_free(ib->data);
+  ib->size = 0;
+  ib->cap = 0;
+}
+
+void instance_buffer_upload(instance_buffer_s *ib) {
+  ib->src = ib->buf;
+  ib->base = 0;
+  if (ib->size > 0) {
+    gpu_buffer_write(ib->buf, 0, ib->size * sizeof(instance_s), ib->data);
+  }
+}
+
+// instance_buffer_stream puts the instances in the frame's region of s, the
+// GPU reads them from there until the frame ends. It falls back to
+// instance_buffer_upload when the region is full. Between stream_begin and
+// stream_end only.
+void instance_buffer_stream(instance_buffer_s *ib, stream_buffer_s *s) {
+  if (ib->size == 0) {
+    return;
+  }
+  size_t size = ib->size * sizeof(instance_s);
+  size_t offset = 0;
+  void *dst = stream_alloc(s, size, STREAM_ALIGN, &offset);
+  if (dst == NULL) {
+    instance_buffer_upload(ib);
+    return;
+  }
+  memcpy(dst, ib->data, size);
+  stream_flush(s);
+  ib->src = s->buf;
+  ib->base = offset;
+}
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include "unity.h"
+
+// Worker threads running one parallel loop at a time. jobs_dispatch hands
+// out indices [0, count) of a function and returns right away, so the
+// caller can do other work in the meantime; jobs_wait helps with the
+// remaining indices and returns when all of them are done. Jobs must not
+// touch GL, the context belongs to the render thread; they record into a
+// cmd_list_s instead.
+
+#define JOBS_MAX_WORKERS 8
+
+typedef void (*job_fn)(void *data, int index);
+
+struct jobs_s {
+  SDL_Thread *threads[JOBS_MAX_WORKERS];
+  int workers;
+
+  SDL_mutex *lock;
+  // workers sleep on wake while there is nothing to take, the waiter on done
+  SDL_cond *wake;
+  SDL_cond *done;
+
+  job_fn fn;
+  void *data;
+  int next;
+  int count;
+  // taken but not finished yet
+  int running;
+  bool quit;
+};
+
+// jobs_take runs the next index of the current loop, with lock held on entry
+// and exit. Returns false when there is none left.
+internal bool jobs_take(jobs_s *jobs) {
+  if (jobs->next >= jobs->count) {
+    return false;
+  }
+
+  int index = jobs->next++;
+  jobs->running++;
+  SDL_UnlockMutex(jobs->lock);
+  jobs->fn(jobs->data, index);
+  SDL_LockMutex(jobs->lock);
+  jobs->running--;
+
+  if (jobs->next >= jobs->count && jobs->running == 0) {
+    SDL_CondBroadcast(jobs->done);
+  }
+  return true;
+}
+
+internal int jobs_worker(void *data) {
+  jobs_s *jobs = (jobs_s *)data;
+  SDL_LockMutex(jobs->lock);
+  while (!jobs->quit) {
+    if (!jobs_take(jobs)) {
+      SDL_CondWait(jobs->wake, jobs->lock);
+    }
+  }
+  SDL_UnlockMutex(jobs->lock);
+  return 0;
+}
+
+// jobs_init starts worker threads, 0 leaves one core for the main thread.
+// With no workers started jobs_wait runs the whole loop by itself.
+bool jobs_init(jobs_s *jobs, int workers) {
+  *jobs = {};
+  if (workers <= 0) {
+    workers = SDL_GetCPUCount() - 1;
+  }
+  workers = workers < 1 ? 1 : workers;
+  workers = workers > JOBS_MAX_WORKERS ? JOBS_MAX_WORKERS : workers;
+
+  jobs->lock = SDL_CreateMutex();
+  jobs->wake = SDL_CreateCond();
+  jobs->done = SDL_CreateCond();
+  if (jobs->lock == NULL || jobs->wake == NULL || jobs->done == NULL) {
+    printf("jobs: %s\n", SDL_GetError());
+    return false;
+  }
+
+  for (int i = 0; i < workers; i++) {
+    jobs->threads[i] = SDL_CreateThread(jobs_worker, "job", jobs);
+    if (jobs->threads[i] == NULL) {
+      printf("jobs: %s\n", SDL_GetError());
+      break;
+    }
+    jobs->workers++;
+  }
+  return true;
+}
+
+void jobs_clean(jobs_s *jobs) {
+  if (jobs->lock != NULL) {
+    SDL_LockMutex(jobs->lock);
+    jobs->quit = true;
+    SDL_CondBroadcast(jobs->wake);
+    SDL_UnlockMutex(jobs->lock);
+  }
+  for (int i = 0; i < jobs->workers; i++) {
+    SDL_WaitThread(jobs->threads[i], NULL);
+  }
+
+  if (jobs->done != NULL) {
+    SDL_DestroyCond(jobs->done);
+  }
+  if (jobs->wake != NULL) {
+    SDL_DestroyCond(jobs->wake);
+  }
+  if (jobs->lock != NULL) {
+    SDL_DestroyMutex(jobs->lock);
+  }
+  *jobs = {};
+}
+
+// jobs_dispatch starts fn(data, i) for every i in [0, count). The previous
+// loop must have been waited for.
+void jobs_dispatch(jobs_s *jobs, job_fn fn, void *data, int count) {
+  SDL_LockMutex(jobs->lock);
+  assert(jobs->next >= jobs->count && jobs->running == 0);
+  jobs->fn = fn;
+  jobs->data = data;
+  jobs->next = 0;
+  jobs->count = count;
+  SDL_CondBroadcast(jobs->wake);
+  SDL_UnlockMutex(jobs->lock);
+}
+
+void jobs_wait(jobs_s *jobs) {
+  SDL_LockMutex(jobs->lock);
+  while (jobs_take(jobs)) {
+  }
+  while (jobs->running > 0) {
+    SDL_CondWait(jobs->done, jobs->lock);
+  }
+  SDL_UnlockMutex(jobs->lock);
+}
+
+#endif
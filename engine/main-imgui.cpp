@@ -1,6 +1,7 @@
 #include "unity.h"
 
 #include "flycamera.h"
+#include "glstate.h"
 #include "shader.h"
 
 // #include "../app/hello/hello.h"
@@ -92,9 +93,9 @@ void initTwoVAO() {
                        2.0f, 0.0f};
 
   glGenVertexArrays(1, &g_vao);
-  glBindVertexArray(g_vao);
+  glstate_bind_vao(g_vao);
   glGenBuffers(1, &g_vbo);
-  glBindBuffer(GL_ARRAY_BUFFER, g_vbo);
+  glstate_bind_buffer(GL_ARRAY_BUFFER, g_vbo);
   glBufferData(GL_ARRAY_BUFFER, sizeof(triangle1), triangle1, GL_STATIC_DRAW);
 
   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
@@ -107,9 +108,9 @@ void initTwoVAO() {
   glEnableVertexAttribArray(2);
 
   glGenVertexArrays(1, &g_vao1);
-  glBindVertexArray(g_vao1);
+  glstate_bind_vao(g_vao1);
   glGenBuffers(1, &g_vbo1);
-  glBindBuffer(GL_ARRAY_BUFFER, g_vbo1);
+  glstate_bind_buffer(GL_ARRAY_BUFFER, g_vbo1);
   glBufferData(GL_ARRAY_BUFFER, sizeof(triangle2), triangle2, GL_STATIC_DRAW);
 
   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
@@ -185,7 +186,7 @@ void renderTwoVAO() {
   shader_mat4fv(&g_shaders[0], "view", glm::value_ptr(view));
   shader_mat4fv(&g_shaders[0], "projection", glm::value_ptr(projection));
 
-  glBindVertexArray(g_vao);
+  glstate_bind_vao(g_vao);
   glDrawArrays(GL_TRIANGLES, 0, 3);
 
   shader_use(&g_shaders[1]);
@@ -199,7 +200,7 @@ void renderTwoVAO() {
   shader_mat4fv(&g_shaders[1], "view", glm::value_ptr(view));
   shader_mat4fv(&g_shaders[1], "projection", glm::value_ptr(projection));
 
-  glBindVertexArray(g_vao1);
+  glstate_bind_vao(g_vao1);
   glDrawArrays(GL_TRIANGLES, 0, 3);
 
   {
@@ -219,7 +220,7 @@ void renderTwoVAO() {
     shader_1i(&g_shaders[0], "tex2", 1);
     shader_mat4fv(&g_shaders[0], "transform", glm::value_ptr(trans));
 
-    glBindVertexArray(g_vao);
+    glstate_bind_vao(g_vao);
     glDrawArrays(GL_TRIANGLES, 0, 3);
 
     shader_use(&g_shaders[1]);
@@ -229,7 +230,7 @@ void renderTwoVAO() {
     shader_1i(&g_shaders[1], "tex2", 1);
     shader_mat4fv(&g_shaders[1], "transform", glm::value_ptr(trans));
 
-    glBindVertexArray(g_vao1);
+    glstate_bind_vao(g_vao1);
     glDrawArrays(GL_TRIANGLES, 0, 3);
   }
   {
@@ -252,7 +253,7 @@ void renderTwoVAO() {
     shader_1i(&g_shaders[0], "tex2", 1);
     shader_mat4fv(&g_shaders[0], "transform", glm::value_ptr(trans));
 
-    glBindVertexArray(g_vao);
+    glstate_bind_vao(g_vao);
     glDrawArrays(GL_TRIANGLES, 0, 3);
 
     shader_use(&g_shaders[1]);
@@ -262,7 +263,7 @@ void renderTwoVAO() {
     shader_1i(&g_shaders[1], "tex2", 1);
     shader_mat4fv(&g_shaders[1], "transform", glm::value_ptr(trans));
 
-    glBindVertexArray(g_vao1);
+    glstate_bind_vao(g_vao1);
     glDrawArrays(GL_TRIANGLES, 0, 3);
   }
 }
@@ -280,7 +281,7 @@ internal bool initTexture() {
     }
 
     glGenTextures(1, &g_tex[0]);
-    glBindTexture(GL_TEXTURE_2D, g_tex[0]);
+    glstate_bind_texture(0, GL_TEXTURE_2D, g_tex[0]);
 
     // set the texture wrapping/filtering options (on the currently bound
     // texture object)
@@ -310,7 +311,7 @@ internal bool initTexture() {
     }
 
     glGenTextures(1, &g_tex[1]);
-    glBindTexture(GL_TEXTURE_2D, g_tex[1]);
+    glstate_bind_texture(0, GL_TEXTURE_2D, g_tex[1]);
 
     // set the texture wrapping/filtering options (on the currently bound
     // texture object)
@@ -372,17 +373,17 @@ void triangleExampleVBO() {
   unsigned int indices[] = {0, 1, 2, 3, 4, 5};
 
   glGenVertexArrays(1, &g_vao);
-  glBindVertexArray(g_vao);
+  glstate_bind_vao(g_vao);
 
   glGenBuffers(1, &g_vbo);
-  glBindBuffer(GL_ARRAY_BUFFER, g_vbo);
+  glstate_bind_buffer(GL_ARRAY_BUFFER, g_vbo);
   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
   glEnableVertexAttribArray(0);
 
   glGenBuffers(1, &g_ebo);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_ebo);
+  glstate_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, g_ebo);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
                GL_STATIC_DRAW);
 }
@@ -427,7 +428,8 @@ internal bool init() {
     return false;
   }
 
-  glEnable(GL_DEPTH_TEST);
+  glstate_invalidate();
+  glstate_set(GL_DEPTH_TEST, true);
 
   // imgui init
   IMGUI_CHECKVERSION();
@@ -471,15 +473,17 @@ internal bool init() {
   // has to be done once
   // need activated program
   // shader_Use(&g_shaders[0]);
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, g_tex[0]);
-  glActiveTexture(GL_TEXTURE1);
-  glBindTexture(GL_TEXTURE_2D, g_tex[1]);
+  glstate_bind_texture(0, GL_TEXTURE_2D, g_tex[0]);
+  glstate_bind_texture(1, GL_TEXTURE_2D, g_tex[1]);
 
   return true;
 }
 
 internal void clean() {
+  glstate_forget_vao(g_vao1);
+  glstate_forget_vao(g_vao);
+  glstate_forget_buffer(g_vbo);
+  glstate_forget_buffer(g_vbo1);
   glDeleteVertexArrays(1, &g_vao1);
   glDeleteVertexArrays(1, &g_vao);
   glDeleteBuffers(1, &g_vbo);
@@ -522,7 +526,7 @@ int main(int argc, char *argv[]) {
         if (e.window.event == SDL_WINDOWEVENT_RESIZED) {
           g_screenWidth = e.window.data1;
           g_screenHeight = e.window.data2;
-          glViewport(0, 0, g_screenWidth, g_screenHeight);
+          glstate_viewport(0, 0, g_screenWidth, g_screenHeight);
           // is it good to do this here?
           cam->aspect = (float)g_screenWidth / (float)g_screenHeight;
         }
@@ -606,6 +610,8 @@ int main(int argc, char *argv[]) {
     app_update(&g_app, delta);
 
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    // imgui binds behind the mirror's back
+    glstate_invalidate();
 
     SDL_GL_SwapWindow(g_window);
   }
@@ -18,6 +18,91 @@ SDL_GLContext g_ctx;
 float prevTime = 0;
 
 Scene g_app = {};
+render_thread_s g_render_thread = {};
+
+// --bench draws the maze from where the camera starts with every count of
+// bench_lights in the light field, forward and deferred on the render thread
+// and forward serial, BENCH_FRAMES frames each after a warm up. It prints the
+// time per frame of each and quits.
+#define BENCH_WARMUP 120
+#define BENCH_FRAMES 1000
+#define BENCH_COUNTS 5
+
+enum bench_path_e {
+  BENCH_FORWARD,
+  BENCH_DEFERRED,
+  BENCH_SERIAL,
+  BENCH_PATHS,
+};
+
+// the steps of the l key, the ones past the field are left out
+global_variable int bench_lights[BENCH_COUNTS] = {0, 64, 128, 256,
+                                                  LightFieldSize};
+
+struct bench_s {
+  bool on;
+  int frame;
+  Uint64 start;
+  int counts_size;
+  // wall time per frame and GPU time of the frame graph, per path and count
+  float ms[BENCH_PATHS][BENCH_COUNTS];
+  float gpu_ms[BENCH_PATHS][BENCH_COUNTS];
+};
+
+global_variable bench_s g_bench = {};
+
+// benchStep sets up the next frame of the benchmark in snapshot frame, false
+// when it is done.
+internal bool benchStep(Scene *scn, int frame) {
+  bench_s *b = &g_bench;
+  if (b->frame == 0) {
+    b->counts_size = 0;
+    for (int i = 0; i < BENCH_COUNTS; i++) {
+      if (bench_lights[i] <= LightFieldSize &&
+          (i == 0 || bench_lights[i] != bench_lights[i - 1])) {
+        bench_lights[b->counts_size++] = bench_lights[i];
+      }
+    }
+  }
+
+  int run = b->frame / (BENCH_WARMUP + BENCH_FRAMES);
+  int at = b->frame % (BENCH_WARMUP + BENCH_FRAMES);
+  Uint64 now = SDL_GetPerformanceCounter();
+  if (at == 0 && run > 0) {
+    int last = run - 1;
+    int path = last / b->counts_size;
+    int count = last % b->counts_size;
+    b->ms[path][count] = (now - b->start) * 1000.0f /
+                         SDL_GetPerformanceFrequency() / BENCH_FRAMES;
+    // averaged over the last frames, the render thread is done with it
+    b->gpu_ms[path][count] = scn->frames[frame].draw_ms;
+  }
+  if (at == BENCH_WARMUP) {
+    b->start = now;
+  }
+  if (run == BENCH_PATHS * b->counts_size) {
+    for (int i = 0; i < b->counts_size; i++) {
+      printf("bench %d lights: forward %.3fms %.3fms GPU, deferred %.3fms "
+             "%.3fms GPU\n",
+             bench_lights[i], b->ms[BENCH_FORWARD][i],
+             b->gpu_ms[BENCH_FORWARD][i], b->ms[BENCH_DEFERRED][i],
+             b->gpu_ms[BENCH_DEFERRED][i]);
+      printf("bench %d lights: serial %.3fms, %.1f%% more frames threaded\n",
+             bench_lights[i], b->ms[BENCH_SERIAL][i],
+             (b->ms[BENCH_SERIAL][i] / b->ms[BENCH_FORWARD][i] - 1.0f) *
+                 100.0f);
+    }
+    return false;
+  }
+
+  int path = run / b->counts_size;
+  scn->enable_maze = true;
+  scn->deferred = path == BENCH_DEFERRED;
+  scn->threaded = path != BENCH_SERIAL;
+  scn->light_field_size = bench_lights[run % b->counts_size];
+  b->frame++;
+  return true;
+}
 
 internal bool init() {
   if (SDL_Init(SDL_INIT_VIDEO) < 0) {
@@ -25,9 +110,14 @@ internal bool init() {
     return false;
   }
 
-  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+  // 4.5 brings compute and direct state access into core, everything still
+  // runs on 3.3 when that is all there is
+  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 5);
   SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+  // light volumes of the deferred path count in the stencil
+  SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+  SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
 
   g_window = SDL_CreateWindow("Danketsu", 0, 20, g_screenWidth, g_screenHeight,
                               SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN);
@@ -38,6 +128,12 @@ internal bool init() {
   }
 
   g_ctx = SDL_GL_CreateContext(g_window);
+  if (g_ctx == NULL) {
+    printf("sdl gl 4.5 context failed, trying 3.3: %s\n", SDL_GetError());
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+    g_ctx = SDL_GL_CreateContext(g_window);
+  }
   if (g_ctx == NULL) {
     printf("sdl gl create context failed: %s\n", SDL_GetError());
     return false;
@@ -55,7 +151,9 @@ internal bool init() {
     return false;
   }
 
-  glEnable(GL_DEPTH_TEST);
+  glcaps_init();
+  glstate_invalidate();
+  frame_pacer_init(2);
 
   if (!app_init(&g_app)) {
     printf("cubes init failed\n");
@@ -71,27 +169,35 @@ internal bool init() {
   return true;
 }
 
+// renderFrame draws snapshot frame of the scene, on the render thread.
+internal void renderFrame(void *data, int frame) {
+  // at most a frame or two are in flight, waiting here instead of wherever
+  // the driver's queue would fill up
+  frame_pacer_begin();
+  glstate_frame_begin();
+
+  gpu_clear(0.1f, 0.1f, 0.1f, 1.0f);
+  app_render_frame((Scene *)data, frame);
+
+  // with vsync off a swap only blocks when the driver throttles
+  Uint64 swap_start = frame_pacer_stall_begin();
+  SDL_GL_SwapWindow(g_window);
+  frame_pacer_stall_end(swap_start, "swap");
+  frame_pacer_end();
+}
+
 internal void clean(Scene *scn) {
   AppClean(scn);
+  frame_pacer_clean();
   SDL_GL_DeleteContext(g_ctx);
   SDL_DestroyWindow(g_window);
   SDL_Quit();
 }
 
-#define TICK_INTERVAL 2
-static Uint32 nextTime;
-
-Uint32 timeLeft() {
-  Uint32 now;
-  now = SDL_GetTicks();
-  if (nextTime <= now) {
-    return 0;
-  } else {
-    return nextTime - now;
-  }
-}
-
 int main(int argc, char *argv[]) {
+  for (int i = 1; i < argc; i++) {
+    g_bench.on = g_bench.on || strcmp(argv[i], "--bench") == 0;
+  }
 
   bool ok = init();
   if (!ok) {
@@ -100,6 +206,13 @@ int main(int argc, char *argv[]) {
     return 0;
   }
 
+  // GL calls from here on are made on the render thread
+  if (!render_thread_start(&g_render_thread, g_window, g_ctx, renderFrame,
+                           &g_app)) {
+    clean(&g_app);
+    return 0;
+  }
+
   int input_move_forward = 0;
   int input_move_right = 0;
   int input_move_left = 0;
@@ -108,6 +221,11 @@ int main(int argc, char *argv[]) {
   SDL_Event e;
   bool windowShouldClose = false;
   while (!windowShouldClose) {
+    // the snapshot is free once the render thread drew it, two frames back.
+    // Input is read after the wait so the frame shows it as late as
+    // possible.
+    int frame = render_thread_acquire(&g_render_thread);
+
     while (SDL_PollEvent(&e) != 0) {
       switch (e.type) {
       case SDL_QUIT:
@@ -128,18 +246,17 @@ int main(int argc, char *argv[]) {
     float delta = timeValue - prevTime;
     prevTime = timeValue;
 
-    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    app_update(&g_app, delta);
-
-    SDL_GL_SwapWindow(g_window);
+    if (g_bench.on && !benchStep(&g_app, frame)) {
+      windowShouldClose = true;
+    }
+    app_update_frame(&g_app, delta, frame);
 
-    nextTime = SDL_GetTicks() + TICK_INTERVAL;
-    SDL_Delay(timeLeft());
-    nextTime += TICK_INTERVAL;
+    // t draws on the render thread while the next frame updates, or waits
+    // for it to compare
+    render_thread_submit(&g_render_thread, frame, !g_app.threaded);
   }
 
+  render_thread_stop(&g_render_thread);
   clean(&g_app);
 
   return 0;
@@ -1,4 +1,21 @@
+#include "cluster_test.cpp"
+#include "cmd_list_test.cpp"
+#include "frame_graph_test.cpp"
+#include "frustum_test.cpp"
+#include "occlusion_test.cpp"
+#include "pvs_test.cpp"
+#include "range_alloc_test.cpp"
 #include "raycast_test.cpp"
+#include "render_queue_test.cpp"
+#include "resolution_test.cpp"
+#include "static_batch_test.cpp"
+#include "stream_test.cpp"
+#include "transform_test.cpp"
+
+// headers under test call into the GL backend, the tests themselves never
+// reach it without a context
+#include "renderer_gl.cpp"
+#include "stream.cpp"
 
 int main(int argc, char *argv[]) {
   bool failed = testIntersectRayTriangle();
@@ -7,5 +24,77 @@ int main(int argc, char *argv[]) {
     return 0;
   }
 
+  failed = testXformBatch();
+  if (failed) {
+    printf("test xform batch failed\n");
+    return 0;
+  }
+
+  failed = testRenderQueueSort();
+  if (failed) {
+    printf("test render queue sort failed\n");
+    return 0;
+  }
+
+  failed = testRangeAlloc();
+  if (failed) {
+    printf("test range alloc failed\n");
+    return 0;
+  }
+
+  failed = testFrustumCull();
+  if (failed) {
+    printf("test frustum cull failed\n");
+    return 0;
+  }
+
+  failed = testOcclusion();
+  if (failed) {
+    printf("test occlusion failed\n");
+    return 0;
+  }
+
+  failed = testPvs();
+  if (failed) {
+    printf("test pvs failed\n");
+    return 0;
+  }
+
+  failed = testClusters();
+  if (failed) {
+    printf("test clusters failed\n");
+    return 0;
+  }
+
+  failed = testFrameGraph();
+  if (failed) {
+    printf("test frame graph failed\n");
+    return 0;
+  }
+
+  failed = testResolution();
+  if (failed) {
+    printf("test resolution failed\n");
+    return 0;
+  }
+
+  failed = testStream();
+  if (failed) {
+    printf("test stream failed\n");
+    return 0;
+  }
+
+  failed = testCmdList();
+  if (failed) {
+    printf("test cmd list failed\n");
+    return 0;
+  }
+
+  failed = testStaticBatch();
+  if (failed) {
+    printf("test static batch failed\n");
+    return 0;
+  }
+
   return 0;
 }
\ No newline at end of file
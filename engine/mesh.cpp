@@ -13,9 +13,8 @@ void MeshZero(mesh_s *m) {
   m->textures_size = 0;
   m->textures_cap = 0;
 
-  m->vao = 0;
-  m->vbo = 0;
-  m->ebo = 0;
+  m->geometry = 0;
+  m->bounds = {};
 }
 
 void MeshCheckClean(mesh_s *m) {
@@ -28,22 +27,11 @@ void MeshCheckClean(mesh_s *m) {
   assert(m->textures == NULL);
   assert(m->textures_size == 0);
   assert(m->textures_cap == 0);
-  assert(m->vao == 0);
-  assert(m->vbo == 0);
-  assert(m->ebo == 0);
+  assert(m->geometry == 0);
 }
 
 bool MeshClean(mesh_s *m) {
-  glDeleteVertexArrays(1, &m->vao);
-  m->vao = 0;
-
-  glDeleteBuffers(1, &m->vbo);
-  m->vbo = 0;
-
-  if (m->ebo != 0) {
-    glDeleteBuffers(1, &m->ebo);
-    m->ebo = 0;
-  }
+  geometry_free(&g_mesh_geometry, &m->geometry);
 
   alloc_free(m->verts);
   m->verts = NULL;
@@ -64,48 +52,72 @@ bool MeshClean(mesh_s *m) {
 }
 
 bool MeshInitialize(mesh_s *m) {
-  glGenVertexArrays(1, &m->vao);
-  glGenBuffers(1, &m->vbo);
-  // glGenBuffers(1, &m->ebo);
-
-  glBindVertexArray(m->vao);
-  glBindBuffer(GL_ARRAY_BUFFER, m->vbo);
+  assert(m->verts_size > 0);
+  m->bounds = bounds_compute(&m->verts[0].pos, sizeof(vertex_s), m->verts_size);
 
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_s) * m->verts_size, m->verts,
-               GL_STATIC_DRAW);
+  if (g_mesh_geometry.input.id == 0) {
+    geometry_arena_init<vertex_s>(&g_mesh_geometry, MESH_GEOMETRY_VERTICES,
+                                  MESH_GEOMETRY_INDICES);
+  }
 
   if (m->indices_size > 0) {
-    glGenBuffers(1, &m->ebo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m->ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * m->indices_size,
-                 m->indices, GL_STATIC_DRAW);
+    m->geometry = geometry_alloc(&g_mesh_geometry, m->verts, m->verts_size,
+                                 m->indices, m->indices_size);
+    return m->geometry != 0;
   }
 
-  // position attribute
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertex_s), (void *)0);
+  // meshes without indices get trivial ones, multi draws need them
+  uint32_t *indices = (uint32_t *)alloc_make(m->verts_size * sizeof(uint32_t));
+  for (int i = 0; i < m->verts_size; i++) {
+    indices[i] = i;
+  }
+  m->geometry = geometry_alloc(&g_mesh_geometry, m->verts, m->verts_size,
+                               indices, m->verts_size);
+  alloc_free(indices);
+  return m->geometry != 0;
+}
 
-  // normal attribute
-  glEnableVertexAttribArray(1);
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(vertex_s),
-                        (void *)offsetof(vertex_s, normal));
+// MeshDrawSetup fills draw with where the mesh is in the geometry arena.
+internal void MeshDrawSetup(mesh_s *m, gpu_draw_s *draw) {
+  geometry_block_s *b = geometry_block(&g_mesh_geometry, m->geometry);
+  draw->input = g_mesh_geometry.input;
+  draw->indexed = b->index_count > 0;
+  if (draw->indexed) {
+    draw->first = b->index_offset;
+    draw->count = b->index_count;
+    draw->base_vertex = b->vertex_offset;
+  } else {
+    draw->first = b->vertex_offset;
+    draw->count = b->vertex_count;
+  }
+}
 
-  // texcoord attribute
-  glEnableVertexAttribArray(2);
-  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(vertex_s),
-                        (void *)offsetof(vertex_s, texcoord));
+internal void MeshBindTextures(mesh_s *m, const shader_s *sh) {
+  int diffuse_nr = 1;
+  int specular_nr = 1;
 
-  glBindVertexArray(0);
-  return true;
+  for (int i = 0; i < m->textures_size; i++) {
+    int slot = 0;
+    if (strcmp(m->textures[i].type, "material.diffuse") == 0) {
+      slot = diffuse_nr++;
+    } else if (strcmp(m->textures[i].type, "material.specular") == 0) {
+      slot = specular_nr++;
+    }
+
+    char name[50];
+    sprintf(name, "%s%d", m->textures[i].type, slot);
+    shader_1i(sh, name, i);
+    gpu_texture_bind(m->textures[i].tex, i);
+  }
 }
 
-void MeshDraw(mesh_s *m, shader_s *sh) {
+// MeshRecordTextures is MeshBindTextures recorded into cl.
+internal void MeshRecordTextures(cmd_list_s *cl, mesh_s *m,
+                               const shader_s *sh) {
   int diffuse_nr = 1;
   int specular_nr = 1;
 
   for (int i = 0; i < m->textures_size; i++) {
-    glActiveTexture(GL_TEXTURE0 + i);
-
     int slot = 0;
     if (strcmp(m->textures[i].type, "material.diffuse") == 0) {
       slot = diffuse_nr++;
@@ -115,27 +127,155 @@ void MeshDraw(mesh_s *m, shader_s *sh) {
 
     char name[50];
     sprintf(name, "%s%d", m->textures[i].type, slot);
-    shader_1i(sh, name, i);
-    glBindTexture(GL_TEXTURE_2D, m->textures[i].id);
+    cmd_uniform_1i(cl, sh, name, i);
+    cmd_texture(cl, m->textures[i].tex, i);
   }
+}
+
+void MeshDraw(mesh_s *m, const shader_s *sh) {
+  MeshBindTextures(m, sh);
 
-  glBindVertexArray(m->vao);
   // printf("MeshDraw: indices_size: %d\n", m->indices_size);
   // printf("MeshDraw: verts_size: %d\n", m->verts_size);
   assert(m->verts_size != 0);
-  if (m->indices_size > 0) {
-    glDrawElements(GL_TRIANGLES, m->indices_size, GL_UNSIGNED_INT, 0);
+
+  gpu_draw_s draw = {};
+  MeshDrawSetup(m, &draw);
+  gpu_draw(&draw);
+}
+
+// MeshDrawInstanced draws count instances of the mesh, taken from the
+// uploaded instance buffer starting at first.
+void MeshDrawInstanced(mesh_s *m, const shader_s *sh, instance_buffer_s *ib,
+                       int first, int count) {
+  MeshBindTextures(m, sh);
+  assert(m->verts_size != 0);
+  assert(first + count <= ib->size);
+
+  gpu_input_stream<instance_s>(g_mesh_geometry.input, 1, ib->src,
+                               ib->base + first * sizeof(instance_s), true);
+
+  gpu_draw_s draw = {};
+  MeshDrawSetup(m, &draw);
+  draw.instances = count;
+  gpu_draw(&draw);
+}
+
+// MeshIndirectCommand makes the multi draw command drawing count instances of
+// the mesh from the instance buffer, starting at first.
+gpu_draw_indirect_s MeshIndirectCommand(mesh_s *m, int first, int count) {
+  geometry_block_s *b = geometry_block(&g_mesh_geometry, m->geometry);
+  assert(b->index_count > 0);
+
+  gpu_draw_indirect_s cmd = {};
+  cmd.count = b->index_count;
+  cmd.instance_count = count;
+  cmd.first_index = b->index_offset;
+  cmd.base_vertex = b->vertex_offset;
+  cmd.base_instance = first;
+  return cmd;
+}
+
+// MeshSubmitMulti draws count commands of the uploaded indirect buffer
+// starting at first through in. With multi set and supported it is one
+// glMultiDrawElementsIndirect, otherwise a loop moving the instance stream to
+// every command's base instance, which GL 3.3 can't do on its own.
+void MeshSubmitMulti(gpu_input_s in, instance_buffer_s *ib,
+                     indirect_buffer_s *ind, int first, int count, bool multi) {
+  assert(first + count <= ind->size);
+
+  if (multi && gpu_has_multi_draw()) {
+    gpu_input_stream<instance_s>(in, 1, ib->src, ib->base, true);
+    gpu_draw_multi(in, ind->buf, first, count);
+    return;
+  }
+
+  for (int i = first; i < first + count; i++) {
+    gpu_draw_indirect_s *cmd = &ind->data[i];
+    gpu_input_stream<instance_s>(
+        in, 1, ib->src, ib->base + cmd->base_instance * sizeof(instance_s),
+        true);
+
+    gpu_draw_s draw = {};
+    draw.input = in;
+    draw.indexed = true;
+    draw.first = cmd->first_index;
+    draw.count = cmd->count;
+    draw.base_vertex = cmd->base_vertex;
+    draw.instances = cmd->instance_count;
+    gpu_draw(&draw);
+  }
+}
+
+// MeshSubmitMultiCount draws commands written on the GPU through in, the
+// number of them is the uint at count_at of counts. Without the count variant
+// of multi draw all max_count commands are submitted, the unused ones must
+// have no instances.
+void MeshSubmitMultiCount(gpu_input_s in, gpu_buffer_s instances,
+                          gpu_buffer_s commands, int first, gpu_buffer_s counts,
+                          int count_at, int max_count) {
+  gpu_input_stream<instance_s>(in, 1, instances, 0, true);
+
+  if (gpu_has_multi_draw_count()) {
+    gpu_draw_multi_count(in, commands, first, counts, count_at, max_count);
   } else {
-    glDrawArrays(GL_TRIANGLES, 0, m->verts_size);
+    gpu_draw_multi(in, commands, first, max_count);
   }
-  glBindVertexArray(0);
+}
+
+// MeshDrawMulti draws count commands of the uploaded indirect buffer starting
+// at first, with textures of m.
+void MeshDrawMulti(mesh_s *m, const shader_s *sh, instance_buffer_s *ib,
+                   indirect_buffer_s *ind, int first, int count, bool multi) {
+  MeshBindTextures(m, sh);
+  MeshSubmitMulti(g_mesh_geometry.input, ib, ind, first, count, multi);
+}
+
+// MeshDrawMultiCount draws commands written on the GPU, with textures of m.
+void MeshDrawMultiCount(mesh_s *m, const shader_s *sh, gpu_buffer_s instances,
+                        gpu_buffer_s commands, int first, gpu_buffer_s counts,
+                        int count_at, int max_count) {
+  MeshBindTextures(m, sh);
+  MeshSubmitMultiCount(g_mesh_geometry.input, instances, commands, first,
+                       counts, count_at, max_count);
+}
+
+void MeshRecordMulti(cmd_list_s *cl, mesh_s *m, const shader_s *sh,
+                     instance_buffer_s *ib, indirect_buffer_s *ind, int first,
+                     int count, bool multi) {
+  assert(first + count <= ind->size);
+  MeshRecordTextures(cl, m, sh);
+  cmd_multi(cl, g_mesh_geometry.input, ib, ind, first, count, multi);
+}
+
+void MeshRecordMultiCount(cmd_list_s *cl, mesh_s *m, const shader_s *sh,
+                          gpu_buffer_s instances, gpu_buffer_s commands,
+                          int first, gpu_buffer_s counts, int count_at,
+                          int max_count) {
+  MeshRecordTextures(cl, m, sh);
+  cmd_multi_count(cl, g_mesh_geometry.input, instances, commands, first,
+                  counts, count_at, max_count);
+}
+
+// MeshDrawDepthMulti draws the same commands as MeshDrawMulti from the
+// position stream only, with no textures. Commands of any meshes of the arena
+// go in one call, the depth pass doesn't care about materials.
+void MeshDrawDepthMulti(instance_buffer_s *ib, indirect_buffer_s *ind,
+                        int first, int count, bool multi) {
+  MeshSubmitMulti(g_mesh_geometry.position_input, ib, ind, first, count,
+                  multi);
+}
 
-  glActiveTexture(GL_TEXTURE0);
+void MeshDrawDepthMultiCount(gpu_buffer_s instances, gpu_buffer_s commands,
+                             int first, gpu_buffer_s counts, int count_at,
+                             int max_count) {
+  MeshSubmitMultiCount(g_mesh_geometry.position_input, instances, commands,
+                       first, counts, count_at, max_count);
 }
 
 bool mesh_add_texture(mesh_s *m, const char *path, const char *type) {
   texture_s tex;
-  bool ok = tex_load(&tex.id, path);
+  bool ok = tex_load(&tex.tex, path);
   if (!ok) {
     printf("mesh_add_texture: failed to load texture %s", path);
     return false;
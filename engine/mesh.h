@@ -2,9 +2,16 @@
 #define MESH_H
 
 #include "alloc.h"
+#include "cmd_list.h"
+#include "frustum.h"
+#include "geometry.h"
+#include "indirect.h"
+#include "instance.h"
 #include "log.h"
+#include "renderer.h"
 #include "shader.h"
 #include "texture.h"
+#include "vertex_format.h"
 
 #include "unity.h"
 
@@ -14,8 +21,16 @@ struct vertex_s {
   vec2 texcoord;
 };
 
+template <> struct vertex_format<vertex_s> {
+  static constexpr vertex_attrib_s attribs[] = {
+      VERTEX_ATTRIB(0, vertex_s, pos),
+      VERTEX_ATTRIB(1, vertex_s, normal),
+      VERTEX_ATTRIB(2, vertex_s, texcoord),
+  };
+};
+
 struct texture_s {
-  GLuint id;
+  gpu_texture_s tex;
   const char *type;
   // const char* path;
 };
@@ -34,15 +49,52 @@ struct mesh_s {
   int textures_size;
   int textures_cap;
 
-  GLuint vao;
-  GLuint vbo;
-  GLuint ebo;
+  // block of g_mesh_geometry, 0 until MeshInitialize
+  int geometry;
+
+  // box and sphere in mesh space, made by MeshInitialize
+  bounds_s bounds;
 };
 
+// All meshes share one geometry arena, created by the first MeshInitialize.
+#define MESH_GEOMETRY_VERTICES (1 << 18)
+#define MESH_GEOMETRY_INDICES (1 << 20)
+
+global_variable geometry_arena_s g_mesh_geometry;
+
 void MeshZero(mesh_s *m);
 bool mesh_read_obj(mesh_s *m, const char *filename);
 bool MeshInitialize(mesh_s *m);
 bool MeshClean(mesh_s *m);
-void MeshDraw(mesh_s *m, shader_s *sh);
+void MeshDraw(mesh_s *m, const shader_s *sh);
+void MeshDrawInstanced(mesh_s *m, const shader_s *sh, instance_buffer_s *ib,
+                       int first, int count);
+gpu_draw_indirect_s MeshIndirectCommand(mesh_s *m, int first, int count);
+void MeshDrawMulti(mesh_s *m, const shader_s *sh, instance_buffer_s *ib,
+                   indirect_buffer_s *ind, int first, int count, bool multi);
+void MeshDrawMultiCount(mesh_s *m, const shader_s *sh, gpu_buffer_s instances,
+                        gpu_buffer_s commands, int first, gpu_buffer_s counts,
+                        int count_at, int max_count);
+// MeshRecordMulti and MeshRecordMultiCount record what the draws above do
+// into cl, cmd_list_replay submits them.
+void MeshRecordMulti(cmd_list_s *cl, mesh_s *m, const shader_s *sh,
+                     instance_buffer_s *ib, indirect_buffer_s *ind, int first,
+                     int count, bool multi);
+void MeshRecordMultiCount(cmd_list_s *cl, mesh_s *m, const shader_s *sh,
+                          gpu_buffer_s instances, gpu_buffer_s commands,
+                          int first, gpu_buffer_s counts, int count_at,
+                          int max_count);
+// MeshSubmitMulti and MeshSubmitMultiCount submit the draws through in
+// without binding textures, cmd_list_replay uses them too.
+void MeshSubmitMulti(gpu_input_s in, instance_buffer_s *ib,
+                     indirect_buffer_s *ind, int first, int count, bool multi);
+void MeshSubmitMultiCount(gpu_input_s in, gpu_buffer_s instances,
+                          gpu_buffer_s commands, int first, gpu_buffer_s counts,
+                          int count_at, int max_count);
+void MeshDrawDepthMulti(instance_buffer_s *ib, indirect_buffer_s *ind,
+                        int first, int count, bool multi);
+void MeshDrawDepthMultiCount(gpu_buffer_s instances, gpu_buffer_s commands,
+                             int first, gpu_buffer_s counts, int count_at,
+                             int max_count);
 
 #endif
\ No newline at end of file
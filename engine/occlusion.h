@@ -0,0 +1,362 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include "unity.h"
+
+#include "alloc.h"
+#include "frustum.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define OCCLUSION_SSE 1
+#endif
+
+// Software occlusion culling. A few large objects (occluders) are drawn as
+// boxes into a small depth buffer on the CPU, the buffer is reduced to a
+// pyramid of nearest and farthest depth per texel, and the boxes of other
+// objects are tested against it before they are submitted.
+//
+// Occluder boxes must fit inside what they stand for, or objects behind
+// their corners would be lost. Depth is window depth, 0 near and 1 far.
+//
+// The buffer is split in bands of rows that are rasterized independently,
+// one job per band, see occlusion_raster_job.
+
+#define OCCLUSION_WIDTH 256
+#define OCCLUSION_HEIGHT 128
+#define OCCLUSION_BANDS 8
+// 256x128 down to 1x1
+#define OCCLUSION_LEVELS 9
+// boxes closer to the eye than this in clip w are not drawn (occluders) or
+// taken as visible (tested objects), they would need near plane clipping
+#define OCCLUSION_NEAR 0.01f
+
+struct occlusion_tri_s {
+  // window x, y and depth
+  vec3 v[3];
+};
+
+struct occlusion_s {
+  mat4 view_proj;
+
+  occlusion_tri_s *tris;
+  int tris_size;
+  int tris_cap;
+
+  // level 0 is the rasterized depth, lo and hi of every next level are the
+  // nearest and farthest depth of four texels of the previous one
+  float *lo[OCCLUSION_LEVELS];
+  float *hi[OCCLUSION_LEVELS];
+  int width[OCCLUSION_LEVELS];
+  int height[OCCLUSION_LEVELS];
+
+  int tested;
+  int occluded;
+};
+
+void occlusion_init(occlusion_s *oc, int max_occluders) {
+  oc->tris_cap = max_occluders * 12;
+  oc->tris =
+      (occlusion_tri_s *)alloc_make(oc->tris_cap * sizeof(occlusion_tri_s));
+  oc->tris_size = 0;
+
+  int w = OCCLUSION_WIDTH;
+  int h = OCCLUSION_HEIGHT;
+  for (int l = 0; l < OCCLUSION_LEVELS; l++) {
+    oc->width[l] = w;
+    oc->height[l] = h;
+    oc->lo[l] = (float *)alloc_make(w * h * sizeof(float));
+    oc->hi[l] = l == 0 ? oc->lo[0] : (float *)alloc_make(w * h * sizeof(float));
+    w = w > 1 ? w / 2 : 1;
+    h = h > 1 ? h / 2 : 1;
+  }
+  oc->tested = 0;
+  oc->occluded = 0;
+}
+
+void occlusion_clean(occlusion_s *oc) {
+  oc->tris = (occlusion_tri_s *)alloc_free(oc->tris);
+  oc->tris_size = 0;
+  oc->tris_cap = 0;
+  for (int l = 0; l < OCCLUSION_LEVELS; l++) {
+    if (l > 0) {
+      alloc_free(oc->hi[l]);
+    }
+    oc->lo[l] = (float *)alloc_free(oc->lo[l]);
+    oc->hi[l] = NULL;
+  }
+}
+
+// occlusion_begin starts a frame seen through view_proj.
+void occlusion_begin(occlusion_s *oc, const mat4 &view_proj) {
+  oc->view_proj = view_proj;
+  oc->tris_size = 0;
+  oc->tested = 0;
+  oc->occluded = 0;
+}
+
+// occlusion_project_box puts the corners of the box placed by model in window
+// space. Returns false when one of them is too close to the eye.
+internal bool occlusion_project_box(const occlusion_s *oc, const bounds_s *b,
+                                    const mat4 &model, vec3 out[8]) {
+  mat4 m = oc->view_proj * model;
+  for (int i = 0; i < 8; i++) {
+    vec4 p = vec4(i & 1 ? b->max.x : b->min.x, i & 2 ? b->max.y : b->min.y,
+                  i & 4 ? b->max.z : b->min.z, 1.0f);
+    vec4 clip = m * p;
+    if (clip.w < OCCLUSION_NEAR) {
+      return false;
+    }
+    vec3 ndc = vec3(clip) / clip.w;
+    out[i] = vec3((ndc.x * 0.5f + 0.5f) * OCCLUSION_WIDTH,
+                  (ndc.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT,
+                  ndc.z * 0.5f + 0.5f);
+  }
+  return true;
+}
+
+// occlusion_add_box adds the box of b placed by model as an occluder. Called
+// before the raster jobs start.
+void occlusion_add_box(occlusion_s *oc, const bounds_s *b, const mat4 &model) {
+  // corners are indexed by their max bits, x 1, y 2, z 4
+  local_persist const int faces[6][4] = {
+      {0, 2, 6, 4}, {1, 3, 7, 5}, {0, 1, 5, 4},
+      {2, 3, 7, 6}, {0, 1, 3, 2}, {4, 5, 7, 6},
+  };
+
+  vec3 v[8];
+  if (!occlusion_project_box(oc, b, model, v)) {
+    return;
+  }
+  assert(oc->tris_size + 12 <= oc->tris_cap);
+  for (int f = 0; f < 6; f++) {
+    const int *q = faces[f];
+    oc->tris[oc->tris_size++] = {{v[q[0]], v[q[1]], v[q[2]]}};
+    oc->tris[oc->tris_size++] = {{v[q[0]], v[q[2]], v[q[3]]}};
+  }
+}
+
+// occlusion_raster_tri draws a triangle into rows [y0, y1) of level 0,
+// keeping the nearer depth. Pixels are covered when their center is inside.
+internal void occlusion_raster_tri(occlusion_s *oc, const occlusion_tri_s *t,
+                                   int y0, int y1) {
+  vec3 a = t->v[0];
+  vec3 b = t->v[1];
+  vec3 c = t->v[2];
+  float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+  // both windings are drawn, depth test keeps the front faces
+  if (area < 0.0f) {
+    vec3 tmp = b;
+    b = c;
+    c = tmp;
+    area = -area;
+  }
+  if (area < 1e-6f) {
+    return;
+  }
+
+  int min_x = (int)floorf(fmin(a.x, fmin(b.x, c.x)));
+  int max_x = (int)ceilf(fmax(a.x, fmax(b.x, c.x)));
+  int min_y = (int)floorf(fmin(a.y, fmin(b.y, c.y)));
+  int max_y = (int)ceilf(fmax(a.y, fmax(b.y, c.y)));
+  min_x = min_x < 0 ? 0 : min_x;
+  max_x = max_x > OCCLUSION_WIDTH - 1 ? OCCLUSION_WIDTH - 1 : max_x;
+  min_y = min_y < y0 ? y0 : min_y;
+  max_y = max_y > y1 - 1 ? y1 - 1 : max_y;
+  if (min_x > max_x || min_y > max_y) {
+    return;
+  }
+
+  // edge functions e = ex * x + ey * y + e0, positive inside, one per edge
+  // opposite to a, b and c
+  float ex[3] = {b.y - c.y, c.y - a.y, a.y - b.y};
+  float ey[3] = {c.x - b.x, a.x - c.x, b.x - a.x};
+  float e0[3] = {b.x * c.y - b.y * c.x, c.x * a.y - c.y * a.x,
+                 a.x * b.y - a.y * b.x};
+  // depth is the barycentric blend of the corners, a plane in window space
+  float zx = (ex[0] * a.z + ex[1] * b.z + ex[2] * c.z) / area;
+  float zy = (ey[0] * a.z + ey[1] * b.z + ey[2] * c.z) / area;
+  float z0 = (e0[0] * a.z + e0[1] * b.z + e0[2] * c.z) / area;
+
+  float *depth = oc->lo[0];
+  int x_start = min_x & ~3;
+
+#ifdef OCCLUSION_SSE
+  __m128 px0 = _mm_add_ps(_mm_set1_ps((float)x_start),
+                          _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+  __m128 step = _mm_set1_ps(4.0f);
+  __m128 zero = _mm_setzero_ps();
+  __m128 vex[3];
+  for (int e = 0; e < 3; e++) {
+    vex[e] = _mm_set1_ps(ex[e]);
+  }
+  __m128 vzx = _mm_set1_ps(zx);
+
+  for (int y = min_y; y <= max_y; y++) {
+    float py = y + 0.5f;
+    __m128 row[3];
+    for (int e = 0; e < 3; e++) {
+      row[e] = _mm_set1_ps(ey[e] * py + e0[e]);
+    }
+    __m128 row_z = _mm_set1_ps(zy * py + z0);
+
+    float *dst = depth + y * OCCLUSION_WIDTH;
+    __m128 px = px0;
+    for (int x = x_start; x <= max_x; x += 4, px = _mm_add_ps(px, step)) {
+      __m128 in = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(vex[0], px), row[0]), zero);
+      in = _mm_and_ps(
+          in, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(vex[1], px), row[1]), zero));
+      in = _mm_and_ps(
+          in, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(vex[2], px), row[2]), zero));
+      if (_mm_movemask_ps(in) == 0) {
+        continue;
+      }
+
+      __m128 z = _mm_add_ps(_mm_mul_ps(vzx, px), row_z);
+      __m128 old = _mm_loadu_ps(dst + x);
+      __m128 nearer = _mm_min_ps(old, z);
+      _mm_storeu_ps(dst + x,
+                    _mm_or_ps(_mm_and_ps(in, nearer), _mm_andnot_ps(in, old)));
+    }
+  }
+#else
+  for (int y = min_y; y <= max_y; y++) {
+    float py = y + 0.5f;
+    float *dst = depth + y * OCCLUSION_WIDTH;
+    for (int x = x_start; x <= max_x; x++) {
+      float px = x + 0.5f;
+      if (ex[0] * px + ey[0] * py + e0[0] < 0.0f ||
+          ex[1] * px + ey[1] * py + e0[1] < 0.0f ||
+          ex[2] * px + ey[2] * py + e0[2] < 0.0f) {
+        continue;
+      }
+      dst[x] = fmin(dst[x], zx * px + zy * py + z0);
+    }
+  }
+#endif
+}
+
+// occlusion_raster_band clears a band of level 0 and draws all occluders
+// into it. Bands share no pixels, they can be drawn at the same time.
+void occlusion_raster_band(occlusion_s *oc, int band) {
+  const int rows = OCCLUSION_HEIGHT / OCCLUSION_BANDS;
+  int y0 = band * rows;
+  int y1 = y0 + rows;
+
+  float *depth = oc->lo[0];
+  for (int i = y0 * OCCLUSION_WIDTH; i < y1 * OCCLUSION_WIDTH; i++) {
+    depth[i] = 1.0f;
+  }
+  for (int t = 0; t < oc->tris_size; t++) {
+    occlusion_raster_tri(oc, &oc->tris[t], y0, y1);
+  }
+}
+
+// occlusion_raster_job is occlusion_raster_band as a job, one index a band.
+void occlusion_raster_job(void *data, int band) {
+  occlusion_raster_band((occlusion_s *)data, band);
+}
+
+// occlusion_build_pyramid reduces level 0 to the rest, after all bands are
+// drawn.
+void occlusion_build_pyramid(occlusion_s *oc) {
+  for (int l = 1; l < OCCLUSION_LEVELS; l++) {
+    int sw = oc->width[l - 1];
+    int w = oc->width[l];
+    int h = oc->height[l];
+    for (int y = 0; y < h; y++) {
+      // sources of odd sizes only happen when the other side ran out first
+      int y_b = oc->height[l - 1] > 1 ? 2 * y + 1 : 2 * y;
+      const float *lo_a = oc->lo[l - 1] + 2 * y * sw;
+      const float *lo_b = oc->lo[l - 1] + y_b * sw;
+      const float *hi_a = oc->hi[l - 1] + 2 * y * sw;
+      const float *hi_b = oc->hi[l - 1] + y_b * sw;
+      float *lo = oc->lo[l] + y * w;
+      float *hi = oc->hi[l] + y * w;
+
+      int x = 0;
+#ifdef OCCLUSION_SSE
+      for (; x + 4 <= w && sw >= 2 * w; x += 4) {
+        __m128 l0 = _mm_min_ps(_mm_loadu_ps(lo_a + 2 * x),
+                               _mm_loadu_ps(lo_b + 2 * x));
+        __m128 l1 = _mm_min_ps(_mm_loadu_ps(lo_a + 2 * x + 4),
+                               _mm_loadu_ps(lo_b + 2 * x + 4));
+        __m128 h0 = _mm_max_ps(_mm_loadu_ps(hi_a + 2 * x),
+                               _mm_loadu_ps(hi_b + 2 * x));
+        __m128 h1 = _mm_max_ps(_mm_loadu_ps(hi_a + 2 * x + 4),
+                               _mm_loadu_ps(hi_b + 2 * x + 4));
+        // even and odd columns side by side
+        _mm_storeu_ps(lo + x, _mm_min_ps(_mm_shuffle_ps(l0, l1, 0x88),
+                                         _mm_shuffle_ps(l0, l1, 0xDD)));
+        _mm_storeu_ps(hi + x, _mm_max_ps(_mm_shuffle_ps(h0, h1, 0x88),
+                                         _mm_shuffle_ps(h0, h1, 0xDD)));
+      }
+#endif
+      for (; x < w; x++) {
+        int x_b = sw > 1 ? 2 * x + 1 : 2 * x;
+        lo[x] = fmin(fmin(lo_a[2 * x], lo_a[x_b]), fmin(lo_b[2 * x], lo_b[x_b]));
+        hi[x] = fmax(fmax(hi_a[2 * x], hi_a[x_b]), fmax(hi_b[2 * x], hi_b[x_b]));
+      }
+    }
+  }
+}
+
+// occlusion_test_box tells whether the box of b placed by model may be seen.
+// It starts at the level where the box covers at most 2x2 texels and goes to
+// finer ones, where the farthest depth around it is tighter, while undecided.
+bool occlusion_test_box(occlusion_s *oc, const bounds_s *b, const mat4 &model) {
+  oc->tested++;
+  vec3 v[8];
+  if (!occlusion_project_box(oc, b, model, v)) {
+    return true;
+  }
+
+  vec3 lo = v[0];
+  vec3 hi = v[0];
+  for (int i = 1; i < 8; i++) {
+    lo = glm::min(lo, v[i]);
+    hi = glm::max(hi, v[i]);
+  }
+  int x0 = (int)fmax(lo.x, 0.0f);
+  int y0 = (int)fmax(lo.y, 0.0f);
+  int x1 = (int)fmin(hi.x, OCCLUSION_WIDTH - 1.0f);
+  int y1 = (int)fmin(hi.y, OCCLUSION_HEIGHT - 1.0f);
+  if (x0 > x1 || y0 > y1) {
+    return true;
+  }
+
+  int size = (x1 - x0 > y1 - y0 ? x1 - x0 : y1 - y0) + 1;
+  int level = 0;
+  while ((1 << level) < size && level < OCCLUSION_LEVELS - 1) {
+    level++;
+  }
+
+  for (int l = level; l >= 0; l--) {
+    int lx0 = x0 >> l, lx1 = x1 >> l;
+    int ly0 = y0 >> l, ly1 = y1 >> l;
+    // 8x8 texels is as far as refining pays off
+    if (l < level && (lx1 - lx0 >= 8 || ly1 - ly0 >= 8)) {
+      break;
+    }
+
+    float nearest = 1.0f;
+    float farthest = 0.0f;
+    for (int y = ly0; y <= ly1; y++) {
+      for (int x = lx0; x <= lx1; x++) {
+        nearest = fmin(nearest, oc->lo[l][y * oc->width[l] + x]);
+        farthest = fmax(farthest, oc->hi[l][y * oc->width[l] + x]);
+      }
+    }
+    // in front of every occluder around it
+    if (hi.z < nearest) {
+      return true;
+    }
+    if (lo.z > farthest) {
+      oc->occluded++;
+      return false;
+    }
+  }
+  return true;
+}
+
+#endif
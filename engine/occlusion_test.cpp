@@ -0,0 +1,70 @@
+#include "unity.h"
+
+#ifndef OCCLUSION_TEST_H
+#define OCCLUSION_TEST_H
+
+#include "occlusion.h"
+
+bool testOcclusion() {
+  occlusion_s oc = {};
+  occlusion_init(&oc, 1);
+
+  // camera at the origin looking down -z, a wall across the middle of the
+  // view from z -4.75 to -5.25
+  mat4 proj = glm::perspective(glm::radians(90.0f), 2.0f, 1.0f, 10.0f);
+  occlusion_begin(&oc, proj);
+  bounds_s unit = {vec3(-1), vec3(1), vec3(0), sqrtf(3.0f)};
+  mat4 wall = glm::scale(glm::translate(mat4(1.0f), vec3(0, 0, -5)),
+                         vec3(3, 3, 0.25f));
+  occlusion_add_box(&oc, &unit, wall);
+  for (int band = 0; band < OCCLUSION_BANDS; band++) {
+    occlusion_raster_band(&oc, band);
+  }
+  occlusion_build_pyramid(&oc);
+
+  vec4 clip = proj * vec4(0, 0, -4.75f, 1);
+  float front = clip.z / clip.w * 0.5f + 0.5f;
+  float center = oc.lo[0][OCCLUSION_HEIGHT / 2 * OCCLUSION_WIDTH +
+                          OCCLUSION_WIDTH / 2];
+  if (fabs(center - front) > 0.001f) {
+    printf("occlusion: depth at center %f, want %f\n", center, front);
+    return true;
+  }
+  int top = OCCLUSION_LEVELS - 1;
+  if (oc.width[top] != 1 || oc.height[top] != 1 ||
+      fabs(oc.lo[top][0] - front) > 0.001f || oc.hi[top][0] != 1.0f) {
+    printf("occlusion: top level %dx%d lo %f hi %f\n", oc.width[top],
+           oc.height[top], oc.lo[top][0], oc.hi[top][0]);
+    return true;
+  }
+
+  struct {
+    vec3 pos;
+    bool visible;
+  } boxes[] = {
+      {vec3(0, 0, -9), false},   // right behind the wall
+      {vec3(4.5, 0, -9), false}, // behind the wall near its edge
+      {vec3(9, 0, -9), true},    // beside the wall
+      {vec3(0, 0, -2), true},    // in front of the wall
+      {vec3(0, 0, 0.5), true},   // around the eye
+  };
+  for (int i = 0; i < (int)COUNT_OF(boxes); i++) {
+    mat4 model = glm::scale(glm::translate(mat4(1.0f), boxes[i].pos),
+                            vec3(0.25f));
+    bool visible = occlusion_test_box(&oc, &unit, model);
+    if (visible != boxes[i].visible) {
+      printf("occlusion: box %d visible %d, want %d\n", i, visible,
+             boxes[i].visible);
+      return true;
+    }
+  }
+  if (oc.tested != 5 || oc.occluded != 2) {
+    printf("occlusion: %d tested, %d occluded\n", oc.tested, oc.occluded);
+    return true;
+  }
+
+  occlusion_clean(&oc);
+  return false;
+}
+
+#endif
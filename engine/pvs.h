@@ -0,0 +1,342 @@
+#ifndef PVS_H
+#define PVS_H
+
+#include "unity.h"
+
+#include "alloc.h"
+#include "jobs.h"
+
+// Potentially visible sets of a static grid. Every cell may hold one
+// occluding box; pvs_build casts rays from sample points of every cell to
+// sample points of every other cell through the grid and records which cells
+// can be seen from which. Sets are kept run length compressed, at runtime the
+// set of the eye's cell is expanded once and each object is a bit lookup.
+//
+// Boxes are clipped to their cell, so a box sticking out into its neighbours
+// occludes less than it really does, never more. Sampling can still miss
+// narrow gaps, PVS_SAMPLES trades build time for that.
+
+// corners of the sample box pulled in by this part of its size, and its center
+#define PVS_SAMPLES 9
+#define PVS_SAMPLE_INSET 0.1f
+
+struct pvs_s {
+  int size_x;
+  int size_y;
+  int size_z;
+  int cells;
+  // min corner of cell (0, 0, 0) and size of a cell
+  vec3 origin;
+  vec3 cell;
+
+  // occluding box of every cell, clipped to it, and the box that stands for
+  // the cell as a target, the whole object in it. Empty when min > max.
+  vec3 *occluder_min;
+  vec3 *occluder_max;
+  vec3 *target_min;
+  vec3 *target_max;
+
+  // set of cell c starts at data[offsets[c]]. Zero bytes are followed by
+  // the number of zero bytes in the run.
+  int *offsets;
+  uint8_t *data;
+  int data_size;
+  int data_cap;
+  int row_bytes;
+
+  // expanded set of row_cell, -1 before pvs_select
+  uint8_t *row;
+  int row_cell;
+};
+
+void pvs_init(pvs_s *pvs, int size_x, int size_y, int size_z, vec3 origin,
+              vec3 cell) {
+  pvs->size_x = size_x;
+  pvs->size_y = size_y;
+  pvs->size_z = size_z;
+  pvs->cells = size_x * size_y * size_z;
+  pvs->origin = origin;
+  pvs->cell = cell;
+
+  size_t boxes = pvs->cells * sizeof(vec3);
+  pvs->occluder_min = (vec3 *)alloc_make(boxes);
+  pvs->occluder_max = (vec3 *)alloc_make(boxes);
+  pvs->target_min = (vec3 *)alloc_make(boxes);
+  pvs->target_max = (vec3 *)alloc_make(boxes);
+  for (int c = 0; c < pvs->cells; c++) {
+    pvs->occluder_min[c] = vec3(1.0f);
+    pvs->occluder_max[c] = vec3(-1.0f);
+  }
+
+  pvs->row_bytes = (pvs->cells + 7) / 8;
+  pvs->offsets = (int *)alloc_make(pvs->cells * sizeof(int));
+  pvs->data_cap = pvs->row_bytes * 4;
+  pvs->data = (uint8_t *)alloc_make(pvs->data_cap);
+  pvs->data_size = 0;
+  pvs->row = (uint8_t *)alloc_make(pvs->row_bytes);
+  pvs->row_cell = -1;
+}
+
+void pvs_clean(pvs_s *pvs) {
+  pvs->occluder_min = (vec3 *)alloc_free(pvs->occluder_min);
+  pvs->occluder_max = (vec3 *)alloc_free(pvs->occluder_max);
+  pvs->target_min = (vec3 *)alloc_free(pvs->target_min);
+  pvs->target_max = (vec3 *)alloc_free(pvs->target_max);
+  pvs->offsets = (int *)alloc_free(pvs->offsets);
+  pvs->data = (uint8_t *)alloc_free(pvs->data);
+  pvs->row = (uint8_t *)alloc_free(pvs->row);
+  pvs->cells = 0;
+  pvs->data_size = 0;
+  pvs->data_cap = 0;
+  pvs->row_cell = -1;
+}
+
+int pvs_cell_index(const pvs_s *pvs, int x, int y, int z) {
+  return (y * pvs->size_x + x) * pvs->size_z + z;
+}
+
+// pvs_cell_at gives the cell holding p, -1 outside of the grid.
+int pvs_cell_at(const pvs_s *pvs, vec3 p) {
+  vec3 g = (p - pvs->origin) / pvs->cell;
+  int x = (int)floorf(g.x);
+  int y = (int)floorf(g.y);
+  int z = (int)floorf(g.z);
+  if (x < 0 || y < 0 || z < 0 || x >= pvs->size_x || y >= pvs->size_y ||
+      z >= pvs->size_z) {
+    return -1;
+  }
+  return pvs_cell_index(pvs, x, y, z);
+}
+
+// pvs_cell_coords gives the grid coordinates of cell c.
+void pvs_cell_coords(const pvs_s *pvs, int c, int *x, int *y, int *z) {
+  *z = c % pvs->size_z;
+  *x = (c / pvs->size_z) % pvs->size_x;
+  *y = c / (pvs->size_z * pvs->size_x);
+}
+
+internal void pvs_cell_box(const pvs_s *pvs, int c, vec3 *min, vec3 *max) {
+  int x, y, z;
+  pvs_cell_coords(pvs, c, &x, &y, &z);
+  *min = pvs->origin + vec3(x, y, z) * pvs->cell;
+  *max = *min + pvs->cell;
+}
+
+// pvs_set_box puts the box of an object standing in cell c, before
+// pvs_build.
+void pvs_set_box(pvs_s *pvs, int c, vec3 min, vec3 max) {
+  assert(c >= 0 && c < pvs->cells);
+  vec3 cell_min, cell_max;
+  pvs_cell_box(pvs, c, &cell_min, &cell_max);
+  pvs->occluder_min[c] = glm::max(min, cell_min);
+  pvs->occluder_max[c] = glm::min(max, cell_max);
+  pvs->target_min[c] = min;
+  pvs->target_max[c] = max;
+}
+
+internal bool pvs_has_occluder(const pvs_s *pvs, int c) {
+  return pvs->occluder_min[c].x <= pvs->occluder_max[c].x;
+}
+
+// pvs_segment_hits_box is the slab test of the segment from p to p + d.
+internal bool pvs_segment_hits_box(vec3 p, vec3 d, vec3 min, vec3 max) {
+  float t0 = 0.0f;
+  float t1 = 1.0f;
+  for (int a = 0; a < 3; a++) {
+    if (fabs(d[a]) < 1e-8f) {
+      if (p[a] < min[a] || p[a] > max[a]) {
+        return false;
+      }
+      continue;
+    }
+    float inv = 1.0f / d[a];
+    float near = (min[a] - p[a]) * inv;
+    float far = (max[a] - p[a]) * inv;
+    if (near > far) {
+      float tmp = near;
+      near = far;
+      far = tmp;
+    }
+    t0 = fmax(t0, near);
+    t1 = fmin(t1, far);
+    if (t0 > t1) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// pvs_segment_clear walks cells along the segment from p0 to p1 (Amanatides,
+// Woo) and tells whether no occluder but those of cells a and b is in the
+// way. p0 must be inside the grid.
+internal bool pvs_segment_clear(const pvs_s *pvs, vec3 p0, vec3 p1, int a,
+                                int b) {
+  vec3 d = p1 - p0;
+  vec3 g = (p0 - pvs->origin) / pvs->cell;
+  int size[3] = {pvs->size_x, pvs->size_y, pvs->size_z};
+  int c[3];
+  int step[3];
+  float t_max[3];
+  float t_delta[3];
+  for (int k = 0; k < 3; k++) {
+    c[k] = (int)floorf(g[k]);
+    c[k] = c[k] < 0 ? 0 : (c[k] >= size[k] ? size[k] - 1 : c[k]);
+    if (d[k] > 0.0f) {
+      step[k] = 1;
+      t_max[k] = (pvs->origin[k] + (c[k] + 1) * pvs->cell[k] - p0[k]) / d[k];
+      t_delta[k] = pvs->cell[k] / d[k];
+    } else if (d[k] < 0.0f) {
+      step[k] = -1;
+      t_max[k] = (pvs->origin[k] + c[k] * pvs->cell[k] - p0[k]) / d[k];
+      t_delta[k] = -pvs->cell[k] / d[k];
+    } else {
+      step[k] = 0;
+      t_max[k] = 2.0f;
+      t_delta[k] = 0.0f;
+    }
+  }
+
+  for (;;) {
+    int cell = pvs_cell_index(pvs, c[0], c[1], c[2]);
+    if (cell != a && cell != b && pvs_has_occluder(pvs, cell) &&
+        pvs_segment_hits_box(p0, d, pvs->occluder_min[cell],
+                             pvs->occluder_max[cell])) {
+      return false;
+    }
+
+    int k = t_max[0] < t_max[1] ? (t_max[0] < t_max[2] ? 0 : 2)
+                                : (t_max[1] < t_max[2] ? 1 : 2);
+    if (t_max[k] > 1.0f) {
+      return true;
+    }
+    c[k] += step[k];
+    if (c[k] < 0 || c[k] >= size[k]) {
+      return true;
+    }
+    t_max[k] += t_delta[k];
+  }
+}
+
+internal void pvs_samples(vec3 min, vec3 max, vec3 out[PVS_SAMPLES]) {
+  vec3 inset = (max - min) * PVS_SAMPLE_INSET;
+  vec3 lo = min + inset;
+  vec3 hi = max - inset;
+  for (int i = 0; i < 8; i++) {
+    out[i] = vec3(i & 1 ? hi.x : lo.x, i & 2 ? hi.y : lo.y, i & 4 ? hi.z : lo.z);
+  }
+  out[8] = (min + max) * 0.5f;
+}
+
+struct pvs_build_s {
+  pvs_s *pvs;
+  // uncompressed sets, row_bytes each
+  uint8_t *rows;
+};
+
+// pvs_build_job fills the uncompressed set of one cell.
+internal void pvs_build_job(void *data, int a) {
+  pvs_build_s *build = (pvs_build_s *)data;
+  pvs_s *pvs = build->pvs;
+  uint8_t *row = build->rows + a * pvs->row_bytes;
+
+  vec3 from_min, from_max;
+  pvs_cell_box(pvs, a, &from_min, &from_max);
+  vec3 from[PVS_SAMPLES];
+  pvs_samples(from_min, from_max, from);
+
+  for (int b = 0; b < pvs->cells; b++) {
+    vec3 to_min = pvs->target_min[b];
+    vec3 to_max = pvs->target_max[b];
+    if (!pvs_has_occluder(pvs, b)) {
+      pvs_cell_box(pvs, b, &to_min, &to_max);
+    }
+    vec3 to[PVS_SAMPLES];
+    pvs_samples(to_min, to_max, to);
+
+    bool visible = b == a;
+    for (int i = 0; i < PVS_SAMPLES && !visible; i++) {
+      for (int j = 0; j < PVS_SAMPLES && !visible; j++) {
+        visible = pvs_segment_clear(pvs, from[i], to[j], a, b);
+      }
+    }
+    if (visible) {
+      row[b / 8] |= 1 << (b % 8);
+    }
+  }
+}
+
+internal void pvs_push(pvs_s *pvs, uint8_t byte) {
+  if (pvs->data_size == pvs->data_cap) {
+    pvs->data_cap *= 2;
+    pvs->data = (uint8_t *)alloc_resize(pvs->data, pvs->data_cap);
+  }
+  pvs->data[pvs->data_size++] = byte;
+}
+
+// pvs_build computes the sets of all cells, one job per cell. Boxes must be
+// set.
+void pvs_build(pvs_s *pvs, jobs_s *jobs) {
+  pvs_build_s build = {};
+  build.pvs = pvs;
+  size_t rows_size = pvs->cells * pvs->row_bytes;
+  build.rows = (uint8_t *)alloc_make(rows_size);
+  memset(build.rows, 0, rows_size);
+
+  jobs_dispatch(jobs, pvs_build_job, &build, pvs->cells);
+  jobs_wait(jobs);
+
+  pvs->data_size = 0;
+  for (int c = 0; c < pvs->cells; c++) {
+    pvs->offsets[c] = pvs->data_size;
+    const uint8_t *row = build.rows + c * pvs->row_bytes;
+    for (int i = 0; i < pvs->row_bytes;) {
+      if (row[i] != 0) {
+        pvs_push(pvs, row[i++]);
+        continue;
+      }
+      int run = 0;
+      while (i < pvs->row_bytes && row[i] == 0 && run < 255) {
+        i++;
+        run++;
+      }
+      pvs_push(pvs, 0);
+      pvs_push(pvs, run);
+    }
+  }
+  pvs->row_cell = -1;
+
+  alloc_free(build.rows);
+}
+
+// pvs_select expands the set of cell c, -1 makes everything visible.
+void pvs_select(pvs_s *pvs, int c) {
+  if (c == pvs->row_cell) {
+    return;
+  }
+  pvs->row_cell = c;
+  if (c < 0) {
+    return;
+  }
+
+  const uint8_t *src = pvs->data + pvs->offsets[c];
+  for (int i = 0; i < pvs->row_bytes;) {
+    if (*src != 0) {
+      pvs->row[i++] = *src++;
+      continue;
+    }
+    int run = src[1];
+    src += 2;
+    memset(pvs->row + i, 0, run);
+    i += run;
+  }
+}
+
+// pvs_visible tells whether cell c may be seen from the selected cell.
+bool pvs_visible(const pvs_s *pvs, int c) {
+  if (pvs->row_cell < 0 || c < 0) {
+    return true;
+  }
+  return (pvs->row[c / 8] >> (c % 8)) & 1;
+}
+
+#endif
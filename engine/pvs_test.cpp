@@ -0,0 +1,59 @@
+#include "unity.h"
+
+#ifndef PVS_TEST_H
+#define PVS_TEST_H
+
+#include "pvs.h"
+
+bool testPvs() {
+  // a corridor of 20 cells along x with a wall filling cell 3, and a pillar
+  // in cell 10 that the corridor passes around
+  pvs_s pvs = {};
+  pvs_init(&pvs, 20, 1, 3, vec3(0), vec3(1));
+  for (int z = 0; z < 3; z++) {
+    pvs_set_box(&pvs, pvs_cell_index(&pvs, 3, 0, z), vec3(3, 0, z),
+                vec3(4, 1, z + 1));
+  }
+  pvs_set_box(&pvs, pvs_cell_index(&pvs, 10, 0, 1), vec3(10.2f, 0, 1.2f),
+              vec3(10.8f, 1, 1.8f));
+
+  jobs_s jobs;
+  jobs_init(&jobs, 2);
+  pvs_build(&pvs, &jobs);
+  jobs_clean(&jobs);
+
+  struct {
+    vec3 eye;
+    int x, z;
+    bool visible;
+  } cases[] = {
+      {vec3(0.5f, 0.5f, 0.5f), 2, 2, true},    // before the wall
+      {vec3(0.5f, 0.5f, 0.5f), 3, 1, true},    // the wall itself
+      {vec3(0.5f, 0.5f, 0.5f), 4, 0, false},   // behind the wall
+      {vec3(0.5f, 0.5f, 0.5f), 19, 1, false},  // far behind the wall
+      {vec3(5.5f, 0.5f, 1.5f), 19, 1, true},   // around the pillar
+      {vec3(19.5f, 0.5f, 0.5f), 0, 0, false},  // the other way
+      {vec3(-1.0f, 0.5f, 0.5f), 19, 1, true},  // outside of the grid
+  };
+  for (int i = 0; i < (int)COUNT_OF(cases); i++) {
+    pvs_select(&pvs, pvs_cell_at(&pvs, cases[i].eye));
+    int c = pvs_cell_index(&pvs, cases[i].x, 0, cases[i].z);
+    if (pvs_visible(&pvs, c) != cases[i].visible) {
+      printf("pvs: case %d visible %d, want %d\n", i, pvs_visible(&pvs, c),
+             cases[i].visible);
+      return true;
+    }
+  }
+
+  // cells behind the wall are a run of zero bytes
+  int size = pvs.offsets[1] - pvs.offsets[0];
+  if (size >= pvs.row_bytes) {
+    printf("pvs: set of cell 0 takes %d bytes of %d\n", size, pvs.row_bytes);
+    return true;
+  }
+
+  pvs_clean(&pvs);
+  return false;
+}
+
+#endif
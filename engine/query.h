@@ -0,0 +1,136 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include "unity.h"
+
+#include "alloc.h"
+#include "renderer.h"
+
+// Occlusion queries of objects, read one or more frames after they were
+// issued so the CPU never waits for the GPU.
+//
+// Every object has a query_slot_s. While it is being tested it holds a query
+// of the pool, given back when the object stops being tested. The slot keeps
+// how often the object turned out hidden: objects that are almost never
+// hidden don't pay for the box draw and the query, they rest for a while and
+// are tried again later.
+
+// results counted before the hit rate is trusted, and halved after
+#define QUERY_HISTORY 32
+// objects hidden less often than this rest
+#define QUERY_MIN_HIT_RATE 0.1f
+// frames a resting object goes without queries
+#define QUERY_REST_FRAMES 120
+
+struct query_pool_s {
+  gpu_query_s *queries;
+  int cap;
+  int *free;
+  int free_size;
+};
+
+void query_pool_init(query_pool_s *pool, int cap) {
+  pool->queries = (gpu_query_s *)alloc_make(cap * sizeof(gpu_query_s));
+  pool->free = (int *)alloc_make(cap * sizeof(int));
+  pool->cap = cap;
+  for (int i = 0; i < cap; i++) {
+    pool->queries[i] = gpu_query_create();
+    pool->free[i] = cap - 1 - i;
+  }
+  pool->free_size = cap;
+}
+
+void query_pool_clean(query_pool_s *pool) {
+  for (int i = 0; i < pool->cap; i++) {
+    gpu_query_destroy(&pool->queries[i]);
+  }
+  pool->queries = (gpu_query_s *)alloc_free(pool->queries);
+  pool->free = (int *)alloc_free(pool->free);
+  pool->cap = 0;
+  pool->free_size = 0;
+}
+
+struct query_slot_s {
+  // index into the pool, -1 without a query
+  int query;
+  // issued and not read back yet
+  bool pending;
+  // last result read back
+  bool occluded;
+
+  int results;
+  int hits;
+  int resting;
+};
+
+void query_slot_init(query_slot_s *slot) {
+  *slot = {};
+  slot->query = -1;
+}
+
+// query_slot_release gives the query back to the pool. The result of a
+// pending one is dropped, the next user waits for its own.
+void query_slot_release(query_pool_s *pool, query_slot_s *slot) {
+  if (slot->query >= 0) {
+    pool->free[pool->free_size++] = slot->query;
+  }
+  slot->query = -1;
+  slot->pending = false;
+  slot->occluded = false;
+}
+
+// query_slot_poll reads the result of the pending query if it is there.
+void query_slot_poll(query_pool_s *pool, query_slot_s *slot) {
+  bool any_samples = true;
+  if (!slot->pending ||
+      !gpu_query_result(pool->queries[slot->query], &any_samples)) {
+    return;
+  }
+
+  slot->pending = false;
+  slot->occluded = !any_samples;
+  slot->results++;
+  slot->hits += slot->occluded;
+  if (slot->results == QUERY_HISTORY * 2) {
+    slot->results /= 2;
+    slot->hits /= 2;
+  }
+}
+
+// query_slot_wanted tells whether the object is worth a query this frame.
+bool query_slot_wanted(query_slot_s *slot) {
+  if (slot->resting > 0) {
+    slot->resting--;
+    return false;
+  }
+  if (slot->results >= QUERY_HISTORY &&
+      slot->hits < slot->results * QUERY_MIN_HIT_RATE) {
+    slot->resting = QUERY_REST_FRAMES;
+    slot->results = 0;
+    slot->hits = 0;
+    return false;
+  }
+  return true;
+}
+
+// query_slot_begin starts the query of the object's box draw, false when it
+// is still waiting for the last one or the pool is empty.
+bool query_slot_begin(query_pool_s *pool, query_slot_s *slot) {
+  if (slot->pending) {
+    return false;
+  }
+  if (slot->query < 0) {
+    if (pool->free_size == 0) {
+      return false;
+    }
+    slot->query = pool->free[--pool->free_size];
+  }
+
+  gpu_query_begin(pool->queries[slot->query]);
+  slot->pending = true;
+  return true;
+}
+
+void query_slot_end() { gpu_query_end(); }
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef RANGE_ALLOC_H
+#define RANGE_ALLOC_H
+
+#include "unity.h"
+
+#include "alloc.h"
+
+// range_alloc_s hands out ranges of [0, capacity) in whatever unit the owner
+// counts in (vertices, indices, bytes). Free ranges are kept sorted by offset
+// and merged with their neighbours when freed, allocation is first fit.
+
+struct range_s {
+  int offset;
+  int size;
+};
+
+struct range_alloc_s {
+  range_s *free;
+  int free_size;
+  int free_cap;
+
+  int capacity;
+};
+
+struct range_alloc_stats_s {
+  int used;
+  int free;
+  int largest_free;
+  int free_ranges;
+  // 0 - all free space is one range, close to 1 - scattered in small holes
+  float fragmentation;
+};
+
+// range_alloc_reset marks [0, used) as allocated and the rest as free.
+void range_alloc_reset(range_alloc_s *ra, int used) {
+  assert(used <= ra->capacity);
+  ra->free_size = 0;
+  if (used < ra->capacity) {
+    ra->free[ra->free_size++] = {used, ra->capacity - used};
+  }
+}
+
+void range_alloc_init(range_alloc_s *ra, int capacity) {
+  ra->free_cap = 16;
+  ra->free = (range_s *)alloc_make(ra->free_cap * sizeof(range_s));
+  ra->capacity = capacity;
+  range_alloc_reset(ra, 0);
+}
+
+void range_alloc_clean(range_alloc_s *ra) {
+  ra->free = (range_s *)alloc_free(ra->free);
+  ra->free_size = 0;
+  ra->free_cap = 0;
+  ra->capacity = 0;
+}
+
+// range_alloc_make returns offset of size free units, -1 when no free range
+// is large enough.
+int range_alloc_make(range_alloc_s *ra, int size) {
+  assert(size > 0);
+  for (int i = 0; i < ra->free_size; i++) {
+    range_s *r = &ra->free[i];
+    if (r->size < size) {
+      continue;
+    }
+
+    int offset = r->offset;
+    r->offset += size;
+    r->size -= size;
+    if (r->size == 0) {
+      memmove(r, r + 1, (ra->free_size - i - 1) * sizeof(range_s));
+      ra->free_size--;
+    }
+    return offset;
+  }
+  return -1;
+}
+
+void range_alloc_release(range_alloc_s *ra, int offset, int size) {
+  assert(offset >= 0 && offset + size <= ra->capacity);
+
+  // first free range after the released one
+  int i = 0;
+  while (i < ra->free_size && ra->free[i].offset < offset) {
+    i++;
+  }
+
+  bool merge_prev =
+      i > 0 && ra->free[i - 1].offset + ra->free[i - 1].size == offset;
+  bool merge_next =
+      i < ra->free_size && offset + size == ra->free[i].offset;
+
+  if (merge_prev && merge_next) {
+    ra->free[i - 1].size += size + ra->free[i].size;
+    memmove(&ra->free[i], &ra->free[i + 1],
+            (ra->free_size - i - 1) * sizeof(range_s));
+    ra->free_size--;
+  } else if (merge_prev) {
+    ra->free[i - 1].size += size;
+  } else if (merge_next) {
+    ra->free[i].offset = offset;
+    ra->free[i].size += size;
+  } else {
+    if (ra->free_size == ra->free_cap) {
+      ra->free_cap *= 2;
+      ra->free =
+          (range_s *)alloc_resize(ra->free, ra->free_cap * sizeof(range_s));
+    }
+    memmove(&ra->free[i + 1], &ra->free[i],
+            (ra->free_size - i) * sizeof(range_s));
+    ra->free[i] = {offset, size};
+    ra->free_size++;
+  }
+}
+
+range_alloc_stats_s range_alloc_stats(const range_alloc_s *ra) {
+  range_alloc_stats_s s = {};
+  for (int i = 0; i < ra->free_size; i++) {
+    s.free += ra->free[i].size;
+    if (ra->free[i].size > s.largest_free) {
+      s.largest_free = ra->free[i].size;
+    }
+  }
+  s.used = ra->capacity - s.free;
+  s.free_ranges = ra->free_size;
+  s.fragmentation = s.free > 0 ? 1.0f - (float)s.largest_free / s.free : 0.0f;
+  return s;
+}
+
+#endif
@@ -0,0 +1,46 @@
+#include "unity.h"
+
+#ifndef RANGE_ALLOC_TEST_H
+#define RANGE_ALLOC_TEST_H
+
+#include "range_alloc.h"
+
+bool testRangeAlloc() {
+  range_alloc_s ra = {};
+  range_alloc_init(&ra, 100);
+
+  int a = range_alloc_make(&ra, 30);
+  int b = range_alloc_make(&ra, 30);
+  int c = range_alloc_make(&ra, 30);
+  if (a != 0 || b != 30 || c != 60 || range_alloc_make(&ra, 20) != -1) {
+    printf("range alloc: unexpected offsets %d %d %d\n", a, b, c);
+    range_alloc_clean(&ra);
+    return true;
+  }
+
+  // two holes, 30 and 10 units
+  range_alloc_release(&ra, a, 30);
+  range_alloc_stats_s s = range_alloc_stats(&ra);
+  if (s.free != 40 || s.free_ranges != 2 || s.largest_free != 30 ||
+      fabs(s.fragmentation - 0.25f) > 0.001f) {
+    printf("range alloc: stats %d free, %d ranges, %.2f fragmentation\n",
+           s.free, s.free_ranges, s.fragmentation);
+    range_alloc_clean(&ra);
+    return true;
+  }
+
+  // releasing the middle merges everything into one range
+  range_alloc_release(&ra, b, 30);
+  range_alloc_release(&ra, c, 30);
+  s = range_alloc_stats(&ra);
+  if (s.free != 100 || s.free_ranges != 1 || s.fragmentation != 0.0f) {
+    printf("range alloc: %d ranges after release\n", s.free_ranges);
+    range_alloc_clean(&ra);
+    return true;
+  }
+
+  range_alloc_clean(&ra);
+  return false;
+}
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include "unity.h"
+
+#include "alloc.h"
+
+// Render queue. Systems submit draw packets tagged with a 64-bit sort key,
+// the queue radix sorts them so that packets sharing a pass, shader, material
+// and mesh end up next to each other and execution changes state only when
+// the key says so. The item of a packet is whatever index the submitter
+// needs to find the draw back.
+//
+// Key layout, most significant first:
+//   pass 4 | shader 12 | material 16 | mesh 12 | depth 20
+
+#define RENDER_KEY_DEPTH_BITS 20
+#define RENDER_KEY_MESH_BITS 12
+#define RENDER_KEY_MATERIAL_BITS 16
+#define RENDER_KEY_SHADER_BITS 12
+#define RENDER_KEY_PASS_BITS 4
+
+#define RENDER_KEY_MESH_SHIFT RENDER_KEY_DEPTH_BITS
+#define RENDER_KEY_MATERIAL_SHIFT (RENDER_KEY_MESH_SHIFT + RENDER_KEY_MESH_BITS)
+#define RENDER_KEY_SHADER_SHIFT                                                \
+  (RENDER_KEY_MATERIAL_SHIFT + RENDER_KEY_MATERIAL_BITS)
+#define RENDER_KEY_PASS_SHIFT (RENDER_KEY_SHADER_SHIFT + RENDER_KEY_SHADER_BITS)
+
+#define RENDER_KEY_FIELD(key, name)                                            \
+  (((key) >> RENDER_KEY_##name##_SHIFT) &                                      \
+   ((1ull << RENDER_KEY_##name##_BITS) - 1))
+
+// packets whose keys match under the mask draw with the same state
+#define RENDER_KEY_STATE_MASK (~((1ull << RENDER_KEY_DEPTH_BITS) - 1))
+// and under this one only their meshes differ
+#define RENDER_KEY_MATERIAL_MASK (~((1ull << RENDER_KEY_MATERIAL_SHIFT) - 1))
+
+enum render_pass_e {
+  RENDER_PASS_OPAQUE,
+  RENDER_PASS_TRANSPARENT,
+  RENDER_PASS_OVERLAY,
+};
+
+// render_key packs the fields, depth is the view distance divided by the far
+// plane. Opaque packets go front to back so early depth test rejects more,
+// transparent ones back to front so they blend right.
+uint64_t render_key(render_pass_e pass, uint32_t shader, uint32_t material,
+                    uint32_t mesh, float depth) {
+  assert(shader < (1u << RENDER_KEY_SHADER_BITS));
+  assert(material < (1u << RENDER_KEY_MATERIAL_BITS));
+  assert(mesh < (1u << RENDER_KEY_MESH_BITS));
+
+  const uint32_t depth_max = (1u << RENDER_KEY_DEPTH_BITS) - 1;
+  depth = depth < 0.0f ? 0.0f : (depth > 1.0f ? 1.0f : depth);
+  uint32_t d = (uint32_t)(depth * depth_max);
+  if (pass == RENDER_PASS_TRANSPARENT) {
+    d = depth_max - d;
+  }
+
+  return ((uint64_t)pass << RENDER_KEY_PASS_SHIFT) |
+         ((uint64_t)shader << RENDER_KEY_SHADER_SHIFT) |
+         ((uint64_t)material << RENDER_KEY_MATERIAL_SHIFT) |
+         ((uint64_t)mesh << RENDER_KEY_MESH_SHIFT) | d;
+}
+
+// render_ids_s turns pointers (or pairs of them) into the small ids the key
+// is made of. Scenes have a handful of shaders and materials, so the lookup
+// is a linear search.
+#define RENDER_IDS_MAX 256
+
+struct render_ids_s {
+  const void *a[RENDER_IDS_MAX];
+  const void *b[RENDER_IDS_MAX];
+  int size;
+};
+
+uint32_t render_id(render_ids_s *ids, const void *a, const void *b = NULL) {
+  for (int i = 0; i < ids->size; i++) {
+    if (ids->a[i] == a && ids->b[i] == b) {
+      return i;
+    }
+  }
+
+  assert(ids->size < RENDER_IDS_MAX);
+  ids->a[ids->size] = a;
+  ids->b[ids->size] = b;
+  return ids->size++;
+}
+
+struct render_packet_s {
+  uint64_t key;
+  uint32_t item;
+};
+
+// render_queue_stats_s counts how many times the state would change if the
+// packets were executed in order.
+struct render_queue_stats_s {
+  int shader;
+  int material;
+  int mesh;
+};
+
+struct render_queue_s {
+  render_packet_s *packets;
+  // radix sort ping-pongs between packets and scratch
+  render_packet_s *scratch;
+  int size;
+  int cap;
+
+  // state changes in submission order and after the sort
+  render_queue_stats_s unsorted;
+  render_queue_stats_s sorted;
+};
+
+void render_queue_init(render_queue_s *rq, int cap) {
+  rq->packets = (render_packet_s *)alloc_make(cap * sizeof(render_packet_s));
+  rq->scratch = (render_packet_s *)alloc_make(cap * sizeof(render_packet_s));
+  rq->size = 0;
+  rq->cap = cap;
+  rq->unsorted = {};
+  rq->sorted = {};
+}
+
+void render_queue_clean(render_queue_s *rq) {
+  rq->packets = (render_packet_s *)alloc_free(rq->packets);
+  rq->scratch = (render_packet_s *)alloc_free(rq->scratch);
+  rq->size = 0;
+  rq->cap = 0;
+}
+
+void render_queue_reset(render_queue_s *rq) { rq->size = 0; }
+
+void render_queue_submit(render_queue_s *rq, uint64_t key, uint32_t item) {
+  assert(rq->size < rq->cap);
+  rq->packets[rq->size++] = {key, item};
+}
+
+render_queue_stats_s render_queue_count_changes(const render_packet_s *p,
+                                                int size) {
+  render_queue_stats_s s = {};
+  for (int i = 0; i < size; i++) {
+    uint64_t key = p[i].key;
+    uint64_t prev = i > 0 ? p[i - 1].key : ~key;
+    if (RENDER_KEY_FIELD(key, PASS) != RENDER_KEY_FIELD(prev, PASS) ||
+        RENDER_KEY_FIELD(key, SHADER) != RENDER_KEY_FIELD(prev, SHADER)) {
+      s.shader++;
+    }
+    if (RENDER_KEY_FIELD(key, MATERIAL) != RENDER_KEY_FIELD(prev, MATERIAL)) {
+      s.material++;
+    }
+    if (RENDER_KEY_FIELD(key, MESH) != RENDER_KEY_FIELD(prev, MESH)) {
+      s.mesh++;
+    }
+  }
+  return s;
+}
+
+// render_queue_sort orders packets by key with an LSD radix sort, 8 bits per
+// pass. Bytes every key has the same are skipped, with few distinct shaders
+// and materials most of the upper ones are. Equal keys keep submission order.
+void render_queue_sort(render_queue_s *rq) {
+  rq->unsorted = render_queue_count_changes(rq->packets, rq->size);
+
+  render_packet_s *src = rq->packets;
+  render_packet_s *dst = rq->scratch;
+  for (int shift = 0; shift < 64; shift += 8) {
+    int count[256] = {0};
+    for (int i = 0; i < rq->size; i++) {
+      count[(src[i].key >> shift) & 0xFF]++;
+    }
+
+    if (rq->size == 0 || count[(src[0].key >> shift) & 0xFF] == rq->size) {
+      continue;
+    }
+
+    int offset = 0;
+    for (int b = 0; b < 256; b++) {
+      int c = count[b];
+      count[b] = offset;
+      offset += c;
+    }
+
+    for (int i = 0; i < rq->size; i++) {
+      dst[count[(src[i].key >> shift) & 0xFF]++] = src[i];
+    }
+
+    render_packet_s *tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+
+  // sorted data may have ended in the scratch buffer
+  rq->packets = src;
+  rq->scratch = dst;
+
+  rq->sorted = render_queue_count_changes(rq->packets, rq->size);
+}
+
+int render_queue_stats_total(render_queue_stats_s s) {
+  return s.shader + s.material + s.mesh;
+}
+
+#endif
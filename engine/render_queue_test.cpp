@@ -0,0 +1,48 @@
+#include "unity.h"
+
+#ifndef RENDER_QUEUE_TEST_H
+#define RENDER_QUEUE_TEST_H
+
+#include "render_queue.h"
+
+bool testRenderQueueSort() {
+  render_queue_s rq = {};
+  render_queue_init(&rq, 64);
+
+  // two shaders and materials interleaved, depth counting down
+  for (int i = 0; i < 64; i++) {
+    uint64_t key = render_key(RENDER_PASS_OPAQUE, i % 2, (i / 2) % 2, 0,
+                              1.0f - i / 64.0f);
+    render_queue_submit(&rq, key, i);
+  }
+
+  render_queue_sort(&rq);
+
+  for (int i = 1; i < rq.size; i++) {
+    if (rq.packets[i - 1].key > rq.packets[i].key) {
+      printf("render queue: packet %d out of order\n", i);
+      render_queue_clean(&rq);
+      return true;
+    }
+  }
+
+  // front to back inside a state, the last submitted is the nearest
+  if (rq.packets[0].item != 60) {
+    printf("render queue: first item %d != 60\n", rq.packets[0].item);
+    render_queue_clean(&rq);
+    return true;
+  }
+
+  if (rq.unsorted.shader != 64 || rq.sorted.shader != 2 ||
+      rq.sorted.material != 4) {
+    printf("render queue: state changes %d -> %d shader, %d material\n",
+           rq.unsorted.shader, rq.sorted.shader, rq.sorted.material);
+    render_queue_clean(&rq);
+    return true;
+  }
+
+  render_queue_clean(&rq);
+  return false;
+}
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include "unity.h"
+
+// Render thread: a thread owning the GL context draws the frames the update
+// thread describes. A frame is described by a snapshot the update fills and
+// leaves alone until it has been drawn. There are RENDER_THREAD_FRAMES of
+// them, so while the render thread submits frame N the update already runs
+// frame N + 1 on the other one, and waits only when it gets two frames
+// ahead.
+//
+// Snapshots belong to the caller, the thread only hands out their indices.
+// A serial submit waits for its frame to be drawn, which gives the timing
+// of a single thread without moving the context back and forth.
+//
+// The render thread swaps too, SDL allows that on Windows and Linux but not
+// on every platform.
+
+#define RENDER_THREAD_FRAMES 2
+
+// render_frame_fn draws the frame of snapshot frame, on the render thread
+typedef void (*render_frame_fn)(void *data, int frame);
+
+struct render_thread_s {
+  SDL_Thread *thread;
+  SDL_Window *window;
+  SDL_GLContext ctx;
+
+  SDL_mutex *lock;
+  // broadcast whenever a snapshot is submitted, taken or drawn
+  SDL_cond *changed;
+
+  render_frame_fn fn;
+  void *data;
+
+  // snapshot the next update fills, the one submitted and not taken yet and
+  // the one being drawn, -1 for none
+  int next;
+  int queued;
+  int drawing;
+  bool quit;
+};
+
+internal int render_thread_main(void *data) {
+  render_thread_s *rt = (render_thread_s *)data;
+  SDL_GL_MakeCurrent(rt->window, rt->ctx);
+
+  SDL_LockMutex(rt->lock);
+  while (true) {
+    while (rt->queued < 0 && !rt->quit) {
+      SDL_CondWait(rt->changed, rt->lock);
+    }
+    // what was submitted is drawn before quitting
+    if (rt->queued < 0) {
+      break;
+    }
+    int frame = rt->queued;
+    rt->drawing = frame;
+    rt->queued = -1;
+    SDL_CondBroadcast(rt->changed);
+    SDL_UnlockMutex(rt->lock);
+
+    rt->fn(rt->data, frame);
+
+    SDL_LockMutex(rt->lock);
+    rt->drawing = -1;
+    SDL_CondBroadcast(rt->changed);
+  }
+  SDL_UnlockMutex(rt->lock);
+
+  SDL_GL_MakeCurrent(rt->window, NULL);
+  return 0;
+}
+
+// render_thread_start moves ctx, current on the calling thread, to a new
+// render thread drawing frames with fn.
+bool render_thread_start(render_thread_s *rt, SDL_Window *window,
+                         SDL_GLContext ctx, render_frame_fn fn, void *data) {
+  *rt = {};
+  rt->window = window;
+  rt->ctx = ctx;
+  rt->fn = fn;
+  rt->data = data;
+  rt->queued = -1;
+  rt->drawing = -1;
+
+  rt->lock = SDL_CreateMutex();
+  rt->changed = SDL_CreateCond();
+  if (rt->lock == NULL || rt->changed == NULL) {
+    printf("render thread: %s\n", SDL_GetError());
+    return false;
+  }
+
+  // a context is current on one thread at a time
+  SDL_GL_MakeCurrent(window, NULL);
+  rt->thread = SDL_CreateThread(render_thread_main, "render", rt);
+  if (rt->thread == NULL) {
+    printf("render thread: %s\n", SDL_GetError());
+    SDL_GL_MakeCurrent(window, ctx);
+    return false;
+  }
+  return true;
+}
+
+// render_thread_stop draws what was submitted, ends the thread and makes
+// the context current on the calling thread again.
+void render_thread_stop(render_thread_s *rt) {
+  if (rt->thread != NULL) {
+    SDL_LockMutex(rt->lock);
+    rt->quit = true;
+    SDL_CondBroadcast(rt->changed);
+    SDL_UnlockMutex(rt->lock);
+    SDL_WaitThread(rt->thread, NULL);
+    SDL_GL_MakeCurrent(rt->window, rt->ctx);
+  }
+
+  if (rt->changed != NULL) {
+    SDL_DestroyCond(rt->changed);
+  }
+  if (rt->lock != NULL) {
+    SDL_DestroyMutex(rt->lock);
+  }
+  *rt = {};
+}
+
+// render_thread_acquire waits until the snapshot the next update fills is
+// drawn and returns it.
+int render_thread_acquire(render_thread_s *rt) {
+  SDL_LockMutex(rt->lock);
+  int frame = rt->next;
+  while (rt->queued == frame || rt->drawing == frame) {
+    SDL_CondWait(rt->changed, rt->lock);
+  }
+  SDL_UnlockMutex(rt->lock);
+  return frame;
+}
+
+// render_thread_submit hands the snapshot filled since
+// render_thread_acquire to the render thread. Serial waits for it to be
+// drawn.
+void render_thread_submit(render_thread_s *rt, int frame, bool serial) {
+  SDL_LockMutex(rt->lock);
+  // the previous frame may not have been taken yet
+  while (rt->queued >= 0) {
+    SDL_CondWait(rt->changed, rt->lock);
+  }
+  rt->queued = frame;
+  rt->next = (frame + 1) % RENDER_THREAD_FRAMES;
+  SDL_CondBroadcast(rt->changed);
+  while (serial && (rt->queued == frame || rt->drawing == frame)) {
+    SDL_CondWait(rt->changed, rt->lock);
+  }
+  SDL_UnlockMutex(rt->lock);
+}
+
+#endif
@@ -0,0 +1,366 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include "unity.h"
+
+// Renderer interface. Engine and app code create buffers, textures and vertex
+// inputs, bind pipelines and submit draws through the gpu_* calls; the backend
+// implementing them is compiled in by the unity build (renderer_gl.cpp is the
+// GL 3.3/4.5 one). Handles are plain ids whose meaning belongs to the backend.
+//
+// Programs come with a gpu_layout_s, the uniforms and vertex attributes the
+// backend found in them. Uniforms are set through their entry of the layout,
+// a backend without GL style uniforms keeps them at an offset of its own
+// per entry.
+
+struct gpu_buffer_s {
+  uint32_t id;
+};
+
+struct gpu_texture_s {
+  uint32_t id;
+};
+
+// gpu_input_s describes where vertex attributes and indices come from.
+struct gpu_input_s {
+  uint32_t id;
+};
+
+enum gpu_buffer_flags_e {
+  // contents are going to be rewritten with gpu_buffer_write
+  GPU_BUFFER_DYNAMIC = 1 << 0,
+  // rewritten every frame, see gpu_buffer_map
+  GPU_BUFFER_STREAM = 1 << 1,
+};
+
+// pixel layout of the data given to gpu_texture_create, or of the color
+// textures of a target
+enum gpu_format_e {
+  GPU_FORMAT_R8,
+  GPU_FORMAT_RGB8,
+  GPU_FORMAT_RGBA8,
+  // targets only
+  GPU_FORMAT_RGBA16F,
+  // gpu_texture_storage only
+  GPU_FORMAT_R32F,
+  GPU_FORMAT_DEPTH24,
+};
+
+// texel layout of a buffer read through gpu_texture_buffer_create
+enum gpu_texel_e {
+  // samplerBuffer
+  GPU_TEXEL_RGBA32F,
+  // usamplerBuffer
+  GPU_TEXEL_RG32UI,
+  GPU_TEXEL_R16UI,
+};
+
+enum gpu_filter_e {
+  // mipmapped, linear, repeating
+  GPU_FILTER_LINEAR,
+  // mipmapped, nearest, clamped
+  GPU_FILTER_NEAREST,
+};
+
+// what commands after gpu_barrier read of what compute shaders wrote
+enum gpu_barrier_e {
+  // storage buffers
+  GPU_BARRIER_STORAGE = 1 << 0,
+  // images, through gpu_image_bind
+  GPU_BARRIER_IMAGE = 1 << 1,
+  // textures sampled
+  GPU_BARRIER_TEXTURE = 1 << 2,
+  // indirect commands and counts
+  GPU_BARRIER_COMMAND = 1 << 3,
+  // vertex streams
+  GPU_BARRIER_VERTEX = 1 << 4,
+};
+
+enum gpu_compare_e {
+  GPU_COMPARE_LESS,
+  GPU_COMPARE_LEQUAL,
+  GPU_COMPARE_EQUAL,
+  GPU_COMPARE_ALWAYS,
+};
+
+enum gpu_cull_e {
+  GPU_CULL_NONE,
+  GPU_CULL_BACK,
+  GPU_CULL_FRONT,
+};
+
+enum gpu_blend_e {
+  GPU_BLEND_NONE,
+  GPU_BLEND_ALPHA,
+  GPU_BLEND_ADD,
+};
+
+// Stencil modes of light volumes: the mark pass draws both faces of a closed
+// volume, back faces behind the depth buffer increment and front faces behind
+// it decrement, leaving nonzero where the depth is inside the volume. The
+// test pass then draws where it is nonzero and sets it back to zero, so the
+// next volume starts clean.
+enum gpu_stencil_e {
+  GPU_STENCIL_NONE,
+  GPU_STENCIL_VOLUME_MARK,
+  GPU_STENCIL_VOLUME_TEST,
+};
+
+struct gpu_program_s {
+  uint32_t id;
+};
+
+enum gpu_stage_e {
+  GPU_STAGE_VERTEX,
+  GPU_STAGE_FRAGMENT,
+  GPU_STAGE_COMPUTE,
+};
+
+// type of the data given to gpu_uniform_set
+enum gpu_uniform_e {
+  GPU_UNIFORM_FLOAT,
+  GPU_UNIFORM_VEC2,
+  GPU_UNIFORM_VEC3,
+  GPU_UNIFORM_VEC4,
+  // bools and samplers too, a sampler is set to the slot it reads
+  GPU_UNIFORM_INT,
+  GPU_UNIFORM_UINT,
+  GPU_UNIFORM_MAT3,
+  GPU_UNIFORM_MAT4,
+};
+
+#define GPU_UNIFORMS_MAX 128
+#define GPU_ATTRIBUTES_MAX 16
+#define GPU_NAME_MAX 48
+
+struct gpu_uniform_s {
+  uint32_t hash;
+  // where the backend keeps it, the location for GL
+  int32_t slot;
+  gpu_uniform_e type;
+  // elements of an array, 1 otherwise
+  int count;
+  char name[GPU_NAME_MAX];
+};
+
+// gpu_attribute_s is a vertex attribute a program reads. Matrices take one
+// location per column.
+struct gpu_attribute_s {
+  int location;
+  int locations;
+  int components;
+  bool integer;
+  char name[GPU_NAME_MAX];
+};
+
+// gpu_layout_s describes the linked program. Arrays are listed as name[0]
+// and by their name alone. It needs no context to read, command lists
+// recorded on job workers find their uniforms in it.
+struct gpu_layout_s {
+  gpu_program_s program;
+  gpu_uniform_s uniforms[GPU_UNIFORMS_MAX];
+  int uniforms_size;
+  gpu_attribute_s attributes[GPU_ATTRIBUTES_MAX];
+  int attributes_size;
+};
+
+// gpu_pipeline_s is the program together with the fixed function state it is
+// drawn with. The layout belongs to whoever made the program and outlives
+// the pipeline.
+struct gpu_pipeline_s {
+  gpu_program_s program;
+  const gpu_layout_s *layout;
+
+  bool depth_test;
+  bool depth_write;
+  gpu_compare_e depth_compare;
+  bool color_write;
+  // depth is clamped instead of clipping at near and far
+  bool depth_clamp;
+  gpu_cull_e cull;
+  gpu_blend_e blend;
+  gpu_stencil_e stencil;
+};
+
+struct gpu_draw_s {
+  gpu_input_s input;
+
+  // indices when the input has them, vertices otherwise
+  int first;
+  int count;
+  bool indexed;
+  // added to every index, lets meshes share one vertex buffer
+  int base_vertex;
+
+  int instances;
+};
+
+gpu_buffer_s gpu_buffer_create(size_t size, const void *data, int flags = 0);
+void gpu_buffer_write(gpu_buffer_s buf, size_t offset, size_t size,
+                      const void *data);
+// gpu_buffer_copy copies bytes on the GPU, ranges within one buffer must
+// not overlap.
+void gpu_buffer_copy(gpu_buffer_s src, size_t src_offset, gpu_buffer_s dst,
+                     size_t dst_offset, size_t size);
+void gpu_buffer_destroy(gpu_buffer_s *buf);
+// gpu_buffer_map maps the size bytes of a GPU_BUFFER_STREAM buffer for
+// writing for as long as it lives. NULL when the context can't keep buffers
+// mapped, it is written with gpu_buffer_orphan and gpu_buffer_write then.
+void *gpu_buffer_map(gpu_buffer_s buf, size_t size);
+// gpu_buffer_orphan drops the contents of buf without waiting for the draws
+// still reading them.
+void gpu_buffer_orphan(gpu_buffer_s buf, size_t size);
+// gpu_buffer_clear zeroes buf on the GPU.
+void gpu_buffer_clear(gpu_buffer_s buf);
+// gpu_buffer_bind_base binds buf to storage block binding slot of the
+// compute shaders and draws that follow.
+void gpu_buffer_bind_base(gpu_buffer_s buf, int slot);
+// gpu_buffer_bind_range is gpu_buffer_bind_base for size bytes of buf from
+// offset, which has to meet the storage offset alignment, 256 always does.
+void gpu_buffer_bind_range(gpu_buffer_s buf, int slot, size_t offset,
+                           size_t size);
+
+gpu_texture_s gpu_texture_create(int width, int height, gpu_format_e format,
+                                 const void *data, gpu_filter_e filter);
+void gpu_texture_bind(gpu_texture_s tex, int slot);
+void gpu_texture_destroy(gpu_texture_s *tex);
+// gpu_texture_storage makes a texture of levels mips without contents,
+// sampled without filtering and clamped. Compute shaders write it.
+gpu_texture_s gpu_texture_storage(int width, int height, int levels,
+                                  gpu_format_e format);
+// gpu_texture_copy_target copies the lower left width by height of the bound
+// target into level 0 of tex, its depth for a GPU_FORMAT_DEPTH24 texture.
+void gpu_texture_copy_target(gpu_texture_s tex, int width, int height);
+// gpu_image_bind binds level of tex, made with gpu_texture_storage in format,
+// to image slot of the compute shaders, for reading or for writing.
+void gpu_image_bind(gpu_texture_s tex, int level, int slot,
+                    gpu_format_e format, bool write);
+// gpu_texture_buffer_create gives shaders access to buf as an array of
+// texels, rgba32f ones (samplerBuffer) unless told otherwise.
+gpu_texture_s gpu_texture_buffer_create(gpu_buffer_s buf,
+                                        gpu_texel_e texel = GPU_TEXEL_RGBA32F);
+void gpu_texture_buffer_bind(gpu_texture_s tex, int slot);
+
+// gpu_target_s is an offscreen framebuffer: colors_size color textures and a
+// depth-stencil texture, all of the same size.
+#define GPU_TARGET_MAX_COLORS 4
+
+struct gpu_target_s {
+  uint32_t id;
+  gpu_texture_s colors[GPU_TARGET_MAX_COLORS];
+  int colors_size;
+  gpu_texture_s depth;
+  int width;
+  int height;
+};
+
+// gpu_target_create gives a target with id 0 when the context can't draw to
+// the formats.
+gpu_target_s gpu_target_create(int width, int height,
+                               const gpu_format_e *colors, int colors_size);
+void gpu_target_destroy(gpu_target_s *t);
+// gpu_target_bind draws to t from now on, NULL is the window. The viewport
+// is left alone.
+void gpu_target_bind(const gpu_target_s *t);
+
+gpu_input_s gpu_input_create();
+// gpu_input_stream feeds attributes of V from buf starting at byte offset
+// base, one stream per slot.
+template <typename V>
+void gpu_input_stream(gpu_input_s in, int slot, gpu_buffer_s buf,
+                      size_t base = 0, bool per_instance = false);
+void gpu_input_indices(gpu_input_s in, gpu_buffer_s buf);
+void gpu_input_destroy(gpu_input_s *in);
+
+// gpu_program_create compiles sources, one per stage, and links them into
+// the program of layout, which it fills in. Errors are printed with name, the
+// program has id 0 then.
+gpu_program_s gpu_program_create(const gpu_stage_e *stages,
+                                 const char *const *sources, int count,
+                                 const char *name, gpu_layout_s *layout);
+void gpu_program_destroy(gpu_program_s *p);
+// gpu_program_bind makes p the program of compute dispatches and of the
+// uniforms set next, draws bind theirs with the pipeline.
+void gpu_program_bind(gpu_program_s p);
+// gpu_uniform_set sets count elements of u of program p from data, laid out
+// as type.
+void gpu_uniform_set(gpu_program_s p, const gpu_uniform_s *u,
+                     gpu_uniform_e type, const void *data, int count);
+
+gpu_pipeline_s gpu_pipeline_opaque(const gpu_layout_s *layout);
+void gpu_pipeline_bind(const gpu_pipeline_s *p);
+
+void gpu_draw(const gpu_draw_s *d);
+
+// gpu_draw_indirect_s is one command of a multi draw, laid out the way
+// indirect draw buffers want it. Indices are always 32 bit.
+struct gpu_draw_indirect_s {
+  uint32_t count;
+  uint32_t instance_count;
+  uint32_t first_index;
+  int32_t base_vertex;
+  // per-instance streams start at this instance
+  uint32_t base_instance;
+};
+
+// gpu_has_multi_draw tells whether gpu_draw_multi may be used, callers loop
+// over the commands with gpu_draw otherwise.
+bool gpu_has_multi_draw();
+// gpu_draw_multi submits count commands of the commands buffer starting at
+// first with one call.
+void gpu_draw_multi(gpu_input_s in, gpu_buffer_s commands, int first,
+                    int count);
+// gpu_draw_multi_count is gpu_draw_multi submitting as many commands as the
+// uint at index count_at of counts says, at most max_count. Only when
+// gpu_has_multi_draw_count tells so.
+bool gpu_has_multi_draw_count();
+void gpu_draw_multi_count(gpu_input_s in, gpu_buffer_s commands, int first,
+                          gpu_buffer_s counts, int count_at, int max_count);
+
+// gpu_has_compute tells whether gpu_dispatch and storage buffers work.
+bool gpu_has_compute();
+// gpu_dispatch runs the compute program bound with gpu_program_bind on x by
+// y by z work groups.
+void gpu_dispatch(int x, int y, int z);
+// gpu_barrier makes what dispatches wrote visible to what reads it next,
+// barriers are gpu_barrier_e.
+void gpu_barrier(int barriers);
+
+// gpu_query_s counts whether any sample of the draws between
+// gpu_query_begin and gpu_query_end passed the depth test. Conservative
+// (may say yes for nothing) when the context has it, it is cheaper.
+struct gpu_query_s {
+  uint32_t id;
+};
+
+gpu_query_s gpu_query_create();
+void gpu_query_destroy(gpu_query_s *q);
+void gpu_query_begin(gpu_query_s q);
+void gpu_query_end();
+// gpu_query_result never waits, it returns false while the GPU hasn't got
+// to the query yet.
+bool gpu_query_result(gpu_query_s q, bool *any_samples);
+// gpu_timer_begin and gpu_timer_end measure the GPU time of the commands
+// between them in a query of gpu_query_create instead, timers don't nest.
+void gpu_timer_begin(gpu_query_s q);
+void gpu_timer_end();
+// gpu_timer_result never waits either.
+bool gpu_timer_result(gpu_query_s q, float *ms);
+
+// gpu_fence_s is signaled once the GPU has run the commands issued before
+// gpu_fence_insert.
+struct gpu_fence_s {
+  void *id;
+};
+
+gpu_fence_s gpu_fence_insert();
+// gpu_fence_wait blocks until f is signaled or timeout_ns have passed, false
+// on timeout. A fence of id NULL is always signaled.
+bool gpu_fence_wait(gpu_fence_s f, uint64_t timeout_ns);
+void gpu_fence_destroy(gpu_fence_s *f);
+
+void gpu_viewport(int x, int y, int width, int height);
+// gpu_clear clears color, depth and stencil of the current target.
+void gpu_clear(float r, float g, float b, float a);
+
+#endif
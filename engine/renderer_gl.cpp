@@ -0,0 +1,779 @@
+#include "renderer.h"
+
+#include "buffer.h"
+#include "glcaps.h"
+#include "glstate.h"
+#include "shader.h"
+
+// GL backend of the renderer interface, ids are GL object names.
+
+gpu_buffer_s gpu_buffer_create(size_t size, const void *data, int flags) {
+  int buffer_flags = (flags & GPU_BUFFER_DYNAMIC) ? BUFFER_DYNAMIC : 0;
+  buffer_flags |= (flags & GPU_BUFFER_STREAM) ? BUFFER_STREAM : 0;
+  return {buffer_create(size, data, buffer_flags)};
+}
+
+void gpu_buffer_write(gpu_buffer_s buf, size_t offset, size_t size,
+                      const void *data) {
+  buffer_write(buf.id, offset, size, data);
+}
+
+void gpu_buffer_copy(gpu_buffer_s src, size_t src_offset, gpu_buffer_s dst,
+                     size_t dst_offset, size_t size) {
+  buffer_copy(src.id, src_offset, dst.id, dst_offset, size);
+}
+
+void gpu_buffer_destroy(gpu_buffer_s *buf) { buffer_destroy(&buf->id); }
+
+void *gpu_buffer_map(gpu_buffer_s buf, size_t size) {
+  return buffer_map_persistent(buf.id, size);
+}
+
+void gpu_buffer_orphan(gpu_buffer_s buf, size_t size) {
+  buffer_orphan(buf.id, size);
+}
+
+void gpu_buffer_clear(gpu_buffer_s buf) { buffer_clear(buf.id); }
+
+void gpu_buffer_bind_base(gpu_buffer_s buf, int slot) {
+  glstate_bind_storage_buffer(slot, buf.id);
+}
+
+void gpu_buffer_bind_range(gpu_buffer_s buf, int slot, size_t offset,
+                           size_t size) {
+  glstate_bind_storage_range(slot, buf.id, offset, size);
+}
+
+gpu_texture_s gpu_texture_create(int width, int height, gpu_format_e format,
+                                 const void *data, gpu_filter_e filter) {
+  GLenum data_format = GL_RED;
+  if (format == GPU_FORMAT_RGB8) {
+    data_format = GL_RGB;
+  } else if (format == GPU_FORMAT_RGBA8) {
+    data_format = GL_RGBA;
+  }
+
+  // textures are stored without alpha, nothing blends with it
+  GLuint tex = 0;
+  if (g_glcaps.dsa) {
+    // immutable storage with the full mip chain, no binding involved
+    int levels = 1;
+    for (int size = width > height ? width : height; size > 1; size /= 2) {
+      levels++;
+    }
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &tex);
+    glTextureStorage2D(tex, levels, GL_RGB8, width, height);
+    glTextureSubImage2D(tex, 0, 0, 0, width, height, data_format,
+                        GL_UNSIGNED_BYTE, data);
+    glGenerateTextureMipmap(tex);
+  } else {
+    glGenTextures(1, &tex);
+    glstate_bind_texture(0, GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, data_format,
+                 GL_UNSIGNED_BYTE, data);
+    glGenerateMipmap(GL_TEXTURE_2D);
+  }
+
+  // set the texture wrapping/filtering options (on the texture object itself
+  // with dsa, on the currently bound one otherwise)
+  auto param = [tex](GLenum name, GLint value) {
+    if (g_glcaps.dsa) {
+      glTextureParameteri(tex, name, value);
+    } else {
+      glTexParameteri(GL_TEXTURE_2D, name, value);
+    }
+  };
+
+  if (filter == GPU_FILTER_LINEAR) {
+    param(GL_TEXTURE_WRAP_S, GL_REPEAT);
+    param(GL_TEXTURE_WRAP_T, GL_REPEAT);
+    param(GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    param(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  } else {
+    param(GL_TEXTURE_WRAP_S, GL_CLAMP);
+    param(GL_TEXTURE_WRAP_T, GL_CLAMP);
+    param(GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+    param(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  }
+
+  // float borderColor[] = { 1.0f, 0.2f, 0.45f, 0.5f };
+  // glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+
+  return {tex};
+}
+
+void gpu_texture_bind(gpu_texture_s tex, int slot) {
+  glstate_bind_texture(slot, GL_TEXTURE_2D, tex.id);
+}
+
+gpu_texture_s gpu_texture_buffer_create(gpu_buffer_s buf, gpu_texel_e texel) {
+  GLenum format = GL_RGBA32F;
+  if (texel == GPU_TEXEL_RG32UI) {
+    format = GL_RG32UI;
+  } else if (texel == GPU_TEXEL_R16UI) {
+    format = GL_R16UI;
+  }
+
+  GLuint tex = 0;
+  if (g_glcaps.dsa) {
+    glCreateTextures(GL_TEXTURE_BUFFER, 1, &tex);
+    glTextureBuffer(tex, format, buf.id);
+  } else {
+    glGenTextures(1, &tex);
+    glstate_bind_texture(0, GL_TEXTURE_BUFFER, tex);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, buf.id);
+  }
+  return {tex};
+}
+
+void gpu_texture_buffer_bind(gpu_texture_s tex, int slot) {
+  glstate_bind_texture(slot, GL_TEXTURE_BUFFER, tex.id);
+}
+
+void gpu_texture_destroy(gpu_texture_s *tex) {
+  if (tex->id == 0) {
+    return;
+  }
+  glstate_forget_texture(tex->id);
+  glDeleteTextures(1, &tex->id);
+  tex->id = 0;
+}
+
+internal GLenum gpu_gl_storage_format(gpu_format_e format) {
+  switch (format) {
+  case GPU_FORMAT_R8:
+    return GL_R8;
+  case GPU_FORMAT_RGB8:
+    return GL_RGB8;
+  case GPU_FORMAT_RGBA8:
+    return GL_RGBA8;
+  case GPU_FORMAT_RGBA16F:
+    return GL_RGBA16F;
+  case GPU_FORMAT_R32F:
+    return GL_R32F;
+  case GPU_FORMAT_DEPTH24:
+    return GL_DEPTH_COMPONENT24;
+  }
+  return GL_RGBA8;
+}
+
+// immutable storage needs GL 4.2, compute 4.3 anyway
+gpu_texture_s gpu_texture_storage(int width, int height, int levels,
+                                  gpu_format_e format) {
+  GLenum internal_format = gpu_gl_storage_format(format);
+  GLenum min_filter = levels > 1 ? GL_NEAREST_MIPMAP_NEAREST : GL_NEAREST;
+  GLuint tex = 0;
+  if (g_glcaps.dsa) {
+    glCreateTextures(GL_TEXTURE_2D, 1, &tex);
+    glTextureStorage2D(tex, levels, internal_format, width, height);
+    glTextureParameteri(tex, GL_TEXTURE_MIN_FILTER, min_filter);
+    glTextureParameteri(tex, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTextureParameteri(tex, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(tex, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  } else {
+    glGenTextures(1, &tex);
+    glstate_bind_texture(0, GL_TEXTURE_2D, tex);
+    glTexStorage2D(GL_TEXTURE_2D, levels, internal_format, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  }
+  return {tex};
+}
+
+void gpu_texture_copy_target(gpu_texture_s tex, int width, int height) {
+  if (g_glcaps.dsa) {
+    glCopyTextureSubImage2D(tex.id, 0, 0, 0, 0, 0, width, height);
+    return;
+  }
+  glstate_bind_texture(0, GL_TEXTURE_2D, tex.id);
+  glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+}
+
+void gpu_image_bind(gpu_texture_s tex, int level, int slot,
+                    gpu_format_e format, bool write) {
+  g_glstate.frame.issued++;
+  glBindImageTexture(slot, tex.id, level, GL_FALSE, 0,
+                     write ? GL_WRITE_ONLY : GL_READ_ONLY,
+                     gpu_gl_storage_format(format));
+}
+
+// gpu_gl_target_texture makes a texture drawn to by a target, sampled
+// without filtering.
+internal GLuint gpu_gl_target_texture(int width, int height,
+                                      GLenum internal_format, GLenum format,
+                                      GLenum type) {
+  GLuint tex = 0;
+  if (g_glcaps.dsa) {
+    glCreateTextures(GL_TEXTURE_2D, 1, &tex);
+    glTextureStorage2D(tex, 1, internal_format, width, height);
+    glTextureParameteri(tex, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTextureParameteri(tex, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTextureParameteri(tex, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(tex, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  } else {
+    glGenTextures(1, &tex);
+    glstate_bind_texture(0, GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format,
+                 type, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  }
+  return tex;
+}
+
+gpu_target_s gpu_target_create(int width, int height,
+                               const gpu_format_e *colors, int colors_size) {
+  assert(colors_size <= GPU_TARGET_MAX_COLORS);
+  gpu_target_s t = {};
+  t.width = width;
+  t.height = height;
+
+  glGenFramebuffers(1, &t.id);
+  glstate_bind_framebuffer(t.id);
+
+  GLenum draw_buffers[GPU_TARGET_MAX_COLORS];
+  for (int i = 0; i < colors_size; i++) {
+    GLenum internal_format = GL_RGBA8;
+    GLenum type = GL_UNSIGNED_BYTE;
+    if (colors[i] == GPU_FORMAT_R8) {
+      internal_format = GL_R8;
+    } else if (colors[i] == GPU_FORMAT_RGB8) {
+      internal_format = GL_RGB8;
+    } else if (colors[i] == GPU_FORMAT_RGBA16F) {
+      internal_format = GL_RGBA16F;
+      type = GL_FLOAT;
+    }
+    t.colors[i].id = gpu_gl_target_texture(width, height, internal_format,
+                                           GL_RGBA, type);
+    draw_buffers[i] = GL_COLOR_ATTACHMENT0 + i;
+    glFramebufferTexture2D(GL_FRAMEBUFFER, draw_buffers[i], GL_TEXTURE_2D,
+                           t.colors[i].id, 0);
+  }
+  t.colors_size = colors_size;
+  glDrawBuffers(colors_size, draw_buffers);
+
+  t.depth.id = gpu_gl_target_texture(width, height, GL_DEPTH24_STENCIL8,
+                                     GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                         GL_TEXTURE_2D, t.depth.id, 0);
+
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glstate_bind_framebuffer(0);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    printf("gpu target %dx%d incomplete: 0x%x\n", width, height, status);
+    gpu_target_destroy(&t);
+  }
+  return t;
+}
+
+void gpu_target_destroy(gpu_target_s *t) {
+  for (int i = 0; i < t->colors_size; i++) {
+    gpu_texture_destroy(&t->colors[i]);
+  }
+  gpu_texture_destroy(&t->depth);
+  if (t->id != 0) {
+    glstate_forget_framebuffer(t->id);
+    glDeleteFramebuffers(1, &t->id);
+  }
+  *t = {};
+}
+
+void gpu_target_bind(const gpu_target_s *t) {
+  glstate_bind_framebuffer(t != NULL ? t->id : 0);
+}
+
+gpu_input_s gpu_input_create() { return {vao_create()}; }
+
+template <typename V>
+void gpu_input_stream(gpu_input_s in, int slot, gpu_buffer_s buf, size_t base,
+                      bool per_instance) {
+  vao_attach_stream<V>(in.id, slot, buf.id, base, per_instance ? 1 : 0);
+}
+
+void gpu_input_indices(gpu_input_s in, gpu_buffer_s buf) {
+  vao_attach_indices(in.id, buf.id);
+}
+
+void gpu_input_destroy(gpu_input_s *in) { vao_destroy(&in->id); }
+
+void printProgramLog(GLuint program) {
+  if (!glIsProgram(program)) {
+    printf("print program log failed: %d isn't program\n", program);
+    return;
+  }
+
+  int infoLogLength = 0;
+  int maxLength = infoLogLength;
+
+  glGetProgramiv(program, GL_INFO_LOG_LENGTH, &maxLength);
+
+  char *infoLog = new char[maxLength];
+  glGetProgramInfoLog(program, maxLength, &infoLogLength, infoLog);
+  if (infoLogLength > 0) {
+    printf("%s\n", infoLog);
+  }
+
+  delete[] infoLog;
+}
+
+void printShaderLog(GLuint shader) {
+  if (!glIsShader(shader)) {
+    printf("print shader log failed: %d isn't shader\n", shader);
+    return;
+  }
+
+  int infoLogLength = 0;
+  int maxLength = infoLogLength;
+
+  glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &maxLength);
+
+  char *infoLog = new char[maxLength];
+  glGetShaderInfoLog(shader, maxLength, &infoLogLength, infoLog);
+  if (infoLogLength > 0) {
+    printf("%s\n", infoLog);
+  }
+
+  delete[] infoLog;
+}
+
+internal GLenum gpu_gl_stage(gpu_stage_e stage) {
+  switch (stage) {
+  case GPU_STAGE_VERTEX:
+    return GL_VERTEX_SHADER;
+  case GPU_STAGE_FRAGMENT:
+    return GL_FRAGMENT_SHADER;
+  case GPU_STAGE_COMPUTE:
+    return GL_COMPUTE_SHADER;
+  }
+  return GL_VERTEX_SHADER;
+}
+
+// gpu_gl_uniform_type is the type a uniform of glsl type is set with,
+// samplers, images and bools are set as ints.
+internal gpu_uniform_e gpu_gl_uniform_type(GLenum type) {
+  switch (type) {
+  case GL_FLOAT:
+    return GPU_UNIFORM_FLOAT;
+  case GL_FLOAT_VEC2:
+    return GPU_UNIFORM_VEC2;
+  case GL_FLOAT_VEC3:
+    return GPU_UNIFORM_VEC3;
+  case GL_FLOAT_VEC4:
+    return GPU_UNIFORM_VEC4;
+  case GL_UNSIGNED_INT:
+    return GPU_UNIFORM_UINT;
+  case GL_FLOAT_MAT3:
+    return GPU_UNIFORM_MAT3;
+  case GL_FLOAT_MAT4:
+    return GPU_UNIFORM_MAT4;
+  }
+  return GPU_UNIFORM_INT;
+}
+
+// gpu_gl_attribute_shape tells how many locations a glsl attribute type
+// takes, how many components each has and whether it is an integer one.
+internal bool gpu_gl_attribute_shape(GLenum type, gpu_attribute_s *a) {
+  a->locations = 1;
+  a->integer = false;
+  switch (type) {
+  case GL_FLOAT:
+    a->components = 1;
+    return true;
+  case GL_FLOAT_VEC2:
+    a->components = 2;
+    return true;
+  case GL_FLOAT_VEC3:
+    a->components = 3;
+    return true;
+  case GL_FLOAT_VEC4:
+    a->components = 4;
+    return true;
+  case GL_FLOAT_MAT3:
+    a->locations = 3;
+    a->components = 3;
+    return true;
+  case GL_FLOAT_MAT4:
+    a->locations = 4;
+    a->components = 4;
+    return true;
+  case GL_INT:
+  case GL_UNSIGNED_INT:
+    a->components = 1;
+    a->integer = true;
+    return true;
+  }
+  return false;
+}
+
+// gpu_gl_layout_load lists the active uniforms and attributes of the linked
+// program. Attributes of a type the layout can't describe are listed without
+// components.
+internal void gpu_gl_layout_load(GLuint program, gpu_layout_s *layout) {
+  layout->uniforms_size = 0;
+  GLint count = 0;
+  glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+  for (GLint i = 0; i < count; i++) {
+    // longer than the list keeps, shader_uniform_add says so
+    char name[256];
+    GLsizei length = 0;
+    GLint size = 0;
+    GLenum type = 0;
+    glGetActiveUniform(program, i, sizeof(name), &length, &size, &type, name);
+    // members of uniform blocks have no location
+    GLint location = glGetUniformLocation(program, name);
+    if (location < 0) {
+      continue;
+    }
+    gpu_uniform_e kind = gpu_gl_uniform_type(type);
+    shader_uniform_add(layout, name, location, kind, size);
+    if (length > 3 && strcmp(name + length - 3, "[0]") == 0) {
+      name[length - 3] = 0;
+      shader_uniform_add(layout, name, location, kind, size);
+    }
+  }
+
+  layout->attributes_size = 0;
+  glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+  for (GLint i = 0; i < count; i++) {
+    char name[GPU_NAME_MAX];
+    GLint size = 0;
+    GLenum type = 0;
+    glGetActiveAttrib(program, i, sizeof(name), NULL, &size, &type, name);
+    GLint location = glGetAttribLocation(program, name);
+    if (location < 0) {
+      // built-ins like gl_VertexID
+      continue;
+    }
+    if (layout->attributes_size == GPU_ATTRIBUTES_MAX) {
+      printf("program %d: no room for attribute %s\n", program, name);
+      break;
+    }
+    gpu_attribute_s *a = &layout->attributes[layout->attributes_size++];
+    *a = {};
+    a->location = location;
+    if (gpu_gl_attribute_shape(type, a)) {
+      a->locations *= size;
+    } else {
+      a->components = 0;
+    }
+    strcpy(a->name, name);
+  }
+}
+
+gpu_program_s gpu_program_create(const gpu_stage_e *stages,
+                                 const char *const *sources, int count,
+                                 const char *name, gpu_layout_s *layout) {
+  GLuint program = glCreateProgram();
+  GLuint shaders[4];
+  int shaders_size = 0;
+  bool ok = true;
+  // sources of one stage in a row make one shader
+  for (int i = 0; i < count && ok;) {
+    int end = i + 1;
+    while (end < count && stages[end] == stages[i]) {
+      end++;
+    }
+    assert(shaders_size < 4);
+    GLuint shader = glCreateShader(gpu_gl_stage(stages[i]));
+    shaders[shaders_size++] = shader;
+    glShaderSource(shader, end - i, sources + i, NULL);
+    glCompileShader(shader);
+
+    GLint compiled = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (compiled != GL_TRUE) {
+      printf("compile shader %s failed: stage %d\n", name, stages[i]);
+      printShaderLog(shader);
+      ok = false;
+    }
+    glAttachShader(program, shader);
+    i = end;
+  }
+
+  if (ok) {
+    glLinkProgram(program);
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (linked != GL_TRUE) {
+      printf("link shader program %s failed: %d\n", name, program);
+      printProgramLog(program);
+      ok = false;
+    }
+  }
+
+  for (int i = 0; i < shaders_size; i++) {
+    glDeleteShader(shaders[i]);
+  }
+  if (!ok) {
+    glDeleteProgram(program);
+    return {0};
+  }
+
+  gpu_gl_layout_load(program, layout);
+  layout->program = {program};
+  return {program};
+}
+
+void gpu_program_destroy(gpu_program_s *p) {
+  glstate_forget_program(p->id);
+  glDeleteProgram(p->id);
+  p->id = 0;
+}
+
+void gpu_program_bind(gpu_program_s p) { glstate_use_program(p.id); }
+
+// GL sets uniforms of the program in use, p is bound if it isn't.
+void gpu_uniform_set(gpu_program_s p, const gpu_uniform_s *u,
+                     gpu_uniform_e type, const void *data, int count) {
+  glstate_use_program(p.id);
+  const GLfloat *f = (const GLfloat *)data;
+  GLint at = u->slot;
+  switch (type) {
+  case GPU_UNIFORM_FLOAT:
+    glUniform1fv(at, count, f);
+    break;
+  case GPU_UNIFORM_VEC2:
+    glUniform2fv(at, count, f);
+    break;
+  case GPU_UNIFORM_VEC3:
+    glUniform3fv(at, count, f);
+    break;
+  case GPU_UNIFORM_VEC4:
+    glUniform4fv(at, count, f);
+    break;
+  case GPU_UNIFORM_INT:
+    glUniform1iv(at, count, (const GLint *)data);
+    break;
+  case GPU_UNIFORM_UINT:
+    glUniform1uiv(at, count, (const GLuint *)data);
+    break;
+  case GPU_UNIFORM_MAT3:
+    glUniformMatrix3fv(at, count, GL_FALSE, f);
+    break;
+  case GPU_UNIFORM_MAT4:
+    glUniformMatrix4fv(at, count, GL_FALSE, f);
+    break;
+  }
+}
+
+gpu_pipeline_s gpu_pipeline_opaque(const gpu_layout_s *layout) {
+  gpu_pipeline_s p = {};
+  p.program = layout->program;
+  p.layout = layout;
+  p.depth_test = true;
+  p.depth_write = true;
+  p.depth_compare = GPU_COMPARE_LESS;
+  p.color_write = true;
+  p.cull = GPU_CULL_NONE;
+  p.blend = GPU_BLEND_NONE;
+  return p;
+}
+
+internal GLenum gpu_gl_compare(gpu_compare_e c) {
+  switch (c) {
+  case GPU_COMPARE_LESS:
+    return GL_LESS;
+  case GPU_COMPARE_LEQUAL:
+    return GL_LEQUAL;
+  case GPU_COMPARE_EQUAL:
+    return GL_EQUAL;
+  case GPU_COMPARE_ALWAYS:
+    return GL_ALWAYS;
+  }
+  return GL_LESS;
+}
+
+void gpu_pipeline_bind(const gpu_pipeline_s *p) {
+  glstate_use_program(p->program.id);
+
+  glstate_set(GL_DEPTH_TEST, p->depth_test);
+  glstate_depth_mask(p->depth_write);
+  glstate_depth_func(gpu_gl_compare(p->depth_compare));
+  glstate_color_mask(p->color_write);
+  glstate_set(GL_DEPTH_CLAMP, p->depth_clamp);
+
+  glstate_set(GL_STENCIL_TEST, p->stencil != GPU_STENCIL_NONE);
+  if (p->stencil == GPU_STENCIL_VOLUME_MARK) {
+    glstate_stencil_func(GL_ALWAYS, 0);
+    glstate_stencil_op(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+    glstate_stencil_op(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+  } else if (p->stencil == GPU_STENCIL_VOLUME_TEST) {
+    glstate_stencil_func(GL_NOTEQUAL, 0);
+    glstate_stencil_op(GL_FRONT, GL_KEEP, GL_ZERO, GL_ZERO);
+    glstate_stencil_op(GL_BACK, GL_KEEP, GL_ZERO, GL_ZERO);
+  }
+
+  glstate_set(GL_CULL_FACE, p->cull != GPU_CULL_NONE);
+  if (p->cull != GPU_CULL_NONE) {
+    glstate_cull_face(p->cull == GPU_CULL_BACK ? GL_BACK : GL_FRONT);
+  }
+
+  glstate_set(GL_BLEND, p->blend != GPU_BLEND_NONE);
+  if (p->blend == GPU_BLEND_ALPHA) {
+    glstate_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  } else if (p->blend == GPU_BLEND_ADD) {
+    glstate_blend_func(GL_ONE, GL_ONE);
+  }
+}
+
+void gpu_draw(const gpu_draw_s *d) {
+  glstate_bind_vao(d->input.id);
+  g_glstate.frame.draws++;
+
+  int instances = d->instances > 0 ? d->instances : 1;
+  if (d->indexed) {
+    // glew declares some of the offsets non-const
+    void *offset = (void *)(d->first * sizeof(uint32_t));
+    if (instances == 1) {
+      glDrawElementsBaseVertex(GL_TRIANGLES, d->count, GL_UNSIGNED_INT, offset,
+                               d->base_vertex);
+    } else {
+      glDrawElementsInstancedBaseVertex(GL_TRIANGLES, d->count,
+                                        GL_UNSIGNED_INT, offset, instances,
+                                        d->base_vertex);
+    }
+  } else {
+    if (instances == 1) {
+      glDrawArrays(GL_TRIANGLES, d->first, d->count);
+    } else {
+      glDrawArraysInstanced(GL_TRIANGLES, d->first, d->count, instances);
+    }
+  }
+}
+
+bool gpu_has_multi_draw() { return g_glcaps.mdi; }
+
+void gpu_draw_multi(gpu_input_s in, gpu_buffer_s commands, int first,
+                    int count) {
+  assert(g_glcaps.mdi);
+  glstate_bind_vao(in.id);
+  glstate_bind_buffer(GL_DRAW_INDIRECT_BUFFER, commands.id);
+  g_glstate.frame.draws++;
+
+  const void *offset = (const void *)(first * sizeof(gpu_draw_indirect_s));
+  glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, offset, count, 0);
+}
+
+bool gpu_has_multi_draw_count() { return g_glcaps.mdi_count; }
+
+void gpu_draw_multi_count(gpu_input_s in, gpu_buffer_s commands, int first,
+                          gpu_buffer_s counts, int count_at, int max_count) {
+  assert(g_glcaps.mdi_count);
+  glstate_bind_vao(in.id);
+  glstate_bind_buffer(GL_DRAW_INDIRECT_BUFFER, commands.id);
+  glstate_bind_buffer(GL_PARAMETER_BUFFER_ARB, counts.id);
+  g_glstate.frame.draws++;
+
+  const void *offset = (const void *)(first * sizeof(gpu_draw_indirect_s));
+  glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, offset,
+                                      count_at * sizeof(uint32_t), max_count,
+                                      0);
+}
+
+bool gpu_has_compute() { return g_glcaps.compute; }
+
+void gpu_dispatch(int x, int y, int z) { glDispatchCompute(x, y, z); }
+
+void gpu_barrier(int barriers) {
+  GLbitfield bits = 0;
+  bits |= (barriers & GPU_BARRIER_STORAGE) ? GL_SHADER_STORAGE_BARRIER_BIT : 0;
+  bits |= (barriers & GPU_BARRIER_IMAGE) ? GL_SHADER_IMAGE_ACCESS_BARRIER_BIT
+                                         : 0;
+  bits |= (barriers & GPU_BARRIER_TEXTURE) ? GL_TEXTURE_FETCH_BARRIER_BIT : 0;
+  bits |= (barriers & GPU_BARRIER_COMMAND) ? GL_COMMAND_BARRIER_BIT : 0;
+  bits |= (barriers & GPU_BARRIER_VERTEX) ? GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT
+                                          : 0;
+  glMemoryBarrier(bits);
+}
+
+internal GLenum gpu_gl_query_target() {
+  return g_glcaps.query_conservative ? GL_ANY_SAMPLES_PASSED_CONSERVATIVE
+                                     : GL_ANY_SAMPLES_PASSED;
+}
+
+gpu_query_s gpu_query_create() {
+  GLuint q = 0;
+  glGenQueries(1, &q);
+  return {q};
+}
+
+void gpu_query_destroy(gpu_query_s *q) {
+  if (q->id == 0) {
+    return;
+  }
+  glDeleteQueries(1, &q->id);
+  q->id = 0;
+}
+
+void gpu_query_begin(gpu_query_s q) {
+  glBeginQuery(gpu_gl_query_target(), q.id);
+}
+
+void gpu_query_end() { glEndQuery(gpu_gl_query_target()); }
+
+bool gpu_query_result(gpu_query_s q, bool *any_samples) {
+  GLuint available = GL_FALSE;
+  glGetQueryObjectuiv(q.id, GL_QUERY_RESULT_AVAILABLE, &available);
+  if (available != GL_TRUE) {
+    return false;
+  }
+  GLuint passed = 0;
+  glGetQueryObjectuiv(q.id, GL_QUERY_RESULT, &passed);
+  *any_samples = passed != 0;
+  return true;
+}
+
+void gpu_timer_begin(gpu_query_s q) { glBeginQuery(GL_TIME_ELAPSED, q.id); }
+
+void gpu_timer_end() { glEndQuery(GL_TIME_ELAPSED); }
+
+bool gpu_timer_result(gpu_query_s q, float *ms) {
+  GLuint available = GL_FALSE;
+  glGetQueryObjectuiv(q.id, GL_QUERY_RESULT_AVAILABLE, &available);
+  if (available != GL_TRUE) {
+    return false;
+  }
+  GLuint64 ns = 0;
+  glGetQueryObjectui64v(q.id, GL_QUERY_RESULT, &ns);
+  *ms = ns / 1000000.0f;
+  return true;
+}
+
+gpu_fence_s gpu_fence_insert() {
+  return {glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)};
+}
+
+bool gpu_fence_wait(gpu_fence_s f, uint64_t timeout_ns) {
+  if (f.id == NULL) {
+    return true;
+  }
+  // the fence may still be in the command queue, it would never signal
+  GLenum r = glClientWaitSync((GLsync)f.id, GL_SYNC_FLUSH_COMMANDS_BIT,
+                              timeout_ns);
+  return r != GL_TIMEOUT_EXPIRED;
+}
+
+void gpu_fence_destroy(gpu_fence_s *f) {
+  if (f->id == NULL) {
+    return;
+  }
+  glDeleteSync((GLsync)f->id);
+  f->id = NULL;
+}
+
+void gpu_viewport(int x, int y, int width, int height) {
+  glstate_viewport(x, y, width, height);
+}
+
+void gpu_clear(float r, float g, float b, float a) {
+  // writes off would make the clear skip them
+  glstate_depth_mask(true);
+  glstate_color_mask(true);
+  glClearColor(r, g, b, a);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+}
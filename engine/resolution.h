@@ -0,0 +1,81 @@
+#ifndef RESOLUTION_H
+#define RESOLUTION_H
+
+#include "unity.h"
+
+// Dynamic resolution. The scene is drawn to a part of a full size target,
+// scale times the window on both axes, and upscaled to the window. The
+// controller picks the scale from measured GPU frame times to stay within a
+// budget.
+//
+// GPU time is taken to grow with the pixel count, the square of the scale.
+// Scales are multiples of RESOLUTION_STEP so targets that depend on the size
+// (depth pyramids) aren't made again every frame. The controller drops
+// straight to the scale it expects to fit, but only goes up one step at a
+// time and only with room to spare, and it ignores the frames after a change
+// since timers come back a few frames late and are still of the old scale.
+
+#define RESOLUTION_STEP 0.0625f
+// aimed for when going down, as a part of the budget
+#define RESOLUTION_HEADROOM 0.9f
+// going up needs frames this much below the budget
+#define RESOLUTION_UP 0.8f
+// frames after a change whose times are ignored
+#define RESOLUTION_SETTLE 8
+
+struct resolution_s {
+  float budget_ms;
+  float min_scale;
+  float max_scale;
+  float scale;
+
+  // filtered GPU time at the current scale, 0 before the first sample
+  float gpu_ms;
+  int settle;
+};
+
+void resolution_init(resolution_s *r, float budget_ms, float min_scale = 0.5f,
+                     float max_scale = 1.0f) {
+  *r = {};
+  r->budget_ms = budget_ms;
+  r->min_scale = min_scale;
+  r->max_scale = max_scale;
+  r->scale = max_scale;
+}
+
+internal float resolution_quantize(resolution_s *r, float scale) {
+  scale = floorf(scale / RESOLUTION_STEP) * RESOLUTION_STEP;
+  return scale < r->min_scale
+             ? r->min_scale
+             : (scale > r->max_scale ? r->max_scale : scale);
+}
+
+// resolution_update takes the GPU time of a frame and returns the scale of
+// the next ones.
+float resolution_update(resolution_s *r, float gpu_ms) {
+  if (r->settle > 0) {
+    r->settle--;
+    return r->scale;
+  }
+  r->gpu_ms = r->gpu_ms == 0.0f ? gpu_ms : r->gpu_ms * 0.8f + gpu_ms * 0.2f;
+  if (r->gpu_ms <= 0.0f) {
+    return r->scale;
+  }
+
+  float fit = r->scale * sqrtf(r->budget_ms * RESOLUTION_HEADROOM / r->gpu_ms);
+  float scale = r->scale;
+  if (r->gpu_ms > r->budget_ms) {
+    scale = resolution_quantize(r, fit);
+  } else if (r->gpu_ms < r->budget_ms * RESOLUTION_UP && fit > r->scale) {
+    scale = resolution_quantize(r, r->scale + RESOLUTION_STEP);
+  }
+
+  if (scale != r->scale) {
+    r->scale = scale;
+    r->gpu_ms = 0.0f;
+    r->settle = RESOLUTION_SETTLE;
+  }
+  return r->scale;
+}
+
+#endif
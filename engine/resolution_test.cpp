@@ -0,0 +1,65 @@
+#include "unity.h"
+
+#ifndef RESOLUTION_TEST_H
+#define RESOLUTION_TEST_H
+
+#include "resolution.h"
+
+// resolutionTestRun feeds the controller frame times of cost(scale) = fixed +
+// per_pixel * scale^2, read back three frames late like the timers are.
+// Returns the scale it ends at, changes counts changes of the last 100
+// frames.
+internal float resolutionTestRun(resolution_s *r, float fixed,
+                                 float per_pixel, int *changes) {
+  float pending[3] = {r->scale, r->scale, r->scale};
+  *changes = 0;
+  for (int frame = 0; frame < 400; frame++) {
+    float drawn = pending[frame % 3];
+    float before = r->scale;
+    resolution_update(r, fixed + per_pixel * drawn * drawn);
+    pending[frame % 3] = r->scale;
+    if (frame >= 300 && r->scale != before) {
+      (*changes)++;
+    }
+  }
+  return r->scale;
+}
+
+bool testResolution() {
+  resolution_s r;
+  resolution_init(&r, 8.3f);
+
+  // too slow at full size, settles on a scale within the budget
+  int changes = 0;
+  float scale = resolutionTestRun(&r, 2.0f, 12.0f, &changes);
+  float cost = 2.0f + 12.0f * scale * scale;
+  if (cost > r.budget_ms || changes != 0 || scale >= 1.0f) {
+    printf("resolution: scale %f costs %f, %d late changes\n", scale, cost,
+           changes);
+    return true;
+  }
+  // and not far below it, a step up would go over
+  float up = scale + RESOLUTION_STEP;
+  if (2.0f + 12.0f * up * up < r.budget_ms * RESOLUTION_UP) {
+    printf("resolution: scale %f could go up\n", scale);
+    return true;
+  }
+
+  // load goes away, back to full size
+  scale = resolutionTestRun(&r, 1.0f, 2.0f, &changes);
+  if (scale != r.max_scale) {
+    printf("resolution: scale %f with no load\n", scale);
+    return true;
+  }
+
+  // load no scale can hold, stays at the smallest
+  scale = resolutionTestRun(&r, 20.0f, 4.0f, &changes);
+  if (scale != r.min_scale) {
+    printf("resolution: scale %f over budget at any scale\n", scale);
+    return true;
+  }
+
+  return false;
+}
+
+#endif
@@ -3,172 +3,163 @@
 
 #include "unity.h"
 
-struct shader_s {
-  // char name[MAX_QPATH];
-  // int index;
-  GLuint program;
-  // GLuint vertexShader;
-  // GLuint fragmentShader;
-  // GLint attribs[ATTR_INDEX_MAX];
-  // GLint uniforms[UNIFORM_MAX];
-  // struct shader_s *next;
-};
-
-void printProgramLog(GLuint program) {
-  if (!glIsProgram(program)) {
-    printf("print program log failed: %d isn't program\n", program);
-    return;
-  }
-
-  int infoLogLength = 0;
-  int maxLength = infoLogLength;
-
-  glGetProgramiv(program, GL_INFO_LOG_LENGTH, &maxLength);
-
-  char* infoLog = new char[maxLength];
-  glGetProgramInfoLog(program, maxLength, &infoLogLength, infoLog);
-  if (infoLogLength > 0) {
-    printf("%s\n", infoLog);
+#include "renderer.h"
+
+// Shaders are loaded from files and linked by the renderer, which lists the
+// uniforms and attributes of the program in its layout. Setting a uniform by
+// name then looks in the list instead of asking the driver, and needs no
+// context: command lists recorded on job workers keep the entry, the thread
+// owning the context only sets it.
+typedef gpu_layout_s shader_s;
+
+internal uint32_t shader_hash(const char* name) {
+  uint32_t h = 2166136261u;
+  for (const char* c = name; *c != 0; c++) {
+    h = (h ^ (uint8_t)*c) * 16777619u;
   }
-
-  delete[] infoLog;
+  return h;
 }
 
-void printShaderLog(GLuint shader) {
-  if (!glIsShader(shader)) {
-    printf("print shader log failed: %d isn't shader\n", shader);
+// shader_uniform_add lists uniform name of sh, the renderer does it when it
+// links the program.
+void shader_uniform_add(shader_s* sh, const char* name, int32_t slot,
+                        gpu_uniform_e type, int count) {
+  if (sh->uniforms_size == GPU_UNIFORMS_MAX || strlen(name) >= GPU_NAME_MAX) {
+    printf("shader %d: no room for uniform %s\n", sh->program.id, name);
     return;
   }
-
-  int infoLogLength = 0;
-  int maxLength = infoLogLength;
-
-  glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &maxLength);
-
-  char* infoLog = new char[maxLength];
-  glGetShaderInfoLog(shader, maxLength, &infoLogLength, infoLog);
-  if (infoLogLength > 0) {
-    printf("%s\n", infoLog);
-  }
-
-  delete[] infoLog;
+  gpu_uniform_s* u = &sh->uniforms[sh->uniforms_size++];
+  u->hash = shader_hash(name);
+  u->slot = slot;
+  u->type = type;
+  u->count = count;
+  strcpy(u->name, name);
 }
 
-bool shader_init(shader_s* shader_s, const char* vertexFilename,
-                 const char* fragmentFilename) {
-  GLint ok = GL_FALSE;
-  GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-
-  {
-    void* vertexFile = SDL_LoadFile(vertexFilename, NULL);
-    {
-      glShaderSource(vertexShader, 1, (const char* const*)&vertexFile, NULL);
-      glCompileShader(vertexShader);
-
-      glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &ok);
-      if (ok != GL_TRUE) {
-        printf("compile vertex shader failed: %d\n", vertexShader);
-        printShaderLog(vertexShader);
-
-        // error defer
-        glDeleteShader(vertexShader);
-
-        // defer
-        SDL_free(vertexFile);
-
-        return false;
-      }
+// shader_uniform is uniform name of sh, NULL for one the program doesn't use,
+// which setting it ignores. Safe on any thread.
+const gpu_uniform_s* shader_uniform(const shader_s* sh, const char* name) {
+  uint32_t hash = shader_hash(name);
+  for (int i = 0; i < sh->uniforms_size; i++) {
+    const gpu_uniform_s* u = &sh->uniforms[i];
+    if (u->hash == hash && strcmp(u->name, name) == 0) {
+      return u;
     }
-
-    SDL_free(vertexFile); // defer
   }
+  return NULL;
+}
 
-  GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-
-  {
-    void* fragmentFile = SDL_LoadFile(fragmentFilename, NULL);
-    {
-      glShaderSource(fragmentShader, 1, (const char* const*)&fragmentFile,
-                     NULL);
-      glCompileShader(fragmentShader);
-
-      glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &ok);
-      if (ok != GL_TRUE) {
-        printf("%s:%d: compile fragment shader failed %s: %d\n", __FILE__, __LINE__, fragmentFilename, fragmentShader);
-        printShaderLog(fragmentShader);
-
-        // error defer
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
-
-        // defer
-        SDL_free(fragmentFile);
-
-        return false;
-      }
+// shader_load links the files of each stage into sh, the files of one stage
+// are compiled as one source in the order given.
+internal bool shader_load(shader_s* sh, const gpu_stage_e* stages,
+                          const char* const* filenames, int count) {
+  assert(count <= 4);
+  void* files[4] = {};
+  bool ok = true;
+  for (int i = 0; i < count; i++) {
+    files[i] = SDL_LoadFile(filenames[i], NULL);
+    if (files[i] == NULL) {
+      printf("load shader %s failed: %s\n", filenames[i], SDL_GetError());
+      ok = false;
     }
-
-    SDL_free(fragmentFile); // defer
   }
+  if (ok) {
+    sh->program = gpu_program_create(stages, (const char* const*)files, count,
+                                      filenames[count - 1], sh);
+    ok = sh->program.id != 0;
+  }
+  for (int i = 0; i < count; i++) {
+    SDL_free(files[i]);
+  }
+  return ok;
+}
 
-  GLuint program = glCreateProgram();
+bool shader_init(shader_s* sh, const char* vertexFilename,
+                 const char* fragmentFilename) {
+  gpu_stage_e stages[2] = {GPU_STAGE_VERTEX, GPU_STAGE_FRAGMENT};
+  const char* filenames[2] = {vertexFilename, fragmentFilename};
+  return shader_load(sh, stages, filenames, 2);
+}
 
-  {
-    glAttachShader(program, vertexShader);
-    glAttachShader(program, fragmentShader);
-    glLinkProgram(program);
+// shader_init_prefixed is shader_init with fragmentPrefix compiled ahead of
+// the fragment shader, for code several of them share. The prefix has the
+// #version, the fragment shader has none.
+bool shader_init_prefixed(shader_s* sh, const char* vertexFilename,
+                          const char* fragmentPrefix,
+                          const char* fragmentFilename) {
+  gpu_stage_e stages[3] = {GPU_STAGE_VERTEX, GPU_STAGE_FRAGMENT,
+                           GPU_STAGE_FRAGMENT};
+  const char* filenames[3] = {vertexFilename, fragmentPrefix,
+                              fragmentFilename};
+  return shader_load(sh, stages, filenames, 3);
+}
+
+// shader_init_compute links a program made of one compute shader, the
+// context needs GL 4.3.
+bool shader_init_compute(shader_s* sh, const char* filename) {
+  gpu_stage_e stage = GPU_STAGE_COMPUTE;
+  return shader_load(sh, &stage, &filename, 1);
+}
 
-    glGetProgramiv(program, GL_LINK_STATUS, &ok);
-    if (ok != GL_TRUE) {
-      printf("link shader program failed: %d\n", program);
-      printProgramLog(program);
+void shader_clean(shader_s* sh) {
+  gpu_program_destroy(&sh->program);
+  sh->uniforms_size = 0;
+  sh->attributes_size = 0;
+}
 
-      // error defer
-      glDeleteProgram(program);
-      glDeleteShader(vertexShader);
-      glDeleteShader(fragmentShader);
+void shader_use(const shader_s* sh) { gpu_program_bind(sh->program); }
 
-      return false;
-    }
+// shader_set sets uniform name of the program in use, if sh has it.
+internal void shader_set(const shader_s* sh, const char* name,
+                         gpu_uniform_e type, const void* data, int count) {
+  const gpu_uniform_s* u = shader_uniform(sh, name);
+  if (u != NULL) {
+    gpu_uniform_set(sh->program, u, type, data, count);
   }
+}
 
-  glDeleteShader(vertexShader);
-  glDeleteShader(fragmentShader);
-
-  shader_s->program = program;
+void shader_4f(const shader_s* sh, const char* name, float x, float y, float z,
+               float w) {
+  float v[4] = {x, y, z, w};
+  shader_set(sh, name, GPU_UNIFORM_VEC4, v, 1);
+}
 
-  return true;
+void shader_3f(const shader_s* sh, const char* name, float x, float y,
+               float z) {
+  float v[3] = {x, y, z};
+  shader_set(sh, name, GPU_UNIFORM_VEC3, v, 1);
 }
 
-void shader_clean(shader_s* shader_s) { glDeleteProgram(shader_s->program); }
+void shader_1i(const shader_s* sh, const char* name, int x) {
+  shader_set(sh, name, GPU_UNIFORM_INT, &x, 1);
+}
 
-void shader_use(shader_s* shader) { glUseProgram(shader->program); }
+void shader_1ui(const shader_s* sh, const char* name, unsigned int x) {
+  shader_set(sh, name, GPU_UNIFORM_UINT, &x, 1);
+}
 
-void shader_4f(shader_s* shader_s, const char* name, float x, float y, float z,
-               float w) {
-  GLint location = glGetUniformLocation(shader_s->program, name);
-  glUniform4f(location, x, y, z, w);
+void shader_2f(const shader_s* sh, const char* name, float x, float y) {
+  float v[2] = {x, y};
+  shader_set(sh, name, GPU_UNIFORM_VEC2, v, 1);
 }
 
-void shader_3f(shader_s* shader_s, const char* name, float x, float y,
-               float z) {
-  GLint location = glGetUniformLocation(shader_s->program, name);
-  glUniform3f(location, x, y, z);
+void shader_4fv(const shader_s* sh, const char* name, int count,
+                const float* v) {
+  shader_set(sh, name, GPU_UNIFORM_VEC4, v, count);
 }
 
-void shader_1i(shader_s* shader_s, const char* name, int x) {
-  GLint location = glGetUniformLocation(shader_s->program, name);
-  glUniform1i(location, x);
+void shader_1f(const shader_s* sh, const char* name, float x) {
+  shader_set(sh, name, GPU_UNIFORM_FLOAT, &x, 1);
 }
 
-void shader_1f(shader_s* shader_s, const char* name, float x) {
-  GLint location = glGetUniformLocation(shader_s->program, name);
-  glUniform1f(location, x);
+void shader_mat4fv(const shader_s* sh, const char* name,
+                   const float* matrix) {
+  shader_set(sh, name, GPU_UNIFORM_MAT4, matrix, 1);
 }
 
-void shader_mat4fv(shader_s* shader_s, const char* name, const float* matrix) {
-  GLint location = glGetUniformLocation(shader_s->program, name);
-  glUniformMatrix4fv(location, 1, GL_FALSE, matrix);
+void shader_mat3fv(const shader_s* sh, const char* name,
+                   const float* matrix) {
+  shader_set(sh, name, GPU_UNIFORM_MAT3, matrix, 1);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,15 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+// per instance, see instance_s
+layout (location = 3) in mat4 iModel;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+// the lit pass tests depth for equality, it must get the same positions
+invariant gl_Position;
+
+void main() {
+  gl_Position = projection * (view * (iModel * vec4(aPos, 1.0)));
+}
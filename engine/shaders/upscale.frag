@@ -0,0 +1,45 @@
+#version 330 core
+
+// scene drawn to the bottom left renderSize pixels of a target, stretched
+// over the window and sharpened. The sharpening is contrast adaptive (after
+// AMD's CAS): a cross of neighbours is subtracted, less where they already
+// differ a lot, so edges don't ring.
+
+uniform sampler2D scene;
+uniform vec2 renderSize;
+uniform vec2 windowSize;
+// 0 to 1
+uniform float sharpness;
+
+out vec4 FragColor;
+
+// Bilinear samples the drawn part at p in its pixels, targets aren't
+// filtered
+vec3 Bilinear(vec2 p) {
+    p = clamp(p - 0.5, vec2(0.0), renderSize - 1.0);
+    ivec2 i = ivec2(p);
+    ivec2 j = min(i + 1, ivec2(renderSize) - 1);
+    vec2 f = p - vec2(i);
+    vec3 a = texelFetch(scene, i, 0).rgb;
+    vec3 b = texelFetch(scene, ivec2(j.x, i.y), 0).rgb;
+    vec3 c = texelFetch(scene, ivec2(i.x, j.y), 0).rgb;
+    vec3 d = texelFetch(scene, j, 0).rgb;
+    return mix(mix(a, b, f.x), mix(c, d, f.x), f.y);
+}
+
+void main() {
+    vec2 p = gl_FragCoord.xy / windowSize * renderSize;
+    vec3 c = Bilinear(p);
+    vec3 n = Bilinear(p + vec2(0.0, 1.0));
+    vec3 s = Bilinear(p - vec2(0.0, 1.0));
+    vec3 e = Bilinear(p + vec2(1.0, 0.0));
+    vec3 w = Bilinear(p - vec2(1.0, 0.0));
+
+    vec3 lo = min(c, min(min(n, s), min(e, w)));
+    vec3 hi = max(c, max(max(n, s), max(e, w)));
+    vec3 amount = sqrt(clamp(min(lo, 1.0 - hi) / max(hi, vec3(0.0001)), 0.0, 1.0));
+    vec3 weight = amount * mix(-0.125, -0.2, sharpness);
+
+    vec3 color = (c + (n + s + e + w) * weight) / (1.0 + 4.0 * weight);
+    FragColor = vec4(clamp(color, 0.0, 1.0), 1.0);
+}
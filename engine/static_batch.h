@@ -0,0 +1,81 @@
+#ifndef STATIC_BATCH_H
+#define STATIC_BATCH_H
+
+#include "unity.h"
+
+#include "alloc.h"
+#include "mesh.h"
+
+// Static batching: meshes of objects that never move are transformed to
+// world space once and appended into one mesh per chunk, drawn then as a
+// single instance with an identity model. Each object copies its mesh into
+// the chunk instead of sharing it, that memory buys one draw and one
+// instance per chunk in place of one instance per object.
+//
+// Chunks are regions of space so frustum culling still has something to
+// cull, a chunk is drawn when any of its objects would be.
+
+// static_batch_stats_s is what the chunks cost against what they save.
+struct static_batch_stats_s {
+  int objects;
+  int chunks;
+  // geometry of the chunks, all of it added to that of the shared meshes
+  size_t bytes;
+};
+
+// static_batch_grow makes room for count more elements of elem_size in
+// *data of *cap, doubling.
+internal void *static_batch_grow(void *data, int size, int *cap, int count,
+                                 size_t elem_size) {
+  if (size + count <= *cap) {
+    return data;
+  }
+  if (*cap == 0) {
+    *cap = 16;
+  }
+  while (size + count > *cap) {
+    *cap *= 2;
+  }
+  return data == NULL ? alloc_make(*cap * elem_size)
+                      : alloc_resize(data, *cap * elem_size);
+}
+
+// static_batch_append appends the vertices of src transformed by model and
+// its indices to batch. Meshes without indices get trivial ones, batch
+// always has them. Textures are not merged, meshes with them are left out
+// of batches by the caller.
+void static_batch_append(mesh_s *batch, const mesh_s *src,
+                         const mat4 &model) {
+  batch->verts = (vertex_s *)static_batch_grow(
+      batch->verts, batch->verts_size, &batch->verts_cap, src->verts_size,
+      sizeof(vertex_s));
+  int indices = src->indices_size > 0 ? src->indices_size : src->verts_size;
+  batch->indices = (uint *)static_batch_grow(batch->indices,
+                                             batch->indices_size,
+                                             &batch->indices_cap, indices,
+                                             sizeof(uint));
+
+  glm::mat3 normal = glm::transpose(glm::inverse(glm::mat3(model)));
+  int base = batch->verts_size;
+  for (int i = 0; i < src->verts_size; i++) {
+    const vertex_s *v = &src->verts[i];
+    vertex_s *out = &batch->verts[base + i];
+    out->pos = vec3(model * vec4(v->pos, 1.0f));
+    out->normal = glm::normalize(normal * v->normal);
+    out->texcoord = v->texcoord;
+  }
+  batch->verts_size += src->verts_size;
+
+  uint *dst = &batch->indices[batch->indices_size];
+  for (int i = 0; i < indices; i++) {
+    dst[i] = base + (src->indices_size > 0 ? src->indices[i] : i);
+  }
+  batch->indices_size += indices;
+}
+
+// static_batch_bytes is the size of the geometry of m.
+size_t static_batch_bytes(const mesh_s *m) {
+  return m->verts_size * sizeof(vertex_s) + m->indices_size * sizeof(uint);
+}
+
+#endif
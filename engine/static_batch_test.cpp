@@ -0,0 +1,61 @@
+#include "unity.h"
+
+#ifndef STATIC_BATCH_TEST_H
+#define STATIC_BATCH_TEST_H
+
+#include "static_batch.h"
+
+bool testStaticBatch() {
+  // a triangle with indices and the same one without, the second placed
+  // and stretched
+  vertex_s verts[3] = {
+      {vec3(0, 0, 0), vec3(0, 0, 1), vec2(0, 0)},
+      {vec3(1, 0, 0), vec3(0, 0, 1), vec2(1, 0)},
+      {vec3(0, 1, 0), vec3(0, 0, 1), vec2(0, 1)},
+  };
+  uint indices[3] = {0, 2, 1};
+  mesh_s indexed = {};
+  indexed.verts = verts;
+  indexed.verts_size = 3;
+  indexed.indices = indices;
+  indexed.indices_size = 3;
+  mesh_s plain = {};
+  plain.verts = verts;
+  plain.verts_size = 3;
+
+  mesh_s batch = {};
+  static_batch_append(&batch, &indexed, mat4(1.0f));
+  mat4 model = glm::scale(glm::translate(mat4(1.0f), vec3(5, 0, 0)),
+                          vec3(2, 1, 4));
+  static_batch_append(&batch, &plain, model);
+
+  bool failed = batch.verts_size != 6 || batch.indices_size != 6;
+  uint want[6] = {0, 2, 1, 3, 4, 5};
+  for (int i = 0; !failed && i < 6; i++) {
+    failed = batch.indices[i] != want[i];
+  }
+  if (!failed) {
+    vec3 pos = batch.verts[4].pos;
+    vec3 normal = batch.verts[4].normal;
+    // a stretched normal stays unit length and perpendicular
+    failed = glm::length(pos - vec3(7, 0, 0)) > 1e-5f ||
+             glm::length(normal - vec3(0, 0, 1)) > 1e-5f ||
+             batch.verts[5].texcoord.x != 0.0f ||
+             batch.verts[5].texcoord.y != 1.0f;
+  }
+  if (failed) {
+    printf("static batch: %d verts, %d indices\n", batch.verts_size,
+           batch.indices_size);
+  }
+  if (static_batch_bytes(&batch) !=
+      6 * sizeof(vertex_s) + 6 * sizeof(uint)) {
+    printf("static batch: %zu bytes\n", static_batch_bytes(&batch));
+    failed = true;
+  }
+
+  alloc_free(batch.verts);
+  alloc_free(batch.indices);
+  return failed;
+}
+
+#endif
@@ -0,0 +1,63 @@
+#include "stream.h"
+
+#include "alloc.h"
+#include "frame_pacer.h"
+
+// stream_init makes a buffer of STREAM_FRAMES regions of at least
+// region_size bytes.
+void stream_init(stream_buffer_s *s, size_t region_size) {
+  *s = {};
+  s->region_size = (region_size + STREAM_ALIGN - 1) / STREAM_ALIGN *
+                   STREAM_ALIGN;
+  size_t size = s->region_size * STREAM_FRAMES;
+  s->buf = gpu_buffer_create(size, NULL, GPU_BUFFER_STREAM);
+  s->base = (uint8_t *)gpu_buffer_map(s->buf, size);
+  s->mapped = s->base != NULL;
+  if (!s->mapped) {
+    s->base = (uint8_t *)alloc_make(size);
+  }
+  // the first frame starts at region 0
+  s->region = STREAM_FRAMES - 1;
+}
+
+void stream_clean(stream_buffer_s *s) {
+  for (int i = 0; i < STREAM_FRAMES; i++) {
+    gpu_fence_destroy(&s->fences[i]);
+  }
+  gpu_buffer_destroy(&s->buf);
+  if (!s->mapped) {
+    alloc_free(s->base);
+  }
+  *s = {};
+}
+
+// stream_begin starts the frame's region, before anything is allocated in
+// the frame.
+void stream_begin(stream_buffer_s *s) {
+  stream_next(s);
+  if (!s->mapped) {
+    gpu_buffer_orphan(s->buf, s->region_size * STREAM_FRAMES);
+    return;
+  }
+
+  // frame pacing normally has the GPU done with it already
+  gpu_fence_s *f = &s->fences[s->region];
+  frame_pacer_wait(*f, "stream");
+  gpu_fence_destroy(f);
+}
+
+// stream_end fences the region after the commands of the frame.
+void stream_end(stream_buffer_s *s) {
+  if (s->mapped) {
+    s->fences[s->region] = gpu_fence_insert();
+  }
+}
+
+void stream_flush(stream_buffer_s *s) {
+  if (s->mapped || s->head == s->flushed) {
+    return;
+  }
+  size_t start = s->region * s->region_size + s->flushed;
+  gpu_buffer_write(s->buf, start, s->head - s->flushed, s->base + start);
+  s->flushed = s->head;
+}
@@ -0,0 +1,72 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "unity.h"
+
+#include "renderer.h"
+
+// Streaming buffer for data the GPU reads in the frame it is written: text
+// vertices, per-frame uniforms and instances. The buffer is split into
+// STREAM_FRAMES regions used in turn, one per frame, and ranges of the
+// frame's region are handed out front to back. Nothing is ever reallocated.
+//
+// When the context has buffer storage the buffer stays mapped and ranges are
+// written in place. A fence after each frame's commands tells when the GPU
+// is done with its region, writing it again waits only for the frame
+// STREAM_FRAMES - 1 frames back, which has normally finished long before.
+// On GL 3.3 ranges are written to a copy in memory and sent with
+// stream_flush, the buffer is orphaned every frame so these uploads never
+// wait for draws reading the last one.
+
+#define STREAM_FRAMES 3
+// regions start at multiples of it, which covers the offset alignment of
+// uniform and storage buffers
+#define STREAM_ALIGN 256
+
+struct stream_buffer_s {
+  gpu_buffer_s buf;
+  size_t region_size;
+
+  // where ranges are written, the mapped buffer or its copy in memory
+  uint8_t *base;
+  bool mapped;
+
+  // region of the frame, bytes of it handed out and sent
+  int region;
+  size_t head;
+  size_t flushed;
+  gpu_fence_s fences[STREAM_FRAMES];
+
+  // ranges of the frame that didn't fit, they were refused
+  int overflow;
+};
+
+// stream_alloc hands out size bytes of the frame's region at a multiple of
+// align, offset is where they are in buf. The bytes are only for writing and
+// only until the frame ends. NULL when the region is full.
+void *stream_alloc(stream_buffer_s *s, size_t size, size_t align,
+                   size_t *offset) {
+  size_t start = (s->head + align - 1) / align * align;
+  if (start + size > s->region_size) {
+    s->overflow++;
+    return NULL;
+  }
+  s->head = start + size;
+  *offset = s->region * s->region_size + start;
+  return s->base + *offset;
+}
+
+// stream_flush sends what was written since the last flush, before the
+// draws reading it. Mapped writes are seen by the GPU without it.
+void stream_flush(stream_buffer_s *s);
+
+// stream_next moves to the region of the next frame, stream_begin waits for
+// it first.
+void stream_next(stream_buffer_s *s) {
+  s->region = (s->region + 1) % STREAM_FRAMES;
+  s->head = 0;
+  s->flushed = 0;
+  s->overflow = 0;
+}
+
+#endif
@@ -0,0 +1,61 @@
+#include "unity.h"
+
+#ifndef STREAM_TEST_H
+#define STREAM_TEST_H
+
+#include "instance.h"
+#include "stream.h"
+
+bool testStream() {
+  local_persist uint8_t memory[STREAM_FRAMES * 512];
+  stream_buffer_s s = {};
+  s.region_size = 512;
+  s.base = memory;
+  s.mapped = true;
+
+  for (int frame = 0; frame < STREAM_FRAMES + 1; frame++) {
+    stream_next(&s);
+    size_t region = (frame + 1) % STREAM_FRAMES * 512;
+
+    size_t a = 0;
+    size_t b = 0;
+    uint8_t *pa = (uint8_t *)stream_alloc(&s, 10, 4, &a);
+    uint8_t *pb = (uint8_t *)stream_alloc(&s, 100, STREAM_ALIGN, &b);
+    if (pa != memory + a || pb != memory + b || a != region ||
+        b != region + STREAM_ALIGN) {
+      printf("stream: frame %d ranges at %zu %zu, region at %zu\n", frame, a,
+             b, region);
+      return true;
+    }
+
+    // the rest of the region fits, one byte more doesn't
+    size_t c = 0;
+    if (stream_alloc(&s, 512 - STREAM_ALIGN - 100 + 1, 1, &c) != NULL ||
+        stream_alloc(&s, 512 - STREAM_ALIGN - 100, 1, &c) == NULL ||
+        c != b + 100 || s.overflow != 1) {
+      printf("stream: frame %d region end at %zu\n", frame, c);
+      return true;
+    }
+  }
+
+  // instances go at an aligned range of the frame's region, draws read them
+  // from the stream buffer there
+  stream_next(&s);
+  instance_s data[2] = {};
+  data[1].material = 7;
+  instance_buffer_s ib = {};
+  ib.data = data;
+  ib.size = 2;
+  size_t skip = 0;
+  stream_alloc(&s, 1, 1, &skip);
+  instance_buffer_stream(&ib, &s);
+  if (ib.base % STREAM_ALIGN != 0 || ib.base <= skip ||
+      ((instance_s *)(memory + ib.base))[1].material != 7) {
+    printf("stream: instances at %zu\n", ib.base);
+    return true;
+  }
+
+  return false;
+}
+
+#endif
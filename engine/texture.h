@@ -3,9 +3,9 @@
 
 #include "unity.h"
 
-#include "texture.h"
+#include "renderer.h"
 
-bool tex_load(GLuint* tex_unit, const char* path, bool filter = true) {
+bool tex_load(gpu_texture_s* tex, const char* path, bool filter = true) {
 
   int width, height, nrChannels;
   stbi_set_flip_vertically_on_load(true);
@@ -15,42 +15,19 @@ bool tex_load(GLuint* tex_unit, const char* path, bool filter = true) {
     return 0;
   }
 
-  glGenTextures(1, tex_unit);
-  glBindTexture(GL_TEXTURE_2D, *tex_unit);
-
-  GLenum format = GL_RED;
+  gpu_format_e format = GPU_FORMAT_R8;
   if (nrChannels == 3) {
-    format = GL_RGB;
+    format = GPU_FORMAT_RGB8;
   } else if (nrChannels == 4) {
-    format = GL_RGBA;
+    format = GPU_FORMAT_RGBA8;
   }
 
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, format,
-               GL_UNSIGNED_BYTE, data);
-  glGenerateMipmap(GL_TEXTURE_2D);
+  *tex = gpu_texture_create(width, height, format, data,
+                            filter ? GPU_FILTER_LINEAR : GPU_FILTER_NEAREST);
 
   stbi_image_free(data);
 
-  // set the texture wrapping/filtering options (on the currently bound
-  // texture object)
-  if (filter) {
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-                    GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  } else {
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-                    GL_NEAREST_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  }
-
-  // float borderColor[] = { 1.0f, 0.2f, 0.45f, 0.5f };
-  // glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-
   return 1;
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,133 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "unity.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TRANSFORM_SSE 1
+#endif
+
+// xform_s holds everything vertex shaders need to place an object, computed
+// once per object on the CPU instead of once per vertex on the GPU.
+struct xform_s {
+  // model_view translates object coordinates to the camera coordinates.
+  mat4 model_view;
+
+  // mvp translates object coordinates to the clip coordinates.
+  mat4 mvp;
+
+  // normal is the inverse transpose of the model_view rotation part, it keeps
+  // normals perpendicular under non-uniform scale.
+  glm::mat3 normal;
+};
+
+#ifdef TRANSFORM_SSE
+
+internal inline __m128 xform_mul_col(const __m128 m[4], __m128 v) {
+  __m128 r = _mm_mul_ps(m[0], _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+  r = _mm_add_ps(r,
+                 _mm_mul_ps(m[1], _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+  r = _mm_add_ps(r,
+                 _mm_mul_ps(m[2], _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+  r = _mm_add_ps(r,
+                 _mm_mul_ps(m[3], _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))));
+  return r;
+}
+
+// w lane of the result is always zero
+internal inline __m128 xform_cross(__m128 a, __m128 b) {
+  __m128 a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+  __m128 b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+  __m128 c = _mm_sub_ps(_mm_mul_ps(a, b_yzx), _mm_mul_ps(a_yzx, b));
+  return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+internal inline void xform_store3(float *dst, __m128 v) {
+  _mm_storel_pi((__m64 *)dst, v);
+  _mm_store_ss(dst + 2, _mm_movehl_ps(v, v));
+}
+
+// xform_store_normal stores the inverse transpose of the 3x3 part of m.
+internal inline void xform_store_normal(const __m128 m[3], glm::mat3 *out) {
+  // rows of the 3x3 inverse are the cross products of the columns divided by
+  // determinant, so they are the columns of the inverse transpose
+  __m128 n0 = xform_cross(m[1], m[2]);
+  __m128 n1 = xform_cross(m[2], m[0]);
+  __m128 n2 = xform_cross(m[0], m[1]);
+
+  __m128 d = _mm_mul_ps(m[0], n0);
+  d = _mm_add_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 3, 0, 1)));
+  d = _mm_add_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(1, 0, 3, 2)));
+  __m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0f), d);
+
+  xform_store3(&(*out)[0].x, _mm_mul_ps(n0, inv_det));
+  xform_store3(&(*out)[1].x, _mm_mul_ps(n1, inv_det));
+  xform_store3(&(*out)[2].x, _mm_mul_ps(n2, inv_det));
+}
+
+#endif
+
+// xform_batch computes xforms of count objects. Model matrices are read every
+// stride bytes starting from model, so they can live inside bigger structs.
+void xform_batch(const mat4 *model, size_t stride, int count, const mat4 &view,
+                 const mat4 &proj, xform_s *out) {
+  const char *src = (const char *)model;
+
+#ifdef TRANSFORM_SSE
+  __m128 v[4], p[4];
+  for (int c = 0; c < 4; c++) {
+    v[c] = _mm_loadu_ps(&view[c].x);
+    p[c] = _mm_loadu_ps(&proj[c].x);
+  }
+
+  for (int i = 0; i < count; i++, src += stride) {
+    const float *m = (const float *)src;
+    xform_s *x = &out[i];
+
+    __m128 mv[4];
+    for (int c = 0; c < 4; c++) {
+      mv[c] = xform_mul_col(v, _mm_loadu_ps(m + c * 4));
+      _mm_storeu_ps(&x->model_view[c].x, mv[c]);
+      _mm_storeu_ps(&x->mvp[c].x, xform_mul_col(p, mv[c]));
+    }
+    xform_store_normal(mv, &x->normal);
+  }
+#else
+  for (int i = 0; i < count; i++, src += stride) {
+    const mat4 *m = (const mat4 *)src;
+    xform_s *x = &out[i];
+    x->model_view = view * *m;
+    x->mvp = proj * x->model_view;
+    x->normal = glm::transpose(glm::inverse(glm::mat3(x->model_view)));
+  }
+#endif
+}
+
+// xform_normal_batch computes only the normal matrices of count model
+// matrices, read like in xform_batch, for objects placed in the world with no
+// view.
+void xform_normal_batch(const mat4 *model, size_t stride, int count,
+                        glm::mat3 *out) {
+  const char *src = (const char *)model;
+  for (int i = 0; i < count; i++, src += stride) {
+#ifdef TRANSFORM_SSE
+    const float *m = (const float *)src;
+    __m128 cols[3] = {_mm_loadu_ps(m), _mm_loadu_ps(m + 4),
+                      _mm_loadu_ps(m + 8)};
+    xform_store_normal(cols, &out[i]);
+#else
+    const mat4 *m = (const mat4 *)src;
+    out[i] = glm::transpose(glm::inverse(glm::mat3(*m)));
+#endif
+  }
+}
+
+// xform_compute is xform_batch for a single object.
+xform_s xform_compute(const mat4 &model, const mat4 &view, const mat4 &proj) {
+  xform_s x;
+  xform_batch(&model, sizeof(mat4), 1, view, proj, &x);
+  return x;
+}
+
+#endif
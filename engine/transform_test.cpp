@@ -0,0 +1,70 @@
+#include "unity.h"
+
+#ifndef TRANSFORM_TEST_H
+#define TRANSFORM_TEST_H
+
+#include "transform.h"
+
+bool testXformBatch() {
+  mat4 model[2];
+  model[0] = glm::translate(mat4(1.0f), vec3(1, 2, 3));
+  model[0] = glm::scale(model[0], vec3(2, 3, 4));
+  model[1] = glm::rotate(mat4(1.0f), glm::radians(30.0f), vec3(0, 1, 0));
+  model[1] = glm::scale(model[1], vec3(0.5f, 1, 7));
+
+  mat4 view = glm::lookAt(vec3(5, 6, 7), vec3(0), vec3(0, 1, 0));
+  mat4 proj = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f);
+
+  xform_s out[2];
+  xform_batch(model, sizeof(mat4), 2, view, proj, out);
+
+  for (int i = 0; i < 2; i++) {
+    mat4 mv = view * model[i];
+    mat4 mvp = proj * mv;
+    glm::mat3 normal = glm::transpose(glm::inverse(glm::mat3(mv)));
+
+    for (int c = 0; c < 4; c++) {
+      for (int r = 0; r < 4; r++) {
+        if (fabs(out[i].model_view[c][r] - mv[c][r]) > 0.001f) {
+          printf("xform_%d: model_view[%d][%d] mismatch: %f != %f\n", i, c, r,
+                 out[i].model_view[c][r], mv[c][r]);
+          return true;
+        }
+        if (fabs(out[i].mvp[c][r] - mvp[c][r]) > 0.001f) {
+          printf("xform_%d: mvp[%d][%d] mismatch: %f != %f\n", i, c, r,
+                 out[i].mvp[c][r], mvp[c][r]);
+          return true;
+        }
+      }
+    }
+
+    for (int c = 0; c < 3; c++) {
+      for (int r = 0; r < 3; r++) {
+        if (fabs(out[i].normal[c][r] - normal[c][r]) > 0.001f) {
+          printf("xform_%d: normal[%d][%d] mismatch: %f != %f\n", i, c, r,
+                 out[i].normal[c][r], normal[c][r]);
+          return true;
+        }
+      }
+    }
+  }
+
+  glm::mat3 normals[2];
+  xform_normal_batch(model, sizeof(mat4), 2, normals);
+  for (int i = 0; i < 2; i++) {
+    glm::mat3 normal = glm::transpose(glm::inverse(glm::mat3(model[i])));
+    for (int c = 0; c < 3; c++) {
+      for (int r = 0; r < 3; r++) {
+        if (fabs(normals[i][c][r] - normal[c][r]) > 0.001f) {
+          printf("xform_normal_%d: [%d][%d] mismatch: %f != %f\n", i, c, r,
+                 normals[i][c][r], normal[c][r]);
+          return true;
+        }
+      }
+    }
+  }
+
+  return false;
+}
+
+#endif
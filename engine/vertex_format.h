@@ -0,0 +1,168 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include "unity.h"
+
+#include "glstate.h"
+#include "shader.h"
+
+// Vertex formats are described at compile time: every vertex struct gets a
+// vertex_format specialization listing its attributes with VERTEX_ATTRIB.
+// The lists are constexpr, so the setup loops unroll into the same plain
+// glVertexAttribPointer calls that used to be written by hand.
+//
+//   template <> struct vertex_format<vertex_pos_s> {
+//     static constexpr vertex_attrib_s attribs[] = {
+//         VERTEX_ATTRIB(0, vertex_pos_s, pos),
+//     };
+//   };
+//
+// One struct describes one buffer stream, a vao may combine several streams
+// (e.g. position-only stream plus the rest) as long as locations differ.
+
+struct vertex_attrib_s {
+  GLuint location;
+  GLint size;
+  GLenum type;
+  bool integer;
+  GLuint offset;
+};
+
+template <typename T> struct vertex_attrib_traits;
+
+template <> struct vertex_attrib_traits<float> {
+  static constexpr GLint size = 1;
+  static constexpr GLenum type = GL_FLOAT;
+  static constexpr bool integer = false;
+};
+
+template <> struct vertex_attrib_traits<vec2> {
+  static constexpr GLint size = 2;
+  static constexpr GLenum type = GL_FLOAT;
+  static constexpr bool integer = false;
+};
+
+template <> struct vertex_attrib_traits<vec3> {
+  static constexpr GLint size = 3;
+  static constexpr GLenum type = GL_FLOAT;
+  static constexpr bool integer = false;
+};
+
+template <> struct vertex_attrib_traits<vec4> {
+  static constexpr GLint size = 4;
+  static constexpr GLenum type = GL_FLOAT;
+  static constexpr bool integer = false;
+};
+
+template <> struct vertex_attrib_traits<uint> {
+  static constexpr GLint size = 1;
+  static constexpr GLenum type = GL_UNSIGNED_INT;
+  static constexpr bool integer = true;
+};
+
+#define VERTEX_ATTRIB(loc, V, field)                                           \
+  vertex_attrib_s {                                                            \
+    loc, vertex_attrib_traits<decltype(V::field)>::size,                       \
+        vertex_attrib_traits<decltype(V::field)>::type,                        \
+        vertex_attrib_traits<decltype(V::field)>::integer,                     \
+        (GLuint)offsetof(V, field)                                             \
+  }
+
+template <typename V> struct vertex_format;
+
+// vertex_format_setup points attributes of V at the buffer bound to
+// GL_ARRAY_BUFFER, starting at byte offset base. The target vao must be bound.
+// Divisor 1 makes it a per-instance stream.
+template <typename V> void vertex_format_setup(size_t base = 0, GLuint divisor = 0) {
+  for (const vertex_attrib_s &a : vertex_format<V>::attribs) {
+    glEnableVertexAttribArray(a.location);
+    const void *ptr = (const void *)(base + a.offset);
+    if (a.integer) {
+      glVertexAttribIPointer(a.location, a.size, a.type, sizeof(V), ptr);
+    } else {
+      glVertexAttribPointer(a.location, a.size, a.type, GL_FALSE, sizeof(V),
+                            ptr);
+    }
+    if (divisor != 0) {
+      glVertexAttribDivisor(a.location, divisor);
+    }
+  }
+}
+
+template <typename V>
+const vertex_attrib_s *vertex_format_find(GLuint location) {
+  for (const vertex_attrib_s &a : vertex_format<V>::attribs) {
+    if (a.location == location) {
+      return &a;
+    }
+  }
+  return NULL;
+}
+
+template <typename... Streams>
+const vertex_attrib_s *vertex_format_find_any(GLuint location) {
+  const vertex_attrib_s *found = NULL;
+  ((found = found ? found : vertex_format_find<Streams>(location)), ...);
+  return found;
+}
+
+// vertex_format_validate checks that every active attribute of the linked
+// program is fed by one of the streams with the matching kind of data.
+// Missing components are only reported, GL fills them with (0, 0, 0, 1).
+template <typename... Streams> bool vertex_format_validate(const shader_s *sh) {
+  bool ok = true;
+  for (int i = 0; i < sh->attributes_size; i++) {
+    const gpu_attribute_s *attr = &sh->attributes[i];
+    if (attr->components == 0) {
+      printf("vertex format: attribute %s has unsupported type\n", attr->name);
+      ok = false;
+      continue;
+    }
+
+    for (int l = 0; l < attr->locations; l++) {
+      GLuint location = attr->location + l;
+      const vertex_attrib_s *a = vertex_format_find_any<Streams...>(location);
+      if (a == NULL) {
+        printf("vertex format: attribute %s (location %d) has no stream\n",
+               attr->name, location);
+        ok = false;
+      } else if (a->integer != attr->integer) {
+        printf("vertex format: attribute %s (location %d) integer mismatch\n",
+               attr->name, location);
+        ok = false;
+      } else if (a->size != attr->components) {
+        printf("vertex format: attribute %s (location %d) gets %d of %d "
+               "components\n",
+               attr->name, location, a->size, attr->components);
+      }
+    }
+  }
+
+  return ok;
+}
+
+// shader_init_layout links the program and validates it against the vertex
+// streams it is going to be drawn with. fragmentPrefix is compiled ahead of
+// the fragment shader when given, see shader_init_prefixed.
+template <typename... Streams>
+bool shader_init_layout(shader_s *sh, const char *vertexFilename,
+                        const char *fragmentFilename,
+                        const char *fragmentPrefix = NULL) {
+  bool ok = fragmentPrefix != NULL
+                ? shader_init_prefixed(sh, vertexFilename, fragmentPrefix,
+                                       fragmentFilename)
+                : shader_init(sh, vertexFilename, fragmentFilename);
+  if (!ok) {
+    return false;
+  }
+
+  if (!vertex_format_validate<Streams...>(sh)) {
+    printf("%s: vertex layout doesn't match the streams\n", vertexFilename);
+    shader_clean(sh);
+    return false;
+  }
+
+  return true;
+}
+
+#endif